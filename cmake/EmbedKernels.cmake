@@ -0,0 +1,41 @@
+# Generates C++ source with OpenCL kernels embedded as byte arrays
+#
+# Usage: cmake -DSOURCE_DIR=<project dir> -DOUTPUT=<file> -P EmbedKernels.cmake
+#
+# Kernels of modules take precedence over kernels of the same name in core,
+# the same way as they overwrite them when copied into bin/kernels.
+
+file( GLOB module_KERNELS ${SOURCE_DIR}/modules/*/kernels/*.cl )
+file( GLOB core_KERNELS ${SOURCE_DIR}/core/kernels/*.cl )
+
+set(names)
+set(arrays "")
+set(entries "")
+set(index 0)
+
+foreach(kernel ${module_KERNELS} ${core_KERNELS})
+  get_filename_component(name ${kernel} NAME)
+  list(FIND names ${name} found)
+  if(found EQUAL -1)
+    list(APPEND names ${name})
+
+    file(READ ${kernel} hex HEX)
+    string(LENGTH "${hex}" hex_length)
+    math(EXPR length "${hex_length} / 2")
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," bytes "${hex}")
+
+    set(arrays "${arrays}static const char kernel_${index}[] = { ${bytes}0x00 };\n")
+    set(entries "${entries}  { \"kernels/${name}\", kernel_${index}, ${length} },\n")
+    math(EXPR index "${index} + 1")
+  endif()
+endforeach()
+
+file(WRITE ${OUTPUT}
+  "// Generated by cmake/EmbedKernels.cmake, do not edit\n\n"
+  "#include \"KernelSources.h\"\n\n"
+  "${arrays}\n"
+  "const KernelSources::Entry KernelSources::_entries[] = {\n"
+  "${entries}"
+  "  { nullptr, nullptr, 0 }\n"
+  "};\n\n"
+  "const std::size_t KernelSources::_num_entries = ${index};\n")
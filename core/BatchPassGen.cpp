@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "BatchPassGen.h"
+#include "CandidateBuffer.h"
+
+#include <cstring>
+
+using namespace std;
+
+BatchPassGen::BatchPassGen(ProducerPool *pool, uint8_t max_length,
+                           const bool & stop) :
+    _pool { pool }, _batch { nullptr }, _index { 0 },
+    _max_length { max_length }, _stop (stop)
+{
+  size_t batch_size = CandidateBuffer::size(BATCH_SIZE, max_length);
+  vector<PasswordBatch *> batches;
+
+  _buffer.resize(batch_size * NUM_BATCHES);
+  _batches.resize(NUM_BATCHES);
+  for (unsigned i = 0; i < NUM_BATCHES; i++)
+  {
+    _batches[i].passwords = _buffer.data() + i * batch_size;
+    batches.push_back(&_batches[i]);
+  }
+
+  _consumer = _pool->addConsumer(batches, BATCH_SIZE);
+}
+
+BatchPassGen::~BatchPassGen()
+{
+  // Producers mustn't write into batches after they are freed
+  _pool->removeConsumer(_consumer);
+}
+
+bool BatchPassGen::getPassword(char *pass, uint32_t *len)
+{
+  if (_batch != nullptr && _index == _batch->count)
+  {
+    _pool->releaseBatch(_consumer, _batch);
+    _batch = nullptr;
+  }
+
+  if (_batch == nullptr)
+  {
+    _batch = _pool->getBatch(_consumer, _stop);
+    if (_batch == nullptr)
+      return (false);
+    _index = 0;
+  }
+
+  string password = CandidateBuffer::load(_batch->passwords, BATCH_SIZE,
+                                          _index);
+  memcpy(pass, password.data(), password.size());
+  *len = password.size();
+  _index++;
+
+  return (true);
+}
+
+uint8_t BatchPassGen::maxPassLen()
+{
+  return (_max_length);
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "CPUTopology.h"
+
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <algorithm>
+#include <cstdlib>
+#include <cctype>
+
+#ifdef __WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#endif
+
+using namespace std;
+
+CPUTopology::CPUTopology() :
+    _num_cores { 0 }, _num_nodes { 1 }
+{
+#ifdef __linux__
+  CPU_ZERO(&_allowed);
+  if (sched_getaffinity(0, sizeof(_allowed), &_allowed) != 0)
+  {
+    loadFlat();
+    return;
+  }
+
+  // Cores are identified by package and core id of their threads
+  map<pair<int, int>, unsigned> cores;
+  for (unsigned id = 0; id < CPU_SETSIZE; id++)
+  {
+    if (!CPU_ISSET(id, &_allowed))
+      continue;
+
+    stringstream topology;
+    topology << "/sys/devices/system/cpu/cpu" << id << "/topology/";
+    int package = readNumber(topology.str() + "physical_package_id", 0);
+    int core_id = readNumber(topology.str() + "core_id", id);
+
+    CPU cpu;
+    cpu.id = id;
+    cpu.node = readNode(id);
+    cpu.sibling = cores.count(make_pair(package, core_id)) > 0;
+    if (!cpu.sibling)
+    {
+      unsigned core = cores.size();
+      cores[make_pair(package, core_id)] = core;
+    }
+    cpu.core = cores[make_pair(package, core_id)];
+    _cpus.push_back(cpu);
+  }
+  _num_cores = cores.size();
+
+  unsigned max_node = 0;
+  for (auto & cpu : _cpus)
+    max_node = max(max_node, cpu.node);
+  _num_nodes = max_node + 1;
+
+  if (_cpus.empty())
+    loadFlat();
+  else
+    sortCPUs();
+#else
+  loadFlat();
+#endif
+}
+
+const vector<CPUTopology::CPU> & CPUTopology::getCPUs() const
+{
+  return (_cpus);
+}
+
+unsigned CPUTopology::getNumCores() const
+{
+  return (_num_cores);
+}
+
+unsigned CPUTopology::getNumNodes() const
+{
+  return (_num_nodes);
+}
+
+bool CPUTopology::pinThread(unsigned cpu)
+{
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0);
+#else
+  return (false);
+#endif
+}
+
+bool CPUTopology::unpinThread() const
+{
+#ifdef __linux__
+  return (pthread_setaffinity_np(pthread_self(), sizeof(_allowed), &_allowed)
+      == 0);
+#else
+  return (false);
+#endif
+}
+
+int CPUTopology::readNumber(const string & path, int fallback)
+{
+  ifstream file { path };
+  int number;
+
+  if (!(file >> number))
+    return (fallback);
+
+  return (number);
+}
+
+unsigned CPUTopology::readNode(unsigned cpu)
+{
+  unsigned node = 0;
+#ifdef __linux__
+  stringstream path;
+  path << "/sys/devices/system/cpu/cpu" << cpu;
+
+  DIR *dir = opendir(path.str().c_str());
+  if (dir == nullptr)
+    return (0);
+
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != nullptr)
+  {
+    string name { entry->d_name };
+    if (name.compare(0, 4, "node") == 0 && name.size() > 4
+        && isdigit(name[4]))
+    {
+      node = atoi(name.c_str() + 4);
+      break;
+    }
+  }
+  closedir(dir);
+#endif
+  return (node);
+}
+
+void CPUTopology::loadFlat()
+{
+  unsigned count;
+#ifdef __WIN32
+  SYSTEM_INFO sysinfo;
+  GetSystemInfo(&sysinfo);
+  count = sysinfo.dwNumberOfProcessors;
+#else
+  count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+  _cpus.clear();
+  for (unsigned id = 0; id < count; id++)
+    _cpus.push_back(CPU { id, id, 0, false });
+
+  _num_cores = count;
+  _num_nodes = 1;
+}
+
+void CPUTopology::sortCPUs()
+{
+  // Threads spread over nodes, so all memory controllers are used
+  vector<vector<CPU>> firsts(_num_nodes), siblings(_num_nodes);
+  for (auto & cpu : _cpus)
+    (cpu.sibling ? siblings : firsts)[cpu.node].push_back(cpu);
+
+  _cpus.clear();
+  for (auto groups : { &firsts, &siblings })
+  {
+    bool added = true;
+    for (unsigned k = 0; added; k++)
+    {
+      added = false;
+      for (auto & node : *groups)
+      {
+        if (k < node.size())
+        {
+          _cpus.push_back(node[k]);
+          added = true;
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "CandidateBuffer.h"
+
+#include <cstring>
+
+uint32_t CandidateBuffer::words(uint32_t max_length)
+{
+  return ((max_length + 3) / 4);
+}
+
+std::size_t CandidateBuffer::size(uint32_t count, uint32_t max_length)
+{
+  // Row of lengths and rows of words
+  return (sizeof(uint32_t) * count * (1 + words(max_length)));
+}
+
+void CandidateBuffer::store(char *buffer, uint32_t stride, uint32_t index,
+                            const char *password, uint32_t length)
+{
+  uint32_t *rows = reinterpret_cast<uint32_t *>(buffer);
+
+  rows[index] = length;
+  for (uint32_t k = 0; k < words(length); k++)
+  {
+    // Bytes keep their order in memory, so kernel reads them as uchar4
+    uint32_t word = 0;
+    uint32_t bytes = length - 4 * k < 4 ? length - 4 * k : 4;
+    std::memcpy(&word, password + 4 * k, bytes);
+    rows[(k + 1) * stride + index] = word;
+  }
+}
+
+std::string CandidateBuffer::load(const char *buffer, uint32_t stride,
+                                  uint32_t index)
+{
+  const uint32_t *rows = reinterpret_cast<const uint32_t *>(buffer);
+  uint32_t length = rows[index];
+  std::string password(words(length) * 4, '\0');
+
+  for (uint32_t k = 0; k < words(length); k++)
+  {
+    std::memcpy(&password[4 * k], &rows[(k + 1) * stride + index], 4);
+  }
+  password.resize(length);
+
+  return (password);
+}
@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <CombinatorPassGen.h>
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+bool CombinatorPassGen::_cpu_mode;
+PassGen::KernelCode CombinatorPassGen::_gpu_code;
+std::vector<cl_uchar> CombinatorPassGen::_left_words;
+std::vector<cl_uchar> CombinatorPassGen::_right_words;
+cl_ulong CombinatorPassGen::_left_count;
+cl_ulong CombinatorPassGen::_right_count;
+int CombinatorPassGen::_num_instances;
+
+CombinatorPassGen::CombinatorPassGen(Options& options, bool cpu_mode) :
+    _instance_id { FACTORY_INSTANCE_ID }
+{
+  _cpu_mode = cpu_mode;
+
+  _left_count = loadDictionary(options.left_dictionary, _left_words);
+  _right_count = loadDictionary(options.right_dictionary, _right_words);
+
+  if (_left_count == 0 || _right_count == 0)
+    throw runtime_error("Combinator attack requires two non-empty dictionaries");
+
+  if (_left_count > numeric_limits<cl_ulong>::max() / _right_count)
+    throw runtime_error("Too many combinations of words");
+
+  setRange(0, _left_count * _right_count);
+
+  _num_instances = 0;
+
+  _gpu_code.filename = _kernel_source;
+  _gpu_code.name = _kernel_name;
+}
+
+CombinatorPassGen::CombinatorPassGen(const CombinatorPassGen& o) :
+    IndexPassGen(o), _instance_id { o._num_instances++ }
+{
+}
+
+CombinatorPassGen::~CombinatorPassGen()
+{
+  if (_instance_id == FACTORY_INSTANCE_ID)
+  {
+    for (auto i : _instances)
+      delete i;
+  }
+}
+
+cl_ulong CombinatorPassGen::loadDictionary(const std::string & filename,
+                                           std::vector<cl_uchar> & words)
+{
+  ifstream input { filename };
+  if (!input.is_open())
+    throw runtime_error("Unable to open dictionary " + filename);
+
+  string line;
+  cl_ulong count = 0;
+
+  words.clear();
+  while (getline(input, line))
+  {
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+
+    if (line.size() > MAX_WORD_LENGTH)
+      line.resize(MAX_WORD_LENGTH);
+
+    words.push_back(static_cast<cl_uchar>(line.size()));
+    words.insert(words.end(), line.begin(), line.end());
+    words.resize(words.size() + MAX_WORD_LENGTH - line.size(), 0);
+    count++;
+  }
+
+  return (count);
+}
+
+PassGen::KernelCode* CombinatorPassGen::getKernelCode()
+{
+  if (_cpu_mode)
+    return (nullptr);
+  else
+    return (&_gpu_code);
+}
+
+bool CombinatorPassGen::isFactory()
+{
+  return (_instance_id == FACTORY_INSTANCE_ID);
+}
+
+PassGen* CombinatorPassGen::createGenerator()
+{
+  if (_instance_id == FACTORY_INSTANCE_ID)
+  {
+    CombinatorPassGen * new_instance = new CombinatorPassGen { *this };
+    _instances.push_back(new_instance);
+    return (new_instance);
+  }
+
+  return (nullptr);
+}
+
+uint8_t CombinatorPassGen::maxPassLen()
+{
+  return (static_cast<uint8_t>(2 * MAX_WORD_LENGTH));
+}
+
+void CombinatorPassGen::setKernelGWS(uint64_t gws)
+{
+  _gws = gws;
+  // Initialize reservation size
+  _min_reservation_size = 4 * _gws;
+  gpu_mode = true;
+}
+
+void CombinatorPassGen::initKernel(cl::Kernel* kernel, cl::CommandQueue* que,
+                                   cl::Context* context)
+{
+  _kernel = *kernel;
+  _que = *que;
+
+  // Invalid values to prevent kernel execution without reserved passwords
+  _private_start_index = 1;
+  _private_stop_index = 0;
+
+  cl_ulong max_left_words = min<cl_ulong>(_left_count, MAX_LEFT_WORDS);
+  _left_words_buffer = cl::Buffer { *context, CL_MEM_READ_ONLY,
+                                    max_left_words * WORD_ENTRY_SIZE };
+
+  // Right dictionary stays in device memory for whole attack
+  _right_words_buffer = cl::Buffer { *context, CL_MEM_READ_ONLY,
+                                     _right_words.size() };
+  que->enqueueWriteBuffer(_right_words_buffer, CL_FALSE, 0,
+                          _right_words.size(), _right_words.data());
+
+  kernel->setArg(2, _left_words_buffer);
+  kernel->setArg(3, _right_words_buffer);
+  kernel->setArg(4, _right_count);
+  kernel->setArg(5, _left_base);
+  kernel->setArg(6, _private_start_index);
+  kernel->setArg(7, _private_stop_index);
+}
+
+bool CombinatorPassGen::nextKernelStep()
+{
+  if (_private_start_index + _gws < _private_stop_index)
+  {
+    _private_start_index += _gws;
+    _kernel.setArg(6, _private_start_index);
+    return (true);
+  }
+
+  if (reservePasswords())
+  {
+    _kernel.setArg(5, _left_base);
+    _kernel.setArg(6, _private_start_index);
+    _kernel.setArg(7, _private_stop_index);
+    return (true);
+  }
+
+  return (false);
+}
+
+bool CombinatorPassGen::reservePasswords()
+{
+  if (!IndexPassGen::reservePasswords())
+    return (false);
+
+  // Stream left words of the reservation to device
+  if (gpu_mode)
+  {
+    _left_base = _private_start_index / _right_count;
+    cl_ulong left_last = (_private_stop_index - 1) / _right_count;
+    std::size_t size = (left_last - _left_base + 1) * WORD_ENTRY_SIZE;
+
+    _que.enqueueWriteBuffer(_left_words_buffer, CL_TRUE, 0, size,
+                            _left_words.data() + _left_base * WORD_ENTRY_SIZE);
+  }
+
+  return (true);
+}
+
+cl_ulong CombinatorPassGen::limitReservation(cl_ulong start, cl_ulong stop)
+{
+  // Left words of reservation have to fit into device's buffer
+  if (gpu_mode)
+  {
+    cl_ulong left_limit = start / _right_count + MAX_LEFT_WORDS;
+    if (left_limit < _left_count)
+      stop = min(stop, left_limit * _right_count);
+  }
+
+  return (stop);
+}
+
+bool CombinatorPassGen::getPassword(char* pass, uint32_t* len)
+{
+  if (_private_start_index >= _private_stop_index)
+    if (!reservePasswords())
+      return (false);
+
+  uint64_t index = _private_start_index++;
+
+  const cl_uchar *left = _left_words.data()
+      + (index / _right_count) * WORD_ENTRY_SIZE;
+  const cl_uchar *right = _right_words.data()
+      + (index % _right_count) * WORD_ENTRY_SIZE;
+
+  memcpy(pass, left + 1, left[0]);
+  memcpy(pass + left[0], right + 1, right[0]);
+  *len = left[0] + right[0];
+
+  return (true);
+}
+
+void CombinatorPassGen::saveState(std::string filename)
+{
+  saveIndex(filename, PASSGEN_ID_COMBINATOR);
+}
+
+void CombinatorPassGen::loadState(std::string filename)
+{
+  loadIndex(filename, PASSGEN_ID_COMBINATOR);
+}
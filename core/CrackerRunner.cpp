@@ -28,7 +28,15 @@
 
 CrackerRunner::CrackerRunner() {
     pthread_attr_init(&thread_attr);
+    cpuFactory = NULL;
+    pinThreads = false;
+    smtMode = SMT_THREADS;
+    replicate = false;
     explicitThreads = 0;
+    explicitProducers = 0;
+    producerPool = NULL;
+    explicitVerifiers = 0;
+    verifierPool = NULL;
     verbose = false;
 #ifdef WRATHION_MPI 
     mpi_enabled = false;
@@ -40,17 +48,19 @@ CrackerRunner::CrackerRunner(const CrackerRunner& orig) {
 }
 
 CrackerRunner::~CrackerRunner() {
+    // Generators leave producer pool before it's destroyed
+    for(std::vector<BatchPassGen*>::iterator i = batchPassGens.begin();i != batchPassGens.end();i++){
+        delete *i;
+    }
+    delete producerPool;
+    delete verifierPool;
     pthread_attr_destroy(&thread_attr);
 }
 
 uint32_t CrackerRunner::getCPUCount(){
-#ifdef _WIN32
-    SYSTEM_INFO sysinfo;
-    GetSystemInfo( &sysinfo );
-    return sysinfo.dwNumberOfProcessors;
-#else
-    return sysconf(_SC_NPROCESSORS_ONLN);
-#endif
+    if(smtMode == SMT_CORES)
+        return topology.getNumCores();
+    return topology.getCPUs().size();
 }
 
 void CrackerRunner::sleep(uint32_t ms){
@@ -68,6 +78,13 @@ void CrackerRunner::setCrackerFactory(CrackerFactory* c){
     }
 }
 
+void CrackerRunner::setCPUCrackerFactory(CrackerFactory* c){
+    cpuFactory = c;
+    if (verbose && cpuFactory != NULL) {
+        cpuFactory->setVerbose();
+    }
+}
+
 void CrackerRunner::setPassGen(PassGen* passgen){
     this->passgen = passgen;
     if (verbose) {
@@ -85,6 +102,8 @@ std::vector<uint64_t> *CrackerRunner::getSpeeds(){
 
 void CrackerRunner::start(){
     pass_found = false;
+    stopping = false;
+    uint32_t cpuThreads = 0;
     if(explicitThreads>0)
         this->threads = explicitThreads;
     else
@@ -95,48 +114,200 @@ void CrackerRunner::start(){
     
     if(factory->isGPU()){
         if(mappedDevices.size() == 0){
-            std::cout << "No devices mapped, using 0:0:65536" << std::endl;
+            // Work size of each device is loaded from tuning cache or tuned
+            mappedDevices = GPUCracker::allDevices();
+            std::cout << "No devices mapped, using all " << mappedDevices.size() << " devices" << std::endl;
+        }
+        if(mappedDevices.size() == 0){
             DeviceConfig d;
-            d.globalWorkSize = 65536;
+            d.globalWorkSize = 0;
             d.device = 0;
             d.platform = 0;
             mappedDevices.push_back(d);
         }
         this->threads = mappedDevices.size();
+        uint32_t cpus = getCPUCount();
+        
+        // CPU crackers need passwords from producers or own instance of generator
+        bool hybrid = cpuFactory != NULL;
+        if(hybrid && passgen->getKernelCode() != NULL && !passgen->isFactory()){
+            std::cout << "Password generator can't be shared by CPU and GPU crackers, using GPU crackers only" << std::endl;
+            hybrid = false;
+        }
+        
+        // Passwords generated in host are produced by separate threads
+        uint32_t producers = 0;
+        if(passgen->getKernelCode() == NULL){
+            producers = explicitProducers;
+            if(producers == 0 && hybrid){
+                producers = this->threads;
+            }else if(producers == 0){
+                producers = cpus > this->threads ? cpus - this->threads : 1;
+            }
+            producerPool = new ProducerPool(passgen, producers);
+            producerPool->start();
+        }
+        
+        // Positive passwords are verified while devices continue cracking
+        uint32_t verifiers = explicitVerifiers > 0 ? explicitVerifiers : this->threads;
+        verifierPool = new VerifierPool(factory, verifiers);
+        verifierPool->start();
+        
+        // CPUs driving, feeding and verifying devices are held back from CPU crackers
+        if(hybrid){
+            uint32_t reserved = this->threads + producers + verifiers;
+            if(explicitThreads > 0)
+                cpuThreads = explicitThreads;
+            else
+                cpuThreads = cpus > reserved ? cpus - reserved : 1;
+        }
     }
     
-    for(uint32_t i = 0; i<this->threads;i++){
-        pthread_t *thread = new pthread_t;
-        ThreadArg *arg = new ThreadArg;
-        
-        cracker = factory->createCracker();
+    // CPU crackers are placed on first threads of cores, then on SMT siblings
+    bool pin = pinThreads || replicate;
+    const std::vector<CPUTopology::CPU> &cpus = topology.getCPUs();
+    uint32_t allThreads = this->threads + cpuThreads;
+    for(uint32_t i = 0; i<allThreads;i++){
+        bool cpuCracker = i >= this->threads;
+        int placement = -1;
+        if(cpuCracker || !factory->isGPU()){
+            placement = (factory->isGPU() ? i - this->threads : i) % cpus.size();
+        }
+        // Crackers copy target data, so copies created on their node are local
+        if(replicate && placement >= 0){
+            CPUTopology::pinThread(cpus[placement].id);
+        }
+        cracker = cpuCracker ? cpuFactory->createCracker() : factory->createCracker();
 #ifdef WRATHION_MPI
         if(mpi_enabled){
             cracker->mpiEnable(true);
         }
 #endif
-        if(i == 0){
+        if(i == 0 || i == this->threads){
             cracker->sharedDataInit();
         }
-        if(passgen->isFactory()){
-        		passgen->setStep(this->threads);
-            cracker->setPassGen(passgen->createGenerator());
+        crackers.push_back(cracker);
+        placements.push_back(placement);
+    }
+    if(replicate){
+        topology.unpinThread();
+    }
+
+    if(smtMode == SMT_AUTO && explicitThreads == 0 && !calibrateSMT()){
+        // SMT siblings don't add speed, so they are left to the system
+        for(uint32_t i = 0; i<crackers.size();){
+            if(placements[i] >= 0 && cpus[placements[i]].sibling){
+                delete crackers[i];
+                crackers.erase(crackers.begin()+i);
+                placements.erase(placements.begin()+i);
+                if(factory->isGPU())
+                    cpuThreads--;
+                else
+                    this->threads--;
+            }else{
+                i++;
+            }
+        }
+        allThreads = this->threads + cpuThreads;
+    }
+
+    for(uint32_t i = 0; i<allThreads;i++){
+        pthread_t *thread = new pthread_t;
+        ThreadArg *arg = new ThreadArg;
+
+        bool cpuCracker = i >= this->threads;
+        int cpu = pin && placements[i] >= 0 ? cpus[placements[i]].id : -1;
+        cracker = crackers[i];
+        // Generators with own tables copy them to node of the cracker
+        if(replicate && cpu >= 0){
+            CPUTopology::pinThread(cpu);
+        }
+        if(producerPool != NULL && cpuCracker){
+            // CPU cracker is one more consumer of passwords produced for GPUs
+            BatchPassGen *batchPassGen = new BatchPassGen(producerPool, passgen->maxPassLen(), stopping);
+            batchPassGens.push_back(batchPassGen);
+            cracker->setPassGen(batchPassGen);
+        }else if(producerPool != NULL){
+            cracker->setPassGen(passgen);
+        }else if(passgen->isFactory()){
+        		passgen->setStep(allThreads);
+            PassGen *generator = passgen->createGenerator();
+            if(replicate && cpu >= 0){
+                generator->replicateData(cpus[placements[i]].node);
+            }
+            cracker->setPassGen(generator);
         }else{
             cracker->setPassGen(passgen);
         }
-        if(factory->isGPU()){
+        if(factory->isGPU() && !cpuCracker){
             GPUCracker* gpu_cracker = dynamic_cast<GPUCracker*>(cracker);
             gpu_cracker->setDevice(mappedDevices[i]);
+            gpu_cracker->setProducerPool(producerPool);
+            gpu_cracker->setVerifierPool(verifierPool);
         }
         arg->cracker = cracker;
         arg->runner = this;
+        arg->cpu = cpu;
         pthread_create(thread,&thread_attr,&CrackerRunner::start_thread,arg);
         threads_ref.push_back(thread);
-        crackers.push_back(cracker);
     }
+    if(replicate){
+        topology.unpinThread();
+    }
+    this->threads = allThreads;
+}
+
+bool CrackerRunner::calibrateSMT(){
+    const std::vector<CPUTopology::CPU> &cpus = topology.getCPUs();
+    bool siblings = false;
+    for(uint32_t i = 0; i<crackers.size();i++){
+        if(placements[i] >= 0 && cpus[placements[i]].sibling)
+            siblings = true;
+    }
+    if(!siblings)
+        return true;
+
+    // Both runs take the same time, so numbers of checked passwords are comparable
+    uint64_t coresCount = benchmarkCrackers(false);
+    uint64_t threadsCount = benchmarkCrackers(true);
+    bool useSiblings = threadsCount > coresCount + coresCount/20;
+    std::cout << "SMT calibration: " << coresCount << " passwords on cores, " << threadsCount
+              << " on all threads, using one thread per " << (useSiblings ? "SMT thread" : "core") << std::endl;
+    return useSiblings;
+}
+
+uint64_t CrackerRunner::benchmarkCrackers(bool siblings){
+    const std::vector<CPUTopology::CPU> &cpus = topology.getCPUs();
+    volatile bool stopBenchmark = false;
+    std::vector<BenchmarkArg> args;
+    for(uint32_t i = 0; i<crackers.size();i++){
+        if(placements[i] < 0 || (cpus[placements[i]].sibling && !siblings))
+            continue;
+        BenchmarkArg arg;
+        arg.cracker = crackers[i];
+        arg.cpu = cpus[placements[i]].id;
+        arg.stop = &stopBenchmark;
+        arg.count = 0;
+        args.push_back(arg);
+    }
+
+    std::vector<pthread_t> benchmarkThreads(args.size());
+    for(uint32_t i = 0; i<args.size();i++){
+        pthread_create(&benchmarkThreads[i],NULL,&CrackerRunner::benchmark_thread,&args[i]);
+    }
+    sleep(CALIBRATION_TIME);
+    stopBenchmark = true;
+
+    uint64_t count = 0;
+    for(uint32_t i = 0; i<args.size();i++){
+        pthread_join(benchmarkThreads[i],NULL);
+        count += args[i].count;
+    }
+    return count;
 }
 
 void CrackerRunner::stop(){
+    stopping = true;
     for(std::vector<Cracker*>::iterator i = crackers.begin();i != crackers.end();i++){
         (*i)->stop();
     }
@@ -144,6 +315,12 @@ void CrackerRunner::stop(){
     while(someRunning()){
         sleep(100);
     }
+    if(producerPool != NULL){
+        producerPool->stop();
+    }
+    if(verifierPool != NULL){
+        verifierPool->stop();
+    }
     
 }
 
@@ -152,6 +329,26 @@ void CrackerRunner::setNumThreads(uint32_t threads){
     explicitThreads = threads;
 }
 
+void CrackerRunner::setPinThreads(bool pin){
+    pinThreads = pin;
+}
+
+void CrackerRunner::setSMTMode(SMTMode mode){
+    smtMode = mode;
+}
+
+void CrackerRunner::setReplicateData(bool replicate){
+    this->replicate = replicate;
+}
+
+void CrackerRunner::setNumProducers(uint32_t producers){
+    explicitProducers = producers;
+}
+
+void CrackerRunner::setNumVerifiers(uint32_t verifiers){
+    explicitVerifiers = verifiers;
+}
+
 uint32_t CrackerRunner::getNumThreads(){
     return threads;
 }
@@ -189,6 +386,9 @@ std::string CrackerRunner::getPassword(){
 
 void* CrackerRunner::start_thread(void* arg){
     ThreadArg* c = reinterpret_cast<ThreadArg*>(arg);
+    if(c->cpu >= 0){
+        CPUTopology::pinThread(c->cpu);
+    }
     c->cracker->runInThread();
     switch(c->cracker->getStopReason()){
         case UNKNOWN:
@@ -217,6 +417,17 @@ void* CrackerRunner::start_thread(void* arg){
     return NULL;
 }
 
+void* CrackerRunner::benchmark_thread(void* arg){
+    BenchmarkArg* b = reinterpret_cast<BenchmarkArg*>(arg);
+    std::string password("calibration");
+    CPUTopology::pinThread(b->cpu);
+    while(!*b->stop){
+        b->cracker->checkPassword(&password);
+        b->count++;
+    }
+    return NULL;
+}
+
 std::vector<DeviceConfig> CrackerRunner::decodeConfig(std::string str) {
     std::vector<DeviceConfig> res;
     int cur_pos = 0, found_pos = -1, len;
@@ -249,7 +460,7 @@ std::vector<DeviceConfig> CrackerRunner::decodeConfig(std::string str) {
             cur_conf_pos = found_conf_pos+1;
             devConf.globalWorkSize = atoi(config_str.substr(cur_conf_pos).c_str());
         }else{
-            devConf.globalWorkSize = 65535;
+            devConf.globalWorkSize = 0;
         }
         res.push_back(devConf);
         
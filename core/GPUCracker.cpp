@@ -22,15 +22,34 @@
  */
 
 #include "GPUCracker.h"
+#include "CandidateBuffer.h"
 #include "Utils.h"
+#include "VerifierPool.h"
+#include "KernelSources.h"
 #include <iostream>
 #include <sstream>
 #include <cmath>
+#include <cstring>
+#include <unistd.h>
+#include <fstream>
+#include <algorithm>
+#include <time.h>
+#include <cstdio>
 
 GPUCracker::GPUCracker():GPUPassGenSeeded(false) {
-    initOpenCL();
     passgenExhausted = false;
-    localSize = cl::NDRange(64);
+    GPUPassGen = false;
+    fusedPassGen = false;
+    persistentKernel = false;
+    vectorWidth = 0;
+    producerPool = NULL;
+    consumer = NULL;
+    verifierPool = NULL;
+    pendingVerifications = 0;
+    localWorkSize = 64;
+    localSize = cl::NDRange(localWorkSize);
+    itemCandidates = 1;
+    foundOverflowReported = false;
 }
 
 GPUCracker::GPUCracker(const GPUCracker& orig) {
@@ -43,13 +62,55 @@ void GPUCracker::setDevice(DeviceConfig& config){
     this->deviceConfig = config;
 }
 
+void GPUCracker::setPipelineDepth(uint32_t depth){
+    if(depth > 0)
+        pipelineDepth = depth;
+}
+
+void GPUCracker::setTargetKernelTime(uint32_t ms){
+    targetKernelTime = ms;
+}
+
+void GPUCracker::setFusedPassGen(bool fuse){
+    fusePassGen = fuse;
+}
+
+void GPUCracker::setLengthKernels(bool enable){
+    buildLengthKernels = enable;
+}
+
+void GPUCracker::setPersistentKernels(bool enable){
+    persistentKernels = enable;
+}
+
+void GPUCracker::setDeviceVerifySize(uint32_t bytes){
+    deviceVerifySize = bytes;
+}
+
+void GPUCracker::setCPUVectorWidth(uint32_t width){
+    if(width == 0 || width == 8 || width == 16)
+        cpuVectorWidth = width;
+}
+
+void GPUCracker::setProducerPool(ProducerPool* pool){
+    producerPool = pool;
+}
+
+void GPUCracker::setVerifierPool(VerifierPool* pool){
+    verifierPool = pool;
+}
+
 void GPUCracker::initOpenCL(){
-    if(init_done)
+    pthread_mutex_lock(&initMutex);
+    if(init_done){
+        pthread_mutex_unlock(&initMutex);
         return;
+    }
     cl::Platform::get(&platforms);
     if(platforms.size()==0){
         std::cout<<" No OpenCL platforms found. Check OpenCL installation!\n";
         init_done = true;
+        pthread_mutex_unlock(&initMutex);
         return;
     }
     std::vector<cl::Device> all_devices;
@@ -67,6 +128,7 @@ void GPUCracker::initOpenCL(){
         devices.push_back(p_devices);
     }
     init_done = true;
+    pthread_mutex_unlock(&initMutex);
 }
 
 void GPUCracker::destroyOpenCL() {
@@ -77,6 +139,24 @@ void GPUCracker::destroyOpenCL() {
 }
 
 
+std::vector<DeviceConfig> GPUCracker::allDevices(){
+    initOpenCL();
+    std::vector<DeviceConfig> all, accelerators;
+    for(uint32_t p = 0;p < devices.size();p++){
+        for(uint32_t d = 0;d < devices[p].devices.size();d++){
+            DeviceConfig config;
+            config.platform = p;
+            config.device = d;
+            config.globalWorkSize = 0;
+            all.push_back(config);
+            if(devices[p].devices[d].getInfo<CL_DEVICE_TYPE>() & (CL_DEVICE_TYPE_GPU|CL_DEVICE_TYPE_ACCELERATOR)){
+                accelerators.push_back(config);
+            }
+        }
+    }
+    return accelerators.empty() ? all : accelerators;
+}
+
 std::string GPUCracker::availableDevices(){
     initOpenCL();
     std::stringstream ss;
@@ -91,38 +171,195 @@ std::string GPUCracker::availableDevices(){
     return ss.str();
 }
 
-void GPUCracker::preparePasswords(){
-    if(!GPUPassGen){
-        uint8_t entry_length = passgen->maxPassLen() + 1;
-        uint32_t len;
-
-        if (!passgen->getPassword(&passwdsToGPU[0*entry_length + 1], &len)) {
-          passgenExhausted = true;
-          return;
+void GPUCracker::preparePasswords(PipelineSlot &slot){
+    slot.count = 0;
+    slot.length = 0;
+    if(!GPUPassGen && producerPool != NULL){
+        // Passwords are generated by host threads into pinned batches
+        slot.batch = producerPool->getBatch(consumer, stop_work);
+        if(slot.batch == NULL){
+            if(!stop_work)
+                passgenExhausted = true;
+            return;
         }
+        slot.passwords = slot.batch->passwords;
+        slot.count = slot.batch->count;
+    } else if(!GPUPassGen){
+        char password[256];
+        uint32_t len;
 
-        for(uint32_t i = 1; i< deviceConfig.globalWorkSize; i++){
-            if(!passgen->getPassword(&passwdsToGPU[i*entry_length + 1],&len)){
+        for(uint32_t i = 0; i< deviceConfig.globalWorkSize; i++){
+            if(!passgen->getPassword(password,&len)){
+                passgenExhausted = true;
                 break;
             }
-            passwdsToGPU[i*entry_length] = len & 0xFF;
+            CandidateBuffer::store(slot.passwords,deviceConfig.globalWorkSize,i,password,len);
+            slot.count++;
         }
+    } else if(persistentKernel){
+        // Persistent kernel cracks whole window by one launch
+        uint64_t size;
+        if(passgen->nextKernelWindow(windowSize,&size)){
+            slot.count = size;
+            slot.firstIndex = passgen->kernelStepIndex();
+            slot.length = passgen->kernelStepLength();
+        }else
+            passgenExhausted = true;
     } else{
-        if(!passgen->nextKernelStep())
-          passgenExhausted = true;
+        if(passgen->nextKernelStep()){
+            slot.count = deviceConfig.globalWorkSize;
+            slot.firstIndex = passgen->kernelStepIndex();
+            slot.length = passgen->kernelStepLength();
+        }else
+            passgenExhausted = true;
     }
 }
 
-void GPUCracker::updatePasswords() {
+void GPUCracker::updatePasswords(PipelineSlot &slot) {
     if(!GPUPassGen){
-        uint8_t entry_length = passgen->maxPassLen() + 1;
-        que.enqueueWriteBuffer(passwordBuffer,CL_TRUE,0,sizeof(char)*entry_length*deviceConfig.globalWorkSize,passwdsToGPU);
-    }else{
-        que.enqueueNDRangeKernel(passgenKernel,cl::NullRange,cl::NDRange(deviceConfig.globalWorkSize),localSize);
+        // Whole buffer is sent, so unused entries hold valid (old) passwords
+        uint32_t passwordsSize = CandidateBuffer::size(deviceConfig.globalWorkSize,passgen->maxPassLen());
+        slot.que.enqueueWriteBuffer(slot.passwordBuffer,CL_FALSE,0,passwordsSize,slot.passwords);
+    }else if(!fusedPassGen){
+        passgenKernel.setArg(0,slot.passwordBuffer);
+        que.enqueueNDRangeKernel(passgenKernel,cl::NullRange,cl::NDRange(deviceConfig.globalWorkSize),localSize,NULL,&slot.passwordsReady);
+        que.flush();
+    }
+}
+
+bool GPUCracker::launchSlot(PipelineSlot &slot) {
+    preparePasswords(slot);
+    if(slot.count == 0)
+        return false;
+    updatePasswords(slot);
+
+    // Kernel waits for passgen in GPU, which runs in another que
+    std::vector<cl::Event> waitList;
+    if(GPUPassGen && !fusedPassGen)
+        waitList.push_back(slot.passwordsReady);
+
+    // Step of single length is cracked by kernel built for the length
+    cl::Kernel &crackKernel = slotKernel(slot);
+    crackKernel.setArg(0,slot.passwordBuffer);
+    crackKernel.setArg(2,slot.foundCountBuffer);
+    crackKernel.setArg(3,slot.foundQueueBuffer);
+
+    if(persistentKernel){
+        // Work items take chunks of window from counter until it's exhausted
+        slot.workCounter = 0;
+        slot.que.enqueueWriteBuffer(slot.workCounterBuffer,CL_FALSE,0,sizeof(cl_uint),&slot.workCounter);
+        crackKernel.setArg(persistentArgIndex,slot.workCounterBuffer);
+        crackKernel.setArg(persistentArgIndex+1,stopFlagBuffer);
+        crackKernel.setArg(persistentArgIndex+2,(cl_uint)slot.count);
+        slot.workSize = persistentWorkSize;
+        slot.chunkSize = 0;
+        slot.que.enqueueNDRangeKernel(crackKernel,cl::NullRange,cl::NDRange(persistentWorkSize),localSize,NULL,&slot.kernelDone);
+        slot.que.enqueueReadBuffer(slot.foundCountBuffer,CL_FALSE,0,sizeof(cl_uint),&slot.foundCount,NULL,&slot.resultsRead);
+        slot.que.flush();
+        slot.active = true;
+        return true;
     }
+
+    // Slot is cracked by kernels of active work size (with global offset), so each
+    // kernel takes about the target time
+    uint32_t items = (slot.count + itemCandidates - 1) / itemCandidates;
+    slot.workSize = (items + localWorkSize - 1) / localWorkSize * localWorkSize;
+    uint32_t chunk = targetKernelTime > 0 ? activeWorkSize : slot.workSize;
+    slot.chunkSize = std::min(chunk,slot.workSize);
+    for(uint32_t offset = 0;offset < slot.workSize;offset += chunk){
+        uint32_t size = std::min(chunk,slot.workSize - offset);
+        bool first = offset == 0;
+        slot.que.enqueueNDRangeKernel(crackKernel,cl::NDRange(offset),cl::NDRange(size),localSize,!waitList.empty() && first ? &waitList : NULL,first ? &slot.kernelDone : NULL);
+    }
+
+    // Only counter of found queue is read, entries are read if it isn't zero
+    slot.que.enqueueReadBuffer(slot.foundCountBuffer,CL_FALSE,0,sizeof(cl_uint),&slot.foundCount,NULL,&slot.resultsRead);
+    slot.que.flush();
+
+    slot.active = true;
+    return true;
 }
 
 
+void GPUCracker::updateWorkSize(PipelineSlot &slot) {
+    if(!persistentKernel && (targetKernelTime == 0 || slot.chunkSize == 0))
+        return;
+    cl_ulong start = slot.kernelDone.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+    cl_ulong end = slot.kernelDone.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+    if(end <= start)
+        return;
+
+    if(persistentKernel){
+        // Window is limited by time, so stop doesn't rely on kernels seeing the stop flag
+        double ratio = (PERSISTENT_MAX_WINDOW_TIME * 1000000000.0) / (end - start);
+        ratio = std::max(0.5,std::min(2.0,ratio));
+        uint64_t size = slot.count * ratio;
+        size = size / localWorkSize * localWorkSize;
+        size = std::max<uint64_t>(size,localWorkSize);
+        windowSize = std::min<uint64_t>(size,maxWindowSize);
+        return;
+    }
+
+    // Work size is proportional to kernel time, change is limited to keep controller stable
+    double ratio = (targetKernelTime * 1000000.0) / (end - start);
+    ratio = std::max(0.5,std::min(2.0,ratio));
+    uint64_t size = slot.chunkSize * ratio;
+    size = size / localWorkSize * localWorkSize;
+    size = std::max<uint64_t>(size,localWorkSize);
+    activeWorkSize = std::min<uint64_t>(size,deviceConfig.globalWorkSize);
+}
+
+void GPUCracker::releasePasswords(PipelineSlot &slot) {
+    // Upload of batch has finished together with the kernel
+    if(slot.batch != NULL){
+        producerPool->releaseBatch(consumer, slot.batch);
+        slot.batch = NULL;
+    }
+}
+
+void GPUCracker::filterPositivePasswords() {
+}
+
+void GPUCracker::verifyPositivePasswords() {
+    filterPositivePasswords();
+    std::string noData;
+    for(uint32_t i = 0;i<positivePasswords.size();i++){
+        const std::string &data = i < positiveData.size() ? positiveData[i] : noData;
+        // Device continues while the password is verified in pool
+        if(verifierPool != NULL && verifierPool->submit(positivePasswords[i],data,&pendingVerifications))
+            continue;
+        // Queue of pool is full, verify it here
+        if(verifyPassword(positivePasswords[i],data)){
+            pass_found = true;
+            password.assign(positivePasswords[i]);
+            break;
+        }
+    }
+    positivePasswords.clear();
+    positiveData.clear();
+}
+
+void GPUCracker::checkVerifiedPasswords() {
+    std::string pass;
+    if(verifierPool != NULL && !pass_found && verifierPool->getResult(pass)){
+        pass_found = true;
+        password.assign(pass);
+    }
+}
+
+void GPUCracker::stopPersistentKernels() {
+    if(!persistentKernel || stopFlag != 0)
+        return;
+    // Main queue has no kernels, so the write isn't queued behind slots.
+    // Running kernels aren't guaranteed to see it, so the flag is only a hint
+    // and stop latency is bounded by time limit of windows.
+    stopFlag = 1;
+    cl::Event written;
+    que.enqueueWriteBuffer(stopFlagBuffer,CL_FALSE,0,sizeof(cl_uint),&stopFlag,NULL,&written);
+    que.flush();
+    written.wait();
+}
+
 void GPUCracker::debugKernel(int clFinishRes) {
 
 }
@@ -131,182 +368,707 @@ bool GPUCracker::verifyPassword(std::string &pass) {
     return true;
 }
 
+bool GPUCracker::verifyPassword(std::string &pass, const std::string &data) {
+    return verifyPassword(pass);
+}
+
 
 bool GPUCracker::initDevice(){
     device = devices[deviceConfig.platform].devices[deviceConfig.device];
     context = cl::Context(device);    
+    que = cl::CommandQueue(context,device);
+    userParamIndex = 4;
+    passgenArgIndex = userParamIndex;
     
-    // check passgen GPU support
-    PassGen::KernelCode *passGpuCode = passgen->getKernelCode();
-    if(passGpuCode != NULL){
-        loadKernel(passGpuCode->filename, passGpuCode->name, &this->passgenKernel, &this->passgenProgram);
+    // CPU compilers rarely vectorize scalar kernels, so work item of CPU
+    // cracks consecutive candidates in lanes of vector kernel. It reads them
+    // from buffer, passgen isn't fused into it.
+    if(!vectorKernelName.empty() && cpuVectorWidth > 0 && (device.getInfo<CL_DEVICE_TYPE>() & CL_DEVICE_TYPE_CPU)){
+        vectorWidth = cpuVectorWidth;
+        kernelName = vectorKernelName;
+        itemCandidates = vectorWidth;
+    }
+    
+    // Passgen in GPU is fused into cracking kernel if possible, so passwords
+    // aren't stored in global memory
+    PassGen::KernelCode *fusedCode = fusePassGen && vectorWidth == 0 ? passgen->getFusedCode() : NULL;
+    std::vector<std::string> fusedHeaders;
+    if(fusedCode != NULL)
+        fusedHeaders = {FUSED_HEADER, fusedCode->filename};
+    if(fusedCode != NULL && loadKernel(kernelFile, kernelName, &this->kernel, &this->program, fusedBuildOptions(), fusedHeaders)){
+        // Arguments of passgen follow common arguments, so user params are shifted
+        userParamIndex += passgen->initFusedKernel(&kernel, &que, &context, passgenArgIndex);
         GPUPassGen = true;
-        passgen->setKernelGWS(deviceConfig.globalWorkSize);
+        fusedPassGen = true;
+        if(persistentKernels){
+            // Work counter, stop flag and window precede user params
+            persistentKernel = true;
+            persistentArgIndex = userParamIndex;
+            userParamIndex += 3;
+        }
+    }else{
+        // check passgen GPU support
+        PassGen::KernelCode *passGpuCode = passgen->getKernelCode();
+        if(passGpuCode != NULL){
+            std::stringstream options;
+            options << "-DMAX_PASS_LEN=" << (uint32_t)passgen->maxPassLen() << " " << passGpuCode->options;
+            if(!loadKernel(passGpuCode->filename, passGpuCode->name, &this->passgenKernel, &this->passgenProgram, options.str(), {CANDIDATE_HEADER}))
+                return false;
+            GPUPassGen = true;
+        }
+        if(!loadKernel(kernelFile, kernelName, &this->kernel, &this->program, crackBuildOptions(), {CANDIDATE_HEADER}))
+            return false;
+    }
+    if(buildLengthKernels && GPUPassGen){
+        loadLengthKernels(fusedPassGen ? fusedHeaders : std::vector<std::string>{CANDIDATE_HEADER});
     }
     
-    que = cl::CommandQueue(context,device);
+    // Fused kernel reports only index of password, it's created again by passgen
+    foundEntryWords = fusedPassGen ? 1 : 2 + CandidateBuffer::words(passgen->maxPassLen());
     
-    loadKernel(kernelFile, kernelName, &this->kernel, &this->program);
-    uint32_t max_passwds_len = deviceConfig.globalWorkSize*(passgen->maxPassLen()+1);
-    passwdsToGPU = new char[max_passwds_len];
-    passwdsFromGPU = new char[max_passwds_len];
+    tuneWorkSize();
+    // Found queue has entry for every candidate of slot, so no hit is dropped
+    // (slot of chunked launches has at most global work size of passwords)
+    foundCapacity = deviceConfig.globalWorkSize;
+    if(persistentKernel){
+        // Persistent kernel cracks window of several global work sizes
+        uint32_t computeUnits = device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+        maxWindowSize = deviceConfig.globalWorkSize*PERSISTENT_WINDOW_STEPS;
+        // Kernel of global work size is tuned to be short, window grows from it
+        windowSize = deviceConfig.globalWorkSize;
+        persistentWorkSize = std::min(std::max(computeUnits,1u)*localWorkSize*PERSISTENT_GROUPS_PER_UNIT,deviceConfig.globalWorkSize);
+        foundCapacity = maxWindowSize;
+    }
+    if(GPUPassGen){
+        passgen->setKernelGWS(deviceConfig.globalWorkSize);
+    }
     
     return true;
 }
 
-bool GPUCracker::loadKernel(std::string& filename, std::string& kernelName, cl::Kernel *kernel, cl::Program *program) {
+void GPUCracker::tuneWorkSize(){
+    uint32_t gws, lws;
+    std::string key = tuningKey();
     
-    cl::Program::Sources sources;
-    cl::Program::Binaries binaries;
+    if(loadTuning(key,&gws,&lws)){
+        localWorkSize = lws;
+        if(deviceConfig.globalWorkSize == 0)
+            deviceConfig.globalWorkSize = gws;
+    }else if(deviceConfig.globalWorkSize == 0){
+        // Timed runs need all arguments of kernel (stride is set for each run)
+        if(initData()){
+            autotune();
+            saveTuning(key,deviceConfig.globalWorkSize,localWorkSize);
+        }
+    }
+    if(deviceConfig.globalWorkSize == 0)
+        deviceConfig.globalWorkSize = DEFAULT_GLOBAL_WORK_SIZE;
+    
+    // Local size has to be supported by kernels and divide global size
+    size_t maxLocal = kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device);
+    if(GPUPassGen && !fusedPassGen)
+        maxLocal = std::min(maxLocal,passgenKernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device));
+    if(localWorkSize > maxLocal)
+        localWorkSize = maxLocal;
+    // Kernels with local arrays are compiled for one local size
+    size_t required = kernel.getWorkGroupInfo<CL_KERNEL_COMPILE_WORK_GROUP_SIZE>(device)[0];
+    if(required > 0)
+        localWorkSize = required;
+    // Vector kernels load whole vectors, so global size is also multiple of their width
+    uint32_t multiple = localWorkSize;
+    while(vectorWidth > 0 && multiple % vectorWidth != 0)
+        multiple += localWorkSize;
+    deviceConfig.globalWorkSize = (deviceConfig.globalWorkSize + multiple - 1) / multiple * multiple;
+    localSize = cl::NDRange(localWorkSize);
+}
+
+void GPUCracker::autotune(){
+    size_t multiple = kernel.getWorkGroupInfo<CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE>(device);
+    size_t maxLocal = kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device);
+    if(GPUPassGen && !fusedPassGen)
+        maxLocal = std::min(maxLocal,passgenKernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device));
+    maxLocal = std::min<size_t>(maxLocal,TUNING_MAX_LOCAL_SIZE);
+    if(multiple == 0 || multiple > maxLocal)
+        multiple = maxLocal;
+    // Only global size is tuned if local size is set by reqd_work_group_size
+    size_t required = kernel.getWorkGroupInfo<CL_KERNEL_COMPILE_WORK_GROUP_SIZE>(device)[0];
+    if(required > 0)
+        multiple = maxLocal = required;
     
-    std::ifstream input_program;
-    std::ofstream output_program;
+    uint32_t computeUnits = device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+    uint32_t maxGWS = maxGlobalWorkSize();
+    double kernelTime, speed, bestSpeed = 0;
     
-    std::stringstream ss;
-    bool loadBinary = false;
+    std::cout << "Tuning work size for " << device.getInfo<CL_DEVICE_NAME>() << std::endl;
     
-    ss << filename << "." << deviceConfig.platform << "_" << deviceConfig.device << ".clbin";
+    // Local size is multiple of preferred size, global size is the same for all of them
+    uint32_t bestLocal = multiple;
+    uint32_t probeGWS = std::min<uint32_t>(computeUnits*maxLocal*TUNING_GROUPS_PER_UNIT,maxGWS);
+    for(uint32_t lws = multiple;lws <= maxLocal;lws *= 2){
+        uint32_t gws = probeGWS / lws * lws;
+        if(gws == 0)
+            break;
+        speed = benchmarkWorkSize(gws,lws,&kernelTime);
+        if(speed > bestSpeed){
+            bestSpeed = speed;
+            bestLocal = lws;
+        }
+    }
     
-    std::string binrayFilename = ss.str();
+    // Global size grows until device is saturated or kernel takes too long
+    uint32_t bestGlobal = std::max<uint32_t>(std::min(computeUnits*bestLocal,maxGWS) / bestLocal * bestLocal,bestLocal);
+    bestSpeed = 0;
+    for(uint32_t gws = bestGlobal;gws <= maxGWS;gws *= 2){
+        speed = benchmarkWorkSize(gws,bestLocal,&kernelTime);
+        if(speed > bestSpeed*TUNING_MIN_GAIN){
+            bestSpeed = speed;
+            bestGlobal = gws;
+        }
+        if(kernelTime > TUNING_MAX_KERNEL_TIME)
+            break;
+    }
     
-    uint64_t binaryChangedTS = Utils::getFileModificationTS(binrayFilename);
-    uint64_t sourceChangedTS = Utils::getFileModificationTS(filename);
+    deviceConfig.globalWorkSize = bestGlobal;
+    localWorkSize = bestLocal;
+    std::cout << "Tuned " << device.getInfo<CL_DEVICE_NAME>() << ": GWS " << bestGlobal << ", local size " << bestLocal << std::endl;
+}
+
+double GPUCracker::benchmarkWorkSize(uint32_t gws, uint32_t lws, double *kernelTime){
+    if(vectorWidth > 0)
+        gws = (gws + vectorWidth - 1) / vectorWidth * vectorWidth;
+    uint32_t len = passgen->maxPassLen() < TUNING_PASS_LENGTH ? passgen->maxPassLen() : TUNING_PASS_LENGTH;
     
-    //loadBinary = binaryChangedTS > sourceChangedTS;
+    // Dummy passwords of common length
+    std::vector<char> passwords(CandidateBuffer::size(gws,passgen->maxPassLen()),0);
+    std::string dummy(len,'a');
+    for(uint32_t i = 0;i<gws;i++){
+        CandidateBuffer::store(passwords.data(),gws,i,dummy.data(),len);
+    }
+    cl_uint count = 0;
     
-    // open compiled program if exists
-    if(loadBinary){
-        input_program.open(binrayFilename,std::ios::binary);
-        std::string kernel_code((std::istreambuf_iterator<char>(input_program)),
-                     std::istreambuf_iterator<char>());
-        input_program.close();
+    *kernelTime = 0;
+    try{
+        cl::Buffer passwordBuffer(context,CL_MEM_READ_ONLY,sizeof(char)*passwords.size());
+        cl::Buffer countBuffer(context,CL_MEM_READ_WRITE,sizeof(cl_uint));
+        cl::Buffer queueBuffer(context,CL_MEM_READ_WRITE,sizeof(cl_uint)*foundEntryWords*gws);
+        que.enqueueWriteBuffer(passwordBuffer,CL_TRUE,0,sizeof(char)*passwords.size(),passwords.data());
+        que.enqueueWriteBuffer(countBuffer,CL_TRUE,0,sizeof(cl_uint),&count);
         
-        std::pair<const char*, ::size_t> binary;
-        binary.first = kernel_code.c_str();
-        binary.second = kernel_code.length();
-        binaries.push_back(binary);
+        // Stride is also capacity of found queue
+        kernel.setArg(0,passwordBuffer);
+        kernel.setArg(1,(cl_uint)gws);
+        kernel.setArg(2,countBuffer);
+        kernel.setArg(3,queueBuffer);
         
-        std::vector<cl::Device> devices;
-        devices.push_back(device);
-        std::vector<cl_int> status;
-        status.push_back(CL_INVALID_BINARY);
-        cl_int err;
-        *program = cl::Program(context,devices,binaries,&status,&err);
-        if(status[0] != CL_SUCCESS){
-            *kernel = NULL;
-            return false;
+        // Persistent kernel cracks window of work size, counter is reset before each run
+        cl::Buffer counterBuffer(context,CL_MEM_READ_WRITE,sizeof(cl_uint));
+        cl::Buffer flagBuffer(context,CL_MEM_READ_ONLY,sizeof(cl_uint));
+        if(persistentKernel){
+            que.enqueueWriteBuffer(flagBuffer,CL_TRUE,0,sizeof(cl_uint),&count);
+            kernel.setArg(persistentArgIndex,counterBuffer);
+            kernel.setArg(persistentArgIndex+1,flagBuffer);
+            kernel.setArg(persistentArgIndex+2,(cl_uint)gws);
+            que.enqueueWriteBuffer(counterBuffer,CL_TRUE,0,sizeof(cl_uint),&count);
         }
         
-        if(program->build(devices)!=CL_SUCCESS){
-            std::cerr<<" Error building: \n"<<(*program).getBuildInfo<CL_PROGRAM_BUILD_LOG>(device)<< std::endl;
-            *kernel = NULL;
-            return false;
+        // Work item cracks several candidates, so fewer items crack the buffer
+        uint32_t items = (gws / itemCandidates + lws - 1) / lws * lws;
+        
+        // First run isn't measured (lazy initialization in driver)
+        que.enqueueNDRangeKernel(kernel,cl::NullRange,cl::NDRange(items),cl::NDRange(lws));
+        que.finish();
+        
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC,&start);
+        for(uint32_t i = 0;i<TUNING_RUNS;i++){
+            if(persistentKernel)
+                que.enqueueWriteBuffer(counterBuffer,CL_FALSE,0,sizeof(cl_uint),&count);
+            que.enqueueNDRangeKernel(kernel,cl::NullRange,cl::NDRange(items),cl::NDRange(lws));
         }
+        que.finish();
+        clock_gettime(CLOCK_MONOTONIC,&end);
         
-    }else{
-        input_program.open(filename);
-        std::string kernel_code((std::istreambuf_iterator<char>(input_program)),
-                     std::istreambuf_iterator<char>());
-        input_program.close();
+        double elapsed = (end.tv_sec - start.tv_sec);
+        elapsed += (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+        *kernelTime = elapsed / TUNING_RUNS;
+        return elapsed > 0 ? gws*TUNING_RUNS/elapsed : 0;
+    }catch(cl::Error &err){
+        // Work size isn't supported or buffers don't fit into memory
+        return 0;
+    }
+}
 
-        std::pair<const char*, ::size_t> source;
-        source.first = kernel_code.c_str();
-        source.second = kernel_code.length();
-        sources.push_back(source);
+uint32_t GPUCracker::maxGlobalWorkSize(){
+    uint64_t entryLength = CandidateBuffer::size(1,passgen->maxPassLen());
+    uint64_t maxAlloc = device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>();
+    uint64_t globalMem = device.getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>();
+    
+    // Every slot of pipeline has its own password buffer
+    uint64_t limit = std::min(maxAlloc / entryLength,globalMem / TUNING_MEM_FRACTION / (entryLength*pipelineDepth));
+    return std::min<uint64_t>(limit,TUNING_MAX_GLOBAL_SIZE);
+}
 
-        *program = cl::Program(context,sources);
+std::string GPUCracker::tuningKey(){
+    PassGen::KernelCode *passGpuCode = passgen->getKernelCode();
+    std::stringstream ss;
+    ss << device.getInfo<CL_DEVICE_NAME>() << "|" << device.getInfo<CL_DRIVER_VERSION>() << "|" << kernelName << "|";
+    ss << (passGpuCode != NULL ? passGpuCode->name : "host") << (fusedPassGen ? "+fused" : "") << (persistentKernel ? "+persistent" : "") << "|" << (uint32_t)passgen->maxPassLen();
+    return ss.str();
+}
+
+bool GPUCracker::loadTuning(const std::string &key, uint32_t *gws, uint32_t *lws){
+    bool found = false;
+    pthread_mutex_lock(&tuningMutex);
+    std::ifstream in(TUNING_CACHE_FILE);
+    std::string line;
+    // Line format: <key>\t<GWS>\t<local size>
+    while(std::getline(in,line)){
+        std::stringstream ss(line);
+        std::string lineKey;
+        if(std::getline(ss,lineKey,'\t') && lineKey == key && (ss >> *gws >> *lws) && *gws > 0 && *lws > 0){
+            found = true;
+        }
+    }
+    pthread_mutex_unlock(&tuningMutex);
+    return found;
+}
+
+void GPUCracker::saveTuning(const std::string &key, uint32_t gws, uint32_t lws){
+    pthread_mutex_lock(&tuningMutex);
+    std::vector<std::string> lines;
+    std::ifstream in(TUNING_CACHE_FILE);
+    std::string line;
+    while(std::getline(in,line)){
+        if(line.compare(0,key.length()+1,key+"\t") != 0)
+            lines.push_back(line);
+    }
+    in.close();
+    
+    std::stringstream ss;
+    ss << key << "\t" << gws << "\t" << lws;
+    lines.push_back(ss.str());
+    
+    std::ofstream out(TUNING_CACHE_FILE,std::ios::trunc);
+    for(std::vector<std::string>::iterator i = lines.begin();i != lines.end();i++){
+        out << *i << std::endl;
+    }
+    pthread_mutex_unlock(&tuningMutex);
+}
+
+std::string GPUCracker::kernelBuildOptions(){
+    std::stringstream ss;
+    ss << "-DMAX_PASS_LEN=" << (uint32_t)passgen->maxPassLen();
+    return ss.str();
+}
+
+std::string GPUCracker::fusedBuildOptions(){
+    return persistentKernels ? kernelBuildOptions() + " -DPERSISTENT" : kernelBuildOptions();
+}
+
+std::string GPUCracker::crackBuildOptions(){
+    std::stringstream ss;
+    ss << kernelBuildOptions();
+    if(vectorWidth > 0)
+        ss << " -DVECTOR_WIDTH=" << vectorWidth;
+    return ss.str();
+}
 
-        std::vector<cl::Device> devices;
-        devices.push_back(device);
-        int build_res = program->build(devices);
-        if(build_res !=CL_SUCCESS){
-            std::cerr<<" Error building: \n"<<(*program).getBuildInfo<CL_PROGRAM_BUILD_LOG>(device)<< std::endl;
+std::string GPUCracker::defineBytes(const char *name, const uint8_t *bytes, uint32_t len){
+    std::stringstream ss;
+    // Option can't contain spaces, initializer is one token
+    ss << "-D" << name << "={" << std::hex;
+    for(uint32_t i = 0;i<len;i++){
+        ss << (i > 0 ? "," : "") << "0x" << (uint32_t)bytes[i];
+    }
+    ss << "}";
+    return ss.str();
+}
+
+std::string GPUCracker::defineWords(const char *name, const uint8_t *bytes, uint32_t len){
+    std::stringstream ss;
+    ss << "-D" << name << "={" << std::hex;
+    for(uint32_t i = 0;i<len/4;i++){
+        uint32_t word = ((uint32_t)bytes[4*i] << 24) | (bytes[4*i+1] << 16) | (bytes[4*i+2] << 8) | bytes[4*i+3];
+        ss << (i > 0 ? "," : "") << "0x" << word << "u";
+    }
+    ss << "}";
+    return ss.str();
+}
+
+bool GPUCracker::loadKernel(std::string& filename, std::string& kernelName, cl::Kernel *kernel, cl::Program *program, const std::string &options, const std::vector<std::string> &headers) {
+    
+    std::string source, headerSource;
+    if(!KernelSources::get(filename,source)){
+        std::cerr << "Kernel " << filename << " not found" << std::endl;
+        *kernel = NULL;
+        return false;
+    }
+    for(uint32_t i = 0;i<headers.size();i++){
+        std::string part;
+        if(!KernelSources::get(headers[i],part)){
+            std::cerr << "Kernel " << headers[i] << " not found" << std::endl;
             *kernel = NULL;
-            return false ;
+            return false;
+        }
+        headerSource += part + "\n";
+    }
+    source = headerSource + source;
+    if(!kernelLibrary.empty() && filename == kernelFile){
+        // Library follows header, so it can use its macros
+        std::string librarySource;
+        if(!KernelSources::get(kernelLibrary,librarySource)){
+            std::cerr << "Kernel " << kernelLibrary << " not found" << std::endl;
+            *kernel = NULL;
+            return false;
+        }
+        source.insert(headerSource.length(),librarySource + "\n");
+    }
+    // Program is identified by everything which changes its binary
+    std::string id = source;
+    id.append(1,'\0').append(options);
+    id.append(1,'\0').append(device.getInfo<CL_DEVICE_NAME>());
+    id.append(1,'\0').append(device.getInfo<CL_DRIVER_VERSION>());
+    uint64_t key = Utils::fnv1a(id.c_str(),id.length());
+    
+    std::stringstream ss;
+    ss << filename << "." << std::hex << key << ".clbin";
+    std::string binaryFilename = ss.str();
+    
+    // Same program is built only once (e.g. for several same devices)
+    std::string binary;
+    bool owner = false;
+    pthread_mutex_lock(&programMutex);
+    while(programsBuilding.count(key) > 0){
+        pthread_cond_wait(&programBuilt,&programMutex);
+    }
+    std::map<uint64_t, std::string>::iterator built = programBinaries.find(key);
+    if(built != programBinaries.end()){
+        binary = built->second;
+    }else{
+        programsBuilding.insert(key);
+        owner = true;
+    }
+    pthread_mutex_unlock(&programMutex);
+    
+    std::vector<cl::Device> devices;
+    devices.push_back(device);
+    bool loaded = false;
+    
+    if(binary.empty()){
+        binary = readProgramBinary(binaryFilename,key);
+    }
+    if(!binary.empty()){
+        cl::Program::Binaries binaries;
+        binaries.push_back(std::make_pair(binary.c_str(),binary.length()));
+        std::vector<cl_int> status;
+        try{
+            *program = cl::Program(context,devices,binaries,&status);
+            loaded = status.size() > 0 && status[0] == CL_SUCCESS && buildProgram(program,options);
+        }catch(cl::Error &err){
+            // Binary isn't valid for the device, it is rebuilt from source
+            loaded = false;
         }
-        
-        //save compiled program
-        output_program.open(binrayFilename,std::ios::binary);
-        uint32_t binary_size = program->getInfo<CL_PROGRAM_BINARY_SIZES>()[0];
-        char* binary = program->getInfo<CL_PROGRAM_BINARIES>()[0];
-        output_program.write(binary,binary_size);
-        output_program.close();
-        
+    }
+    
+    if(!loaded){
+        cl::Program::Sources sources;
+        sources.push_back(std::make_pair(source.c_str(),source.length()));
+        *program = cl::Program(context,sources);
+        loaded = buildProgram(program,options);
+        binary.clear();
+        if(loaded){
+            // Program is built for one device, so it has one binary
+            std::vector< ::size_t> sizes = program->getInfo<CL_PROGRAM_BINARY_SIZES>();
+            if(sizes.size() > 0 && sizes[0] > 0){
+                binary.resize(sizes[0]);
+                char *binaryPtr = &binary[0];
+                if(clGetProgramInfo((*program)(),CL_PROGRAM_BINARIES,sizeof(char*),&binaryPtr,NULL) == CL_SUCCESS)
+                    writeProgramBinary(binaryFilename,key,binary);
+                else
+                    binary.clear();
+            }
+        }
+    }
+    
+    if(owner){
+        pthread_mutex_lock(&programMutex);
+        if(loaded && !binary.empty()){
+            programBinaries[key] = binary;
+        }
+        programsBuilding.erase(key);
+        pthread_cond_broadcast(&programBuilt);
+        pthread_mutex_unlock(&programMutex);
+    }
+    
+    if(!loaded){
+        *kernel = NULL;
+        return false;
     }
     *kernel = cl::Kernel(*program,kernelName.c_str());
     return true;
 }
 
+bool GPUCracker::buildProgram(cl::Program *program, const std::string &options) {
+    std::vector<cl::Device> devices;
+    devices.push_back(device);
+    try{
+        if(program->build(devices,options.c_str()) == CL_SUCCESS)
+            return true;
+    }catch(cl::Error &err){
+    }
+    std::cerr<<" Error building: \n"<<(*program).getBuildInfo<CL_PROGRAM_BUILD_LOG>(device)<< std::endl;
+    return false;
+}
 
-bool GPUCracker::passFound(){
-    this->que.enqueueReadBuffer(this->foundFlagBuffer,CL_TRUE,0,sizeof(char),&foundFlag);
-    return foundFlag == 1;
+std::string GPUCracker::readProgramBinary(const std::string &filename, uint64_t key) {
+    std::ifstream input(filename.c_str(),std::ios::binary);
+    if(!input.is_open())
+        return "";
+    
+    // Format: magic, key, size, binary, hash of binary
+    uint32_t magic = 0;
+    uint64_t fileKey = 0, size = 0, hash = 0;
+    input.read(reinterpret_cast<char*>(&magic),sizeof(magic));
+    input.read(reinterpret_cast<char*>(&fileKey),sizeof(fileKey));
+    input.read(reinterpret_cast<char*>(&size),sizeof(size));
+    if(!input || magic != PROGRAM_CACHE_MAGIC || fileKey != key || size == 0 || size > (1 << 30))
+        return "";
+    
+    std::string binary(size,'\0');
+    input.read(&binary[0],size);
+    input.read(reinterpret_cast<char*>(&hash),sizeof(hash));
+    if(!input || hash != Utils::fnv1a(binary.c_str(),binary.length()))
+        return "";
+    return binary;
 }
 
-void GPUCracker::loadPositvePasswords(){
-    uint32_t entry_length = passgen->maxPassLen() + 1;
-    uint32_t bitmapSize = deviceConfig.globalWorkSize/32;
-    this->que.enqueueReadBuffer(this->foundBitmapBuffer,CL_FALSE,0,sizeof(uint32_t)*bitmapSize,foundBitmap);
-    this->que.enqueueReadBuffer(this->passwordBuffer,CL_TRUE,0,sizeof(char)*entry_length*deviceConfig.globalWorkSize,passwdsFromGPU);
+void GPUCracker::writeProgramBinary(const std::string &filename, uint64_t key, const std::string &binary) {
+    // Written into temporary file first, so other processes never see a partial binary
+    std::string tmpFilename = filename + ".tmp";
+    std::ofstream output(tmpFilename.c_str(),std::ios::binary);
+    if(!output.is_open())
+        return;
+    
+    uint32_t magic = PROGRAM_CACHE_MAGIC;
+    uint64_t size = binary.length();
+    uint64_t hash = Utils::fnv1a(binary.c_str(),binary.length());
+    output.write(reinterpret_cast<const char*>(&magic),sizeof(magic));
+    output.write(reinterpret_cast<const char*>(&key),sizeof(key));
+    output.write(reinterpret_cast<const char*>(&size),sizeof(size));
+    output.write(binary.c_str(),binary.length());
+    output.write(reinterpret_cast<const char*>(&hash),sizeof(hash));
+    output.close();
+    
+    if(output)
+        std::rename(tmpFilename.c_str(),filename.c_str());
+    else
+        std::remove(tmpFilename.c_str());
+}
+
+bool GPUCracker::passFound(PipelineSlot &slot){
+    slot.resultsRead.wait();
+    return slot.foundCount > 0;
+}
+
+void GPUCracker::loadPositvePasswords(PipelineSlot &slot){
+    // Queue has entry for every candidate of slot, so it overflows only if
+    // capacity is wrong. Hits beyond it were dropped by kernel, so all
+    // passwords of slot are verified.
+    if(slot.foundCount > foundCapacity){
+        if(!foundOverflowReported){
+            std::cerr << "Found queue overflowed (" << slot.foundCount << " > " << foundCapacity
+                      << " passwords), verifying all passwords of slot" << std::endl;
+            foundOverflowReported = true;
+        }
+        loadSlotPasswords(slot);
+        slot.foundCount = 0;
+        slot.que.enqueueWriteBuffer(slot.foundCountBuffer,CL_FALSE,0,sizeof(cl_uint),&slot.foundCount);
+        return;
+    }
+    uint32_t count = slot.foundCount;
+    foundEntries.resize(count*foundEntryWords);
+    slot.que.enqueueReadBuffer(slot.foundQueueBuffer,CL_TRUE,0,sizeof(cl_uint)*foundEntries.size(),foundEntries.data());
+    
     std::string pass;
-    for(uint32_t i = 0;i<bitmapSize;i++){
-        if(foundBitmap[i] > 0){
-            uint32_t passpos = i*32;
-            uint32_t val = foundBitmap[i];
-            for(uint8_t j = 0;val > 0;j++){
-                if((val & 0x80000000) != 0){
-                    char* passptr = passwdsFromGPU+entry_length*(passpos+j);
-                    pass.assign(passptr+1 , *passptr);
-                    positivePasswords.push_back(pass);
-                }
-                val <<= 1;
-            }
-            foundBitmap[i] = 0;
+    for(uint32_t i = 0;i<count;i++){
+        cl_uint *entry = &foundEntries[i*foundEntryWords];
+        if(fusedPassGen){
+            pass = passgen->getPassword(slot.firstIndex+entry[0]);
+            if(pass.empty())
+                continue;
+        }else{
+            pass.assign(reinterpret_cast<char*>(entry+2),entry[1]);
+        }
+        positivePasswords.push_back(pass);
+    }
+    // Clear counter in device (next kernel of slot is enqueued after this)
+    slot.foundCount = 0;
+    slot.que.enqueueWriteBuffer(slot.foundCountBuffer,CL_FALSE,0,sizeof(cl_uint),&slot.foundCount);
+}
+
+void GPUCracker::loadSlotPasswords(PipelineSlot &slot){
+    if(fusedPassGen){
+        // Passwords of window are created again by passgen
+        for(uint32_t i = 0;i<slot.count;i++){
+            std::string pass = passgen->getPassword(slot.firstIndex+i);
+            if(!pass.empty())
+                positivePasswords.push_back(pass);
         }
+        return;
+    }
+    // Buffer in device holds passwords of host and of GPU passgen
+    std::vector<char> passwords(CandidateBuffer::size(deviceConfig.globalWorkSize,passgen->maxPassLen()));
+    slot.que.enqueueReadBuffer(slot.passwordBuffer,CL_TRUE,0,passwords.size(),passwords.data());
+    for(uint32_t i = 0;i<slot.count;i++){
+        positivePasswords.push_back(CandidateBuffer::load(passwords.data(),deviceConfig.globalWorkSize,i));
     }
-    foundFlag = 0;
-    que.enqueueWriteBuffer(foundFlagBuffer,CL_FALSE,0,sizeof(char),&foundFlag);
-    que.enqueueWriteBuffer(foundBitmapBuffer,CL_FALSE,0,sizeof(uint32_t)*bitmapSize,foundBitmap);
 }
 
 bool GPUCracker::initCommonData(){
     
-    foundFlag = 0;
-    uint32_t bitmapSize = ceil(deviceConfig.globalWorkSize/32.0);
-    foundBitmap = new uint32_t[bitmapSize];
-    for(uint32_t i = 0;i<bitmapSize;i++){
-        foundBitmap[i] = 0;
-    }
-    if(GPUPassGen)
-        passwordBuffer = cl::Buffer(context,CL_MEM_READ_WRITE,sizeof(char)*deviceConfig.globalWorkSize*(passgen->maxPassLen()+1));
-    else
-        passwordBuffer = cl::Buffer(context,CL_MEM_READ_ONLY,sizeof(char)*deviceConfig.globalWorkSize*(passgen->maxPassLen()+1));
+    uint32_t passwordsSize = CandidateBuffer::size(deviceConfig.globalWorkSize,passgen->maxPassLen());
     
-    foundFlagBuffer = cl::Buffer(context,CL_MEM_WRITE_ONLY,sizeof(char));
-    foundBitmapBuffer = cl::Buffer(context,CL_MEM_WRITE_ONLY,sizeof(uint32_t)*bitmapSize);
+    slots.resize(pipelineDepth);
+    for(std::vector<PipelineSlot>::iterator i = slots.begin();i != slots.end();i++){
+        PipelineSlot &slot = *i;
+        slot.que = cl::CommandQueue(context,device,CL_QUEUE_PROFILING_ENABLE);
+        slot.foundCount = 0;
+        slot.passwords = NULL;
+        slot.batch = NULL;
+        slot.firstIndex = 0;
+        slot.count = 0;
+        slot.length = 0;
+        slot.workSize = 0;
+        slot.chunkSize = 0;
+        slot.active = false;
+        
+        if(fusedPassGen){
+            // Fused kernel doesn't read password buffer, but its argument has to be set
+            slot.passwordBuffer = cl::Buffer(context,CL_MEM_READ_ONLY,CandidateBuffer::size(1,passgen->maxPassLen()));
+        }else if(GPUPassGen){
+            slot.passwordBuffer = cl::Buffer(context,CL_MEM_READ_WRITE,sizeof(char)*passwordsSize);
+        }else if(producerPool != NULL){
+            slot.passwordBuffer = cl::Buffer(context,CL_MEM_READ_ONLY,sizeof(char)*passwordsSize);
+        }else{
+            slot.passwordBuffer = cl::Buffer(context,CL_MEM_READ_ONLY,sizeof(char)*passwordsSize);
+            // Passwords are prepared directly in pinned memory
+            slot.stagingBuffer = cl::Buffer(context,CL_MEM_READ_WRITE|CL_MEM_ALLOC_HOST_PTR,sizeof(char)*passwordsSize);
+            slot.passwords = reinterpret_cast<char*>(slot.que.enqueueMapBuffer(slot.stagingBuffer,CL_TRUE,CL_MAP_WRITE,0,sizeof(char)*passwordsSize));
+            memset(slot.passwords,0,sizeof(char)*passwordsSize);
+        }
+        
+        slot.foundCountBuffer = cl::Buffer(context,CL_MEM_READ_WRITE,sizeof(cl_uint));
+        slot.foundQueueBuffer = cl::Buffer(context,CL_MEM_READ_WRITE,sizeof(cl_uint)*foundEntryWords*foundCapacity);
+        if(persistentKernel)
+            slot.workCounterBuffer = cl::Buffer(context,CL_MEM_READ_WRITE,sizeof(cl_uint));
+        
+        slot.que.enqueueWriteBuffer(slot.foundCountBuffer,CL_TRUE,0,sizeof(cl_uint),&slot.foundCount);
+    }
     
-    que.enqueueWriteBuffer(foundFlagBuffer,CL_FALSE,0,sizeof(char),&foundFlag);
-    que.enqueueWriteBuffer(foundBitmapBuffer,CL_TRUE,0,sizeof(uint32_t)*bitmapSize,foundBitmap);
+    if(persistentKernel){
+        stopFlag = 0;
+        stopFlagBuffer = cl::Buffer(context,CL_MEM_READ_ONLY,sizeof(cl_uint));
+        que.enqueueWriteBuffer(stopFlagBuffer,CL_TRUE,0,sizeof(cl_uint),&stopFlag);
+    }
     
-    cl_uchar pass_entry_length = passgen->maxPassLen() + PASS_EXTRA_BYTES;
-//    cl_uchar pass_entry_length = passgen->maxPassLen();
+    // Words of passwords are strided by capacity of password buffer (capacity
+    // of found queue for fused kernel, which doesn't read the buffer)
+    cl_uint stride = fusedPassGen ? foundCapacity : deviceConfig.globalWorkSize;
 
-    kernel.setArg(0,passwordBuffer);
-    kernel.setArg(1,pass_entry_length);
-    kernel.setArg(2,foundFlagBuffer);
-    kernel.setArg(3,foundBitmapBuffer);
-    userParamIndex = 4;
+    // Controller starts with one work-group per compute unit, so first kernels are short
+    uint32_t computeUnits = device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+    activeWorkSize = std::min(std::max(computeUnits,1u)*localWorkSize,deviceConfig.globalWorkSize);
 
-    if(GPUPassGen)
+    if(!GPUPassGen && producerPool != NULL){
+        // More batches than slots, so producers can work ahead of device
+        uint32_t numBatches = BATCHES_PER_SLOT*pipelineDepth;
+        std::vector<PasswordBatch*> batchPtrs;
+        batchBuffers.resize(numBatches);
+        batches.resize(numBatches);
+        for(uint32_t i = 0;i<numBatches;i++){
+            batchBuffers[i] = cl::Buffer(context,CL_MEM_READ_WRITE|CL_MEM_ALLOC_HOST_PTR,sizeof(char)*passwordsSize);
+            batches[i].passwords = reinterpret_cast<char*>(que.enqueueMapBuffer(batchBuffers[i],CL_TRUE,CL_MAP_WRITE,0,sizeof(char)*passwordsSize));
+            memset(batches[i].passwords,0,sizeof(char)*passwordsSize);
+            batchPtrs.push_back(&batches[i]);
+        }
+        consumer = producerPool->addConsumer(batchPtrs,deviceConfig.globalWorkSize);
+    }
+
+    // Arguments 0, 2 and 3 are set for each slot
+    kernel.setArg(1,stride);
+
+    if(GPUPassGen && !fusedPassGen)
     {
-      passgenKernel.setArg(0,passwordBuffer);
-      passgenKernel.setArg(1,pass_entry_length);
+      passgenKernel.setArg(1,stride);
       passgen->initKernel(&passgenKernel, &que, &context);
     }
     return true;
 }
 
+void GPUCracker::loadLengthKernels(const std::vector<std::string> &headers){
+    uint32_t minLength, maxLength;
+    if(!passgen->kernelStepLengths(&minLength,&maxLength) || maxLength - minLength >= MAX_LENGTH_KERNELS)
+        return;
+    
+    for(uint32_t length = minLength;length <= maxLength;length++){
+        std::stringstream options;
+        options << (fusedPassGen ? fusedBuildOptions() : crackBuildOptions()) << " -DPASS_LEN=" << length;
+        cl::Kernel lengthKernel;
+        cl::Program lengthProgram;
+        // Steps of length without kernel are cracked by general kernel
+        if(!loadKernel(kernelFile, kernelName, &lengthKernel, &lengthProgram, options.str(), headers))
+            continue;
+        if(fusedPassGen)
+            passgen->initFusedKernel(&lengthKernel, &que, &context, passgenArgIndex);
+        lengthPrograms.push_back(lengthProgram);
+        lengthKernels[length] = lengthKernel;
+    }
+}
+
+bool GPUCracker::initLengthKernels(){
+    bool result = true;
+    // initData() sets arguments of kernel, so it's temporarily replaced
+    for(std::map<uint32_t, cl::Kernel>::iterator i = lengthKernels.begin();i != lengthKernels.end() && result;i++){
+        std::swap(kernel,i->second);
+        kernel.setArg(1,(cl_uint)(fusedPassGen ? foundCapacity : deviceConfig.globalWorkSize));
+        result = initData();
+        std::swap(kernel,i->second);
+    }
+    return result;
+}
+
+cl::Kernel &GPUCracker::slotKernel(PipelineSlot &slot){
+    std::map<uint32_t, cl::Kernel>::iterator found = lengthKernels.find(slot.length);
+    if(found != lengthKernels.end())
+        return found->second;
+    return kernel;
+}
+
+void GPUCracker::destroyCommonData(){
+    for(std::vector<PipelineSlot>::iterator i = slots.begin();i != slots.end();i++){
+        i->que.finish();
+        if(i->passwords != NULL && consumer == NULL){
+            i->que.enqueueUnmapMemObject(i->stagingBuffer,i->passwords);
+            i->que.finish();
+        }
+    }
+    slots.clear();
+    if(consumer != NULL){
+        // Producers mustn't write into batches after unmap
+        producerPool->removeConsumer(consumer);
+        consumer = NULL;
+        for(uint32_t i = 0;i<batches.size();i++){
+            que.enqueueUnmapMemObject(batchBuffers[i],batches[i].passwords);
+        }
+        batches.clear();
+        batchBuffers.clear();
+    }
+    que.finish();
+}
+
 void GPUCracker::run(){
+    // Platforms are enumerated only when some GPU cracker runs
+    initOpenCL();
     if(devices.size() <= deviceConfig.platform){
         stopReason = PLATFORM_NOT_EXISTS;
         return;
@@ -323,63 +1085,72 @@ void GPUCracker::run(){
         stopReason = INTERNAL_ERROR;
         return;
     }
-    if(!initData()){
+    if(!initData() || !initLengthKernels()){
         stopReason = INTERNAL_ERROR;
         return;
     }
 
-  cl::NDRange globalSize = cl::NDRange(deviceConfig.globalWorkSize);
   pass_found = false;
 
-  // Prepare passwords for first run
-  preparePasswords();
-  while (!pass_found && !stop_work)
+  // Fill the pipeline
+  for (std::vector<PipelineSlot>::iterator i = slots.begin();
+      i != slots.end() && !passgenExhausted; i++)
   {
-    // Update passwords in in kernel's buffer and run kernel
-    updatePasswords();
-    this->que.enqueueNDRangeKernel(this->kernel, cl::NullRange, globalSize,
-                                   localSize);
-
-    // Verify positive passwords from previous iteration
-    if (!positivePasswords.empty())
-    {
-      for (std::vector<std::string>::iterator i = positivePasswords.begin();
-          i != positivePasswords.end(); i++)
-      {
-        if (verifyPassword(*i))
-        {
-          pass_found = true;
-          password.assign(*i);
-          break;
-        }
-      }
-      positivePasswords.clear();
-    }
+    launchSlot(*i);
+  }
 
-    // Stop if generator has stopped
-    if (passgenExhausted)
-      break;
+  // Process slots in the order they were launched
+  uint32_t current = 0;
+  while (!pass_found && slots[current].active)
+  {
+    PipelineSlot &slot = slots[current];
 
-    // Prepare passwords for next iteration
-    preparePasswords();
+    // Running windows are cut before the remaining slots are drained
+    if (stop_work)
+      stopPersistentKernels();
 
-    // Wait until the cracker's finished
-    int res = this->que.finish();
-#ifndef NDEBUG
-    this->debugKernel(res);
-#endif
-    // Load positive passwords from kernel
-    if (!pass_found && passFound())
+    // Wait until results of the slot are read
+    if (passFound(slot))
     {
-      loadPositvePasswords();
+      loadPositvePasswords(slot);
     }
+    slot.active = false;
+    releasePasswords(slot);
+    updateWorkSize(slot);
+#ifndef NDEBUG
+    this->debugKernel(CL_SUCCESS);
+#endif
 
     // Increment counter of cracked passwords
-    passwdsCount += deviceConfig.globalWorkSize;
+    passwdsCount += slot.count;
+
+    // Refill the slot before verification, so the device doesn't wait
+    if (!stop_work && !passgenExhausted)
+      launchSlot(slot);
+
+    // Verify positive passwords of the slot
+    if (!positivePasswords.empty())
+      verifyPositivePasswords();
+
+    checkVerifiedPasswords();
+
+    current = (current + 1) % slots.size();
   }
 
-  // Wait until a kernel's finished
-  que.finish();
+  // Persistent kernels of remaining slots stop taking passwords
+  if (pass_found || stop_work)
+    stopPersistentKernels();
+
+  // Wait until all kernels have finished
+  destroyCommonData();
+
+  // Passwords of the last batches can be still verified
+  while (!pass_found && !stop_work && pendingVerifications > 0)
+  {
+    usleep(1000);
+    checkVerifiedPasswords();
+  }
+  checkVerifiedPasswords();
 
   if (pass_found)
     stopReason = PASS_FOUND;
@@ -391,6 +1162,38 @@ void GPUCracker::run(){
 
 bool GPUCracker::init_done = false;
 
+pthread_mutex_t GPUCracker::initMutex = PTHREAD_MUTEX_INITIALIZER;
+
+std::map<uint64_t, std::string> GPUCracker::programBinaries;
+
+std::set<uint64_t> GPUCracker::programsBuilding;
+
+pthread_mutex_t GPUCracker::programMutex = PTHREAD_MUTEX_INITIALIZER;
+
+pthread_cond_t GPUCracker::programBuilt = PTHREAD_COND_INITIALIZER;
+
+uint32_t GPUCracker::pipelineDepth = 3;
+
+uint32_t GPUCracker::targetKernelTime = 50;
+
+bool GPUCracker::fusePassGen = true;
+
+bool GPUCracker::buildLengthKernels = true;
+
+bool GPUCracker::persistentKernels = false;
+
+uint32_t GPUCracker::cpuVectorWidth = 8;
+
+uint32_t GPUCracker::deviceVerifySize = 65536;
+
+const char *GPUCracker::CANDIDATE_HEADER = "kernels/candidate.cl";
+
+const char *GPUCracker::FUSED_HEADER = "kernels/fused_candidate.cl";
+
+pthread_mutex_t GPUCracker::tuningMutex = PTHREAD_MUTEX_INITIALIZER;
+
+const char *GPUCracker::TUNING_CACHE_FILE = "tuning.cache";
+
 std::vector<PlatformDevices> GPUCracker::devices;
 
 std::vector<cl::Platform> GPUCracker::platforms;
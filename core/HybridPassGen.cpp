@@ -0,0 +1,344 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <HybridPassGen.h>
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+bool HybridPassGen::_cpu_mode;
+PassGen::KernelCode HybridPassGen::_gpu_code;
+std::ifstream * HybridPassGen::_dictionary;
+pthread_mutex_t HybridPassGen::_dictionary_mutex;
+pthread_mutexattr_t HybridPassGen::_dictionary_mutex_attr;
+bool HybridPassGen::_prepend;
+cl_uint HybridPassGen::_mask_length;
+cl_uchar HybridPassGen::_charsets[MAX_MASK_LENGTH * ASCII_CHARSET_SIZE];
+cl_uint HybridPassGen::_charset_sizes[MAX_MASK_LENGTH];
+cl_ulong HybridPassGen::_keyspace;
+int HybridPassGen::_num_instances;
+
+HybridPassGen::HybridPassGen(Options& options, bool cpu_mode) :
+    _instance_id { FACTORY_INSTANCE_ID }
+{
+  _cpu_mode = cpu_mode;
+  _prepend = options.prepend;
+
+  Mask mask { options.mask };
+  if (mask.Size() > MAX_MASK_LENGTH)
+    throw invalid_argument("Hybrid mask is too long");
+
+  // Expand metacharacters of mask into charsets
+  _mask_length = mask.Size();
+  _keyspace = 1;
+  for (unsigned p = 0; p < _mask_length; p++)
+  {
+    vector<uint8_t> chars = mask[p].Chars();
+    _charset_sizes[p] = chars.size();
+    memcpy(_charsets + p * ASCII_CHARSET_SIZE, chars.data(), chars.size());
+
+    if (chars.empty()
+        || _keyspace > numeric_limits<cl_ulong>::max() / MAX_BATCH_WORDS
+            / chars.size())
+      throw invalid_argument("Invalid hybrid mask");
+
+    _keyspace *= chars.size();
+  }
+
+  _dictionary = new ifstream { options.dictionary };
+  if (!_dictionary->is_open())
+    throw runtime_error("Unable to open dictionary");
+
+  pthread_mutexattr_init(&_dictionary_mutex_attr);
+  pthread_mutex_init(&_dictionary_mutex, &_dictionary_mutex_attr);
+
+  _num_instances = 0;
+
+  _gpu_code.filename = _kernel_source;
+  _gpu_code.name = _kernel_name;
+}
+
+HybridPassGen::HybridPassGen(const HybridPassGen& o) :
+    PassGen(o), _instance_id { o._num_instances++ }
+{
+  _words = new cl_uchar[_words_per_batch * WORD_ENTRY_SIZE];
+}
+
+HybridPassGen::~HybridPassGen()
+{
+  if (_instance_id == FACTORY_INSTANCE_ID)
+  {
+    pthread_mutex_destroy(&_dictionary_mutex);
+    pthread_mutexattr_destroy(&_dictionary_mutex_attr);
+
+    for (auto i : _instances)
+      delete i;
+
+    delete _dictionary;
+  }
+
+  delete[] _words;
+}
+
+PassGen::KernelCode* HybridPassGen::getKernelCode()
+{
+  if (_cpu_mode)
+    return (nullptr);
+  else
+    return (&_gpu_code);
+}
+
+bool HybridPassGen::isFactory()
+{
+  return (_instance_id == FACTORY_INSTANCE_ID);
+}
+
+PassGen* HybridPassGen::createGenerator()
+{
+  if (_instance_id == FACTORY_INSTANCE_ID)
+  {
+    HybridPassGen * new_instance = new HybridPassGen { *this };
+    _instances.push_back(new_instance);
+    return (new_instance);
+  }
+
+  return (nullptr);
+}
+
+uint8_t HybridPassGen::maxPassLen()
+{
+  return (static_cast<uint8_t>(MAX_WORD_LENGTH + _mask_length));
+}
+
+void HybridPassGen::setKernelGWS(uint64_t gws)
+{
+  _gws = gws;
+  gpu_mode = true;
+
+  // One batch of words should be enough for several kernel steps
+  uint64_t words = (4 * _gws + _keyspace - 1) / _keyspace;
+  if (words > MAX_BATCH_WORDS)
+    words = MAX_BATCH_WORDS;
+  _words_per_batch = words;
+
+  delete[] _words;
+  _words = new cl_uchar[_words_per_batch * WORD_ENTRY_SIZE];
+}
+
+void HybridPassGen::initKernel(cl::Kernel* kernel, cl::CommandQueue* que,
+                               cl::Context* context)
+{
+  _kernel = *kernel;
+  _que = *que;
+
+  // Invalid values to prevent kernel execution without loaded words
+  _index = 0;
+  _index_stop = 0;
+
+  _words_buffer = cl::Buffer { *context, CL_MEM_READ_ONLY,
+                               _words_per_batch * WORD_ENTRY_SIZE };
+
+  _charsets_buffer = cl::Buffer { *context, CL_MEM_READ_ONLY,
+                                  sizeof(_charsets) };
+  que->enqueueWriteBuffer(_charsets_buffer, CL_FALSE, 0, sizeof(_charsets),
+                          _charsets);
+
+  _charset_sizes_buffer = cl::Buffer { *context, CL_MEM_READ_ONLY,
+                                       sizeof(_charset_sizes) };
+  que->enqueueWriteBuffer(_charset_sizes_buffer, CL_FALSE, 0,
+                          sizeof(_charset_sizes), _charset_sizes);
+
+  cl_uint prepend = _prepend;
+
+  kernel->setArg(2, _words_buffer);
+  kernel->setArg(3, _charsets_buffer);
+  kernel->setArg(4, _charset_sizes_buffer);
+  kernel->setArg(5, _mask_length);
+  kernel->setArg(6, prepend);
+  kernel->setArg(7, _keyspace);
+  kernel->setArg(8, _index);
+  kernel->setArg(9, _index_stop);
+}
+
+bool HybridPassGen::nextKernelStep()
+{
+  if (_index_stop > 0)
+    _index += _gws;
+
+  if (_index >= _index_stop)
+  {
+    if (!loadWords())
+      return (false);
+
+    // Kernel has to finish with previous batch before it's overwritten
+    _que.enqueueWriteBuffer(_words_buffer, CL_TRUE, 0,
+                            _num_words * WORD_ENTRY_SIZE, _words);
+
+    _index = 0;
+    _index_stop = _num_words * _keyspace;
+    _kernel.setArg(9, _index_stop);
+  }
+
+  _kernel.setArg(8, _index);
+  return (true);
+}
+
+bool HybridPassGen::loadWords()
+{
+  string line;
+  _num_words = 0;
+
+  pthread_mutex_lock(&_dictionary_mutex);
+
+  // Remember where the batch starts (for saving state)
+  if (_dictionary->good())
+    _batch_position = _dictionary->tellg();
+  else
+    _batch_position = UINT64_MAX;
+
+  while (_num_words < _words_per_batch && getline(*_dictionary, line))
+  {
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+
+    if (line.size() > MAX_WORD_LENGTH)
+      line.resize(MAX_WORD_LENGTH);
+
+    cl_uchar *entry = _words + _num_words * WORD_ENTRY_SIZE;
+    entry[0] = line.size();
+    memcpy(entry + 1, line.data(), line.size());
+    _num_words++;
+  }
+
+  pthread_mutex_unlock(&_dictionary_mutex);
+
+  if (_num_words == 0)
+  {
+    _batch_position = UINT64_MAX;
+    return (false);
+  }
+
+  return (true);
+}
+
+void HybridPassGen::spliceWord()
+{
+  const cl_uchar *entry = _words + _word * WORD_ENTRY_SIZE;
+  unsigned word_length = entry[0];
+  unsigned word_offset = _prepend ? _mask_length : 0;
+  _mask_offset = _prepend ? 0 : word_length;
+
+  memcpy(_candidate + word_offset, entry + 1, word_length);
+
+  for (unsigned p = 0; p < _mask_length; p++)
+  {
+    _odometer[p] = 0;
+    _candidate[_mask_offset + p] = _charsets[p * ASCII_CHARSET_SIZE];
+  }
+
+  _candidate_length = word_length + _mask_length;
+}
+
+bool HybridPassGen::getPassword(char* pass, uint32_t* len)
+{
+  if (_word >= _num_words)
+  {
+    if (!loadWords())
+      return (false);
+
+    _word = 0;
+    spliceWord();
+  }
+
+  *len = _candidate_length;
+  memcpy(pass, _candidate, _candidate_length);
+
+  // Increment mask's counter, the last position changes most frequently
+  int p = _mask_length - 1;
+  for (; p >= 0; p--)
+  {
+    cl_uint *state = _odometer + p;
+    const cl_uchar *charset = _charsets + p * ASCII_CHARSET_SIZE;
+
+    if (++(*state) < _charset_sizes[p])
+    {
+      _candidate[_mask_offset + p] = charset[*state];
+      break;
+    }
+
+    *state = 0;
+    _candidate[_mask_offset + p] = charset[0];
+  }
+
+  // All mask's passwords have been generated, move to next word
+  if (p < 0 && ++_word < _num_words)
+    spliceWord();
+
+  return (true);
+}
+
+void HybridPassGen::saveState(std::string filename)
+{
+  if (_instance_id != FACTORY_INSTANCE_ID)
+    return;
+
+  uint64_t position = UINT64_MAX;
+  for (auto i : _instances)
+  {
+    if (i->_batch_position < position)
+      position = i->_batch_position;
+  }
+
+  if (position == UINT64_MAX)
+    return;
+
+  ofstream out_file { filename, ios_base::binary };
+  char ID = PASSGEN_ID_HYBRID;
+
+  if (out_file.is_open())
+  {
+    out_file.write(&ID, sizeof(ID));
+    out_file.write(reinterpret_cast<char *>(&position), sizeof(position));
+  }
+}
+
+void HybridPassGen::loadState(std::string filename)
+{
+  ifstream in_file { filename, ios_base::binary };
+  char ID;
+  uint64_t position;
+
+  if (!in_file.is_open())
+    return;
+
+  in_file.read(&ID, sizeof(ID));
+  if (ID != PASSGEN_ID_HYBRID)
+    return;
+
+  in_file.read(reinterpret_cast<char *>(&position), sizeof(position));
+  if (in_file)
+    _dictionary->seekg(position);
+}
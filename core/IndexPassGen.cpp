@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <IndexPassGen.h>
+
+#include <algorithm>        // find
+
+using namespace std;
+
+IndexPassGen::IndexPassGen() :
+    _range { new Range }, _range_owner { true }
+{
+  pthread_mutex_init(&_range->mutex, NULL);
+}
+
+IndexPassGen::IndexPassGen(const IndexPassGen& o) :
+    PassGen(o), _min_reservation_size { o._min_reservation_size },
+    _reservation_size { o._reservation_size }, _range { o._range },
+    _range_owner { false }
+{
+  _range->generators.push_back(this);
+  clock_gettime(CLOCK_MONOTONIC, &_speed_clock);
+}
+
+IndexPassGen::~IndexPassGen()
+{
+  if (_range_owner)
+  {
+    pthread_mutex_destroy(&_range->mutex);
+    delete _range;
+  }
+  else
+  {
+    auto it = find(_range->generators.begin(), _range->generators.end(), this);
+    if (it != _range->generators.end())
+      _range->generators.erase(it);
+  }
+}
+
+void IndexPassGen::setRange(cl_ulong start, cl_ulong stop)
+{
+  _range->start_index = start;
+  _range->stop_index = stop;
+}
+
+cl_ulong IndexPassGen::stopIndex()
+{
+  return (_range->stop_index);
+}
+
+bool IndexPassGen::reservePasswords()
+{
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  double elapsed = (end.tv_sec - _speed_clock.tv_sec);
+  elapsed += (end.tv_nsec - _speed_clock.tv_nsec) / 1000000000.0;
+  _speed_clock = end;
+
+  // Reservation grows at most 16 times, speed is kept in floating point,
+  // because elapsed time can be close to zero
+  cl_ulong max_res_size = _reservation_size << 4;
+  double speed = _reservation_size / elapsed;
+
+  if (elapsed > 0 && speed < max_res_size)
+    _reservation_size = static_cast<cl_ulong>(speed / _gws) * _gws;
+  else
+    _reservation_size = max_res_size;
+
+  if (_reservation_size < _min_reservation_size)
+    _reservation_size = _min_reservation_size;
+
+  if (_max_reservation_size > 0 && _reservation_size > _max_reservation_size)
+    _reservation_size = _max_reservation_size;
+
+  pthread_mutex_lock(&_range->mutex);
+  _private_start_index = _range->start_index;
+  _private_stop_index = _private_start_index + _reservation_size;
+
+  if (_private_stop_index > _range->stop_index)
+    _private_stop_index = _range->stop_index;
+
+  if (_private_stop_index > _private_start_index)
+  {
+    _private_stop_index = limitReservation(_private_start_index,
+                                           _private_stop_index);
+    _range->start_index = _private_stop_index;
+  }
+  pthread_mutex_unlock(&_range->mutex);
+
+  if (_private_start_index >= _private_stop_index)
+  {
+    _reservation_start = UINT64_MAX;
+    return (false);
+  }
+
+  _reservation_start = _private_start_index;
+  return (true);
+}
+
+cl_ulong IndexPassGen::limitReservation(cl_ulong start, cl_ulong stop)
+{
+  return (stop);
+}
+
+void IndexPassGen::saveIndex(std::string filename, char id)
+{
+  if (!_range_owner)
+    return;
+
+  uint64_t index = UINT64_MAX;
+  for (auto i : _range->generators)
+  {
+    if (i->_reservation_start < index)
+      index = i->_reservation_start;
+  }
+
+  if (index == UINT64_MAX)
+    return;
+
+  ofstream out_file { filename, ios_base::binary };
+
+  if (out_file.is_open())
+  {
+    out_file.write(&id, sizeof(id));
+    out_file.write(reinterpret_cast<char *>(&index), sizeof(index));
+  }
+}
+
+void IndexPassGen::loadIndex(std::string filename, char id)
+{
+  ifstream in_file { filename, ios_base::binary };
+  char ID;
+  uint64_t index;
+
+  if (!in_file.is_open())
+    return;
+
+  in_file.read(&ID, sizeof(ID));
+  if (ID != id)
+    return;
+
+  in_file.read(reinterpret_cast<char *>(&index), sizeof(index));
+  if (in_file && index < _range->stop_index)
+    _range->start_index = index;
+}
@@ -32,6 +32,7 @@
 
 #include <algorithm>        // max_element
 #include <limits>
+#include <cstring>          // memcpy
 #include <sstream>          // stringstream
 #include <iostream> // TODO
 
@@ -39,27 +40,23 @@ using namespace std;
 
 bool MarkovPassGen::_cpu_mode;
 PassGen::KernelCode MarkovPassGen::_gpu_code;
+PassGen::KernelCode MarkovPassGen::_fused_code;
 Mask MarkovPassGen::_mask;
 MarkovPassGen::Model MarkovPassGen::_model;
 cl_uchar * MarkovPassGen::_markov_table;
 std::size_t MarkovPassGen::_markov_table_size;
+std::vector<cl_uchar *> MarkovPassGen::_node_tables;
 cl_ulong * MarkovPassGen::_permutations;
 cl_uint MarkovPassGen::_min_length;
 cl_uint MarkovPassGen::_max_length;
 int MarkovPassGen::_num_instances;
 cl_uint * MarkovPassGen::_thresholds;
 cl_uint MarkovPassGen::_max_threshold;
-cl_ulong MarkovPassGen::_shared_start_index;
-cl_ulong MarkovPassGen::_shared_stop_index;
-pthread_mutex_t MarkovPassGen::_shared_index_mutex;
-pthread_mutexattr_t MarkovPassGen::_shared_index_mutex_attr;
 
 MarkovPassGen::MarkovPassGen(Options& options, bool cpu_mode) :
     _instance_id { FACTORY_INSTANCE_ID }
 {
   _cpu_mode = cpu_mode; // TODO
-  pthread_mutexattr_init(&_shared_index_mutex_attr);
-  pthread_mutex_init(&_shared_index_mutex, &_shared_index_mutex_attr);
   _mask = Mask { options.mask };
   _thresholds = new cl_uint[MAX_PASS_LENGTH];
   _permutations = new cl_ulong[MAX_PASS_LENGTH + 1];
@@ -71,20 +68,19 @@ MarkovPassGen::MarkovPassGen(Options& options, bool cpu_mode) :
 
   // Initialize memory
   initMemory(options.stat_file);
+  _table = _markov_table;
 
-  _shared_start_index = _permutations[_min_length - 1];
-  _shared_stop_index = _permutations[_max_length];
+  setRange(_permutations[_min_length - 1], _permutations[_max_length]);
 
   _num_instances = 0;
 
   _gpu_code.filename = _kernel_source;
   _gpu_code.name = _kernel_name;
+  _fused_code.filename = _fused_source;
+  _fused_code.name = _kernel_name;
 
   _length = _min_length;
 
-  _min_reservation_size = 1024;
-  _reservation_size = _min_reservation_size;
-
 #ifndef NDEBUG
   debugPrint();
 #endif
@@ -94,23 +90,21 @@ MarkovPassGen::MarkovPassGen(Options& options, bool cpu_mode) :
 }
 
 MarkovPassGen::MarkovPassGen(const MarkovPassGen& o) :
-    PassGen(o), _instance_id { o._num_instances++ },
-    _min_reservation_size { o._min_reservation_size },
-    _reservation_size { o._reservation_size }
+    IndexPassGen(o), _instance_id { o._num_instances++ }, _table { o._table }
 {
-  clock_gettime(CLOCK_MONOTONIC, &_speed_clock);
 }
 
 MarkovPassGen::~MarkovPassGen()
 {
   if (_instance_id == FACTORY_INSTANCE_ID)
   {
-    pthread_mutex_destroy(&_shared_index_mutex);
-    pthread_mutexattr_destroy(&_shared_index_mutex_attr);
-
     for (auto i : _instances)
       delete i;
 
+    for (auto table : _node_tables)
+      delete[] table;
+    _node_tables.clear();
+
     delete[] _thresholds;
     delete[] _permutations;
   }
@@ -124,6 +118,14 @@ PassGen::KernelCode* MarkovPassGen::getKernelCode()
     return (&_gpu_code);
 }
 
+PassGen::KernelCode* MarkovPassGen::getFusedCode()
+{
+  if (_cpu_mode)
+    return (nullptr);
+  else
+    return (&_fused_code);
+}
+
 bool MarkovPassGen::isFactory()
 {
   return (_instance_id == FACTORY_INSTANCE_ID);
@@ -141,6 +143,22 @@ PassGen* MarkovPassGen::createGenerator()
   return (nullptr);
 }
 
+void MarkovPassGen::replicateData(unsigned node)
+{
+  if (node >= _node_tables.size())
+    _node_tables.resize(node + 1, nullptr);
+
+  // Pages of the copy are first touched by thread on the node
+  if (_node_tables[node] == nullptr)
+  {
+    _node_tables[node] = new cl_uchar[_markov_table_size];
+    memcpy(_node_tables[node], _markov_table,
+           _markov_table_size * sizeof(cl_uchar));
+  }
+
+  _table = _node_tables[node];
+}
+
 uint8_t MarkovPassGen::maxPassLen()
 {
   return (static_cast<uint8_t>(_max_length));
@@ -157,7 +175,54 @@ void MarkovPassGen::setKernelGWS(uint64_t gws)
 void MarkovPassGen::initKernel(cl::Kernel* kernel, cl::CommandQueue* que,
                                  cl::Context* context)
 {
-  _kernel = *kernel;
+  initArguments(kernel, que, context, 2);
+}
+
+uint32_t MarkovPassGen::initFusedKernel(cl::Kernel* kernel,
+                                        cl::CommandQueue* que,
+                                        cl::Context* context,
+                                        uint32_t argIndex)
+{
+  initArguments(kernel, que, context, argIndex);
+
+  // Timed runs of work size tuning are executed before the first reservation,
+  // so they create real passwords. Range is replaced in nextKernelStep().
+  kernel->setArg(_arg_index + 4, _permutations[_min_length - 1]);
+  kernel->setArg(_arg_index + 5, stopIndex());
+
+  return (NUM_KERNEL_ARGS);
+}
+
+uint64_t MarkovPassGen::kernelStepIndex()
+{
+  return (_private_start_index);
+}
+
+uint32_t MarkovPassGen::kernelStepLength()
+{
+  // Reservations don't cross boundaries of lengths
+  return (_length);
+}
+
+bool MarkovPassGen::kernelStepLengths(uint32_t* min, uint32_t* max)
+{
+  *min = _min_length;
+  *max = _max_length;
+  return (true);
+}
+
+void MarkovPassGen::initArguments(cl::Kernel* kernel, cl::CommandQueue* que,
+                                  cl::Context* context, uint32_t argIndex)
+{
+  _arg_index = argIndex;
+
+  // Cracking kernel can be built for each length, buffers are shared
+  if (!_kernels.empty())
+  {
+    setArguments(kernel);
+    _kernels.push_back(*kernel);
+    return;
+  }
 
   // Invalid values to prevent kernel execution without reserved passwords
   _private_start_index = 1;
@@ -178,13 +243,19 @@ void MarkovPassGen::initKernel(cl::Kernel* kernel, cl::CommandQueue* que,
   que->enqueueWriteBuffer(_permutations_buffer, CL_FALSE, 0,
                           (_max_length + 2) * sizeof(cl_ulong), _permutations);
 
-  kernel->setArg(2, _markov_table_buffer);
-  kernel->setArg(3, _thresholds_buffer);
-  kernel->setArg(4, _permutations_buffer);
-  kernel->setArg(5, _max_threshold);
-  kernel->setArg(6, _private_start_index);
-  kernel->setArg(7, _private_stop_index);
-  kernel->setArg(8, _length);
+  setArguments(kernel);
+  _kernels.push_back(*kernel);
+}
+
+void MarkovPassGen::setArguments(cl::Kernel* kernel)
+{
+  kernel->setArg(_arg_index, _markov_table_buffer);
+  kernel->setArg(_arg_index + 1, _thresholds_buffer);
+  kernel->setArg(_arg_index + 2, _permutations_buffer);
+  kernel->setArg(_arg_index + 3, _max_threshold);
+  kernel->setArg(_arg_index + 4, _private_start_index);
+  kernel->setArg(_arg_index + 5, _private_stop_index);
+  kernel->setArg(_arg_index + 6, _length);
 }
 
 bool MarkovPassGen::nextKernelStep()
@@ -192,61 +263,55 @@ bool MarkovPassGen::nextKernelStep()
   if (_private_start_index < _private_stop_index)
   {
     _private_start_index += _gws;
-    _kernel.setArg(6, _private_start_index);
+    for (auto & kernel : _kernels)
+      kernel.setArg(_arg_index + 4, _private_start_index);
     return (true);
   }
 
   if (reservePasswords())
   {
-    _kernel.setArg(6, _private_start_index);
-    _kernel.setArg(7, _private_stop_index);
-    _kernel.setArg(8, _length);
+    for (auto & kernel : _kernels)
+    {
+      kernel.setArg(_arg_index + 4, _private_start_index);
+      kernel.setArg(_arg_index + 5, _private_stop_index);
+      kernel.setArg(_arg_index + 6, _length);
+    }
     return (true);
   }
 
   return (false);
 }
 
-bool MarkovPassGen::reservePasswords()
+bool MarkovPassGen::nextKernelWindow(uint64_t maxSize, uint64_t* size)
 {
-  struct timespec end;
-  clock_gettime(CLOCK_MONOTONIC, &end);
+  _max_reservation_size = maxSize;
 
-  double elapsed = (end.tv_sec - _speed_clock.tv_sec);
-  elapsed += (end.tv_nsec - _speed_clock.tv_nsec) / 1000000000.0;
-
-  unsigned speed = _reservation_size / elapsed / _gws;
-  _speed_clock = end;
-  unsigned new_res_size = speed * _gws;
+  if (!reservePasswords())
+    return (false);
 
-  unsigned max_res_size = _reservation_size << 4;		// Multiply by 8
-  if (new_res_size > max_res_size)
+  for (auto & kernel : _kernels)
   {
-    new_res_size = max_res_size;
+    kernel.setArg(_arg_index + 4, _private_start_index);
+    kernel.setArg(_arg_index + 5, _private_stop_index);
+    kernel.setArg(_arg_index + 6, _length);
   }
-  _reservation_size = new_res_size;
-
-  if (_reservation_size < _min_reservation_size)
-    _reservation_size = _min_reservation_size;
-
-  pthread_mutex_lock(&_shared_index_mutex);
-  _private_start_index = _shared_start_index;
-  _shared_start_index += _reservation_size;
-  pthread_mutex_unlock(&_shared_index_mutex);
-
-  _private_stop_index = _private_start_index + _reservation_size;
-
-  if (_private_start_index > _shared_stop_index)
-    return (false);
 
-  if (_private_stop_index > _shared_stop_index)
-    _private_stop_index = _shared_stop_index;
+  *size = _private_stop_index - _private_start_index;
+  return (true);
+}
 
+cl_ulong MarkovPassGen::limitReservation(cl_ulong start, cl_ulong stop)
+{
   // Determine current length
-  while (_private_start_index >= _permutations[_length])
+  while (start >= _permutations[_length])
     _length++;
 
-  return (true);
+  // Reservation ends with the last password of current length, so every
+  // kernel step creates passwords of single length
+  if (stop > _permutations[_length])
+    stop = _permutations[_length];
+
+  return (stop);
 }
 
 void MarkovPassGen::initMemory(std::string stat_file)
@@ -504,7 +569,7 @@ std::string MarkovPassGen::getPassword(uint64_t index)
 {
   uint8_t buffer[256];
 
-  if (index >= _shared_stop_index)
+  if (index >= stopIndex())
     return (string {""});
 
   // Determine current length
@@ -559,8 +624,8 @@ bool MarkovPassGen::getPassword(char* pass, uint32_t* len)
     partial_index = index % _thresholds[p];
     index = index / _thresholds[p];
 
-    last_char = _markov_table[p * ASCII_CHARSET_SIZE * _max_threshold
-                             + last_char * _max_threshold + partial_index];
+    last_char = _table[p * ASCII_CHARSET_SIZE * _max_threshold
+                       + last_char * _max_threshold + partial_index];
 
     pass[p] = last_char;
   }
@@ -65,6 +65,27 @@ MaskElement::MaskElement(const std::string & single_mask)
   }
 }
 
+MaskElement MaskElement::FromCharset(const std::string & charset)
+{
+  MaskElement element;
+  element._charset_flags.reset();
+
+  for (unsigned i = 0; i < charset.size(); i++)
+  {
+    if (charset[i] == '?' && i + 1 < charset.size())
+    {
+      element._charset_flags |= MaskElement { charset.substr(i, 2) }._charset_flags;
+      i++;
+    }
+    else
+    {
+      element._charset_flags[static_cast<uint8_t>(charset[i])] = true;
+    }
+  }
+
+  return element;
+}
+
 const MaskElement& Mask::operator [](std::size_t idx)
 {
   if (idx >=_mask_elements.size())
@@ -82,11 +103,22 @@ Mask::Mask()
 {
 }
 
-Mask::Mask(const std::string& mask)
+Mask::Mask(const std::string& mask,
+           const std::vector<std::string> &custom_charsets)
 {
   for (unsigned i = 0; i < mask.size(); i++)
   {
-    if (mask[i] == '?')
+    if (mask[i] == '?' && i + 1 < mask.size() && mask[i + 1] >= '1'
+        && mask[i + 1] < '1' + NUM_CUSTOM_CHARSETS)
+    {
+      unsigned charset = mask[i + 1] - '1';
+      if (charset >= custom_charsets.size() || custom_charsets[charset].empty())
+        throw runtime_error { "Mask: Undefined custom charset" };
+
+      _mask_elements.push_back(MaskElement::FromCharset(custom_charsets[charset]));
+      i++;
+    }
+    else if (mask[i] == '?')
     {
       _mask_elements.push_back(MaskElement {mask.substr(i, 2)});
       i++;
@@ -102,7 +134,25 @@ Mask::~Mask()
 {
 }
 
+std::size_t Mask::Size() const
+{
+  return _mask_elements.size();
+}
+
 std::size_t MaskElement::Count() const
 {
   return _charset_flags.count();
 }
+
+std::vector<uint8_t> MaskElement::Chars() const
+{
+  std::vector<uint8_t> chars;
+
+  for (int i = 0; i < ASCII_CHARSET_SIZE; i++)
+  {
+    if (_charset_flags.test(i))
+      chars.push_back(static_cast<uint8_t>(i));
+  }
+
+  return chars;
+}
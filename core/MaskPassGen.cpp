@@ -0,0 +1,424 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <MaskPassGen.h>
+
+#include <algorithm>        // upper_bound
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+bool MaskPassGen::_cpu_mode;
+PassGen::KernelCode MaskPassGen::_gpu_code;
+PassGen::KernelCode MaskPassGen::_fused_code;
+cl_uint MaskPassGen::_max_length;
+std::vector<cl_uchar> MaskPassGen::_charsets;
+std::vector<cl_uint> MaskPassGen::_charset_sizes;
+std::vector<cl_uint> MaskPassGen::_mask_positions;
+std::vector<cl_uint> MaskPassGen::_mask_lengths;
+std::vector<cl_ulong> MaskPassGen::_mask_offsets;
+int MaskPassGen::_num_instances;
+
+MaskPassGen::MaskPassGen(Options& options, bool cpu_mode) :
+    _instance_id { FACTORY_INSTANCE_ID }
+{
+  _cpu_mode = cpu_mode;
+
+  _max_length = 0;
+  _charsets.clear();
+  _charset_sizes.clear();
+  _mask_positions.clear();
+  _mask_lengths.clear();
+  _mask_offsets.assign(1, 0);
+
+  // Argument is either file with masks or mask itself
+  ifstream mask_file { options.mask };
+  if (mask_file.is_open())
+  {
+    string line;
+    while (getline(mask_file, line))
+    {
+      if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+
+      if (line.empty() || line[0] == '#')
+        continue;
+
+      parseMaskLine(line, options.custom_charsets);
+    }
+  }
+  else
+  {
+    Mask mask { options.mask, options.custom_charsets };
+    addMask(mask);
+  }
+
+  if (_mask_lengths.empty())
+    throw invalid_argument("No mask has been specified");
+
+  setRange(0, _mask_offsets.back());
+
+  _num_instances = 0;
+
+  _gpu_code.filename = _kernel_source;
+  _gpu_code.name = _kernel_name;
+  _fused_code.filename = _fused_source;
+  _fused_code.name = _kernel_name;
+}
+
+MaskPassGen::MaskPassGen(const MaskPassGen& o) :
+    IndexPassGen(o), _instance_id { o._num_instances++ }
+{
+}
+
+MaskPassGen::~MaskPassGen()
+{
+  if (_instance_id == FACTORY_INSTANCE_ID)
+  {
+    for (auto i : _instances)
+      delete i;
+  }
+}
+
+void MaskPassGen::parseMaskLine(const std::string & line,
+                                std::vector<std::string> custom_charsets)
+{
+  vector<string> fields(1);
+
+  // Split line by commas which aren't escaped
+  for (unsigned i = 0; i < line.size(); i++)
+  {
+    if (line[i] == '\\' && i + 1 < line.size() && line[i + 1] == ',')
+    {
+      fields.back() += ',';
+      i++;
+    }
+    else if (line[i] == ',')
+    {
+      fields.emplace_back();
+    }
+    else
+    {
+      fields.back() += line[i];
+    }
+  }
+
+  if (fields.size() > NUM_CUSTOM_CHARSETS + 1)
+    throw invalid_argument("Invalid line in mask file: " + line);
+
+  // Charsets defined on the line overwrite charsets from command line
+  custom_charsets.resize(NUM_CUSTOM_CHARSETS);
+  for (unsigned i = 0; i + 1 < fields.size(); i++)
+  {
+    custom_charsets[i] = fields[i];
+  }
+
+  Mask mask { fields.back(), custom_charsets };
+  addMask(mask);
+}
+
+void MaskPassGen::addMask(Mask & mask)
+{
+  cl_uint length = mask.Size();
+  if (length == 0 || length > MAX_PASS_LENGTH)
+    throw invalid_argument("Invalid length of mask");
+
+  cl_ulong keyspace = 1;
+  _mask_positions.push_back(_charset_sizes.size());
+  _mask_lengths.push_back(length);
+
+  for (unsigned p = 0; p < length; p++)
+  {
+    vector<uint8_t> chars = mask[p].Chars();
+
+    if (chars.empty() || keyspace > numeric_limits<cl_ulong>::max() / chars.size())
+      throw invalid_argument("Invalid mask");
+
+    keyspace *= chars.size();
+
+    _charset_sizes.push_back(chars.size());
+    _charsets.insert(_charsets.end(), chars.begin(), chars.end());
+    _charsets.resize(_charsets.size() + ASCII_CHARSET_SIZE - chars.size(), 0);
+  }
+
+  if (_mask_offsets.back() > numeric_limits<cl_ulong>::max() - keyspace)
+    throw invalid_argument("Too many passwords in masks");
+
+  _mask_offsets.push_back(_mask_offsets.back() + keyspace);
+
+  if (length > _max_length)
+    _max_length = length;
+}
+
+PassGen::KernelCode* MaskPassGen::getKernelCode()
+{
+  if (_cpu_mode)
+    return (nullptr);
+  else
+    return (&_gpu_code);
+}
+
+PassGen::KernelCode* MaskPassGen::getFusedCode()
+{
+  if (_cpu_mode)
+    return (nullptr);
+  else
+    return (&_fused_code);
+}
+
+bool MaskPassGen::isFactory()
+{
+  return (_instance_id == FACTORY_INSTANCE_ID);
+}
+
+PassGen* MaskPassGen::createGenerator()
+{
+  if (_instance_id == FACTORY_INSTANCE_ID)
+  {
+    MaskPassGen * new_instance = new MaskPassGen { *this };
+    _instances.push_back(new_instance);
+    return (new_instance);
+  }
+
+  return (nullptr);
+}
+
+uint8_t MaskPassGen::maxPassLen()
+{
+  return (static_cast<uint8_t>(_max_length));
+}
+
+void MaskPassGen::setKernelGWS(uint64_t gws)
+{
+  _gws = gws;
+  // Initialize reservation size
+  _min_reservation_size = 4 * _gws;
+  gpu_mode = true;
+}
+
+void MaskPassGen::initKernel(cl::Kernel* kernel, cl::CommandQueue* que,
+                             cl::Context* context)
+{
+  initArguments(kernel, que, context, 2);
+}
+
+uint32_t MaskPassGen::initFusedKernel(cl::Kernel* kernel, cl::CommandQueue* que,
+                                      cl::Context* context, uint32_t argIndex)
+{
+  initArguments(kernel, que, context, argIndex);
+
+  // Timed runs of work size tuning are executed before the first reservation,
+  // so they create real passwords. Range is replaced in nextKernelStep().
+  kernel->setArg(_arg_index + 6, cl_ulong { 0 });
+  kernel->setArg(_arg_index + 7, stopIndex());
+
+  return (NUM_KERNEL_ARGS);
+}
+
+uint64_t MaskPassGen::kernelStepIndex()
+{
+  return (_private_start_index);
+}
+
+void MaskPassGen::initArguments(cl::Kernel* kernel, cl::CommandQueue* que,
+                                cl::Context* context, uint32_t argIndex)
+{
+  _kernel = *kernel;
+  _arg_index = argIndex;
+
+  // Invalid values to prevent kernel execution without reserved passwords
+  _private_start_index = 1;
+  _private_stop_index = 0;
+
+  _charsets_buffer = cl::Buffer { *context, CL_MEM_READ_ONLY,
+                                  _charsets.size() };
+  que->enqueueWriteBuffer(_charsets_buffer, CL_FALSE, 0, _charsets.size(),
+                          _charsets.data());
+
+  _charset_sizes_buffer = cl::Buffer { *context, CL_MEM_READ_ONLY,
+                                       _charset_sizes.size() * sizeof(cl_uint) };
+  que->enqueueWriteBuffer(_charset_sizes_buffer, CL_FALSE, 0,
+                          _charset_sizes.size() * sizeof(cl_uint),
+                          _charset_sizes.data());
+
+  _mask_positions_buffer = cl::Buffer { *context, CL_MEM_READ_ONLY,
+                                        _mask_positions.size() * sizeof(cl_uint) };
+  que->enqueueWriteBuffer(_mask_positions_buffer, CL_FALSE, 0,
+                          _mask_positions.size() * sizeof(cl_uint),
+                          _mask_positions.data());
+
+  _mask_lengths_buffer = cl::Buffer { *context, CL_MEM_READ_ONLY,
+                                      _mask_lengths.size() * sizeof(cl_uint) };
+  que->enqueueWriteBuffer(_mask_lengths_buffer, CL_FALSE, 0,
+                          _mask_lengths.size() * sizeof(cl_uint),
+                          _mask_lengths.data());
+
+  _mask_offsets_buffer = cl::Buffer { *context, CL_MEM_READ_ONLY,
+                                      _mask_offsets.size() * sizeof(cl_ulong) };
+  que->enqueueWriteBuffer(_mask_offsets_buffer, CL_FALSE, 0,
+                          _mask_offsets.size() * sizeof(cl_ulong),
+                          _mask_offsets.data());
+
+  cl_uint num_masks = _mask_lengths.size();
+
+  kernel->setArg(_arg_index, _charsets_buffer);
+  kernel->setArg(_arg_index + 1, _charset_sizes_buffer);
+  kernel->setArg(_arg_index + 2, _mask_positions_buffer);
+  kernel->setArg(_arg_index + 3, _mask_lengths_buffer);
+  kernel->setArg(_arg_index + 4, _mask_offsets_buffer);
+  kernel->setArg(_arg_index + 5, num_masks);
+  kernel->setArg(_arg_index + 6, _private_start_index);
+  kernel->setArg(_arg_index + 7, _private_stop_index);
+}
+
+bool MaskPassGen::nextKernelStep()
+{
+  if (_private_start_index + _gws < _private_stop_index)
+  {
+    _private_start_index += _gws;
+    _kernel.setArg(_arg_index + 6, _private_start_index);
+    return (true);
+  }
+
+  if (reservePasswords())
+  {
+    _kernel.setArg(_arg_index + 6, _private_start_index);
+    _kernel.setArg(_arg_index + 7, _private_stop_index);
+    return (true);
+  }
+
+  return (false);
+}
+
+bool MaskPassGen::nextKernelWindow(uint64_t maxSize, uint64_t* size)
+{
+  _max_reservation_size = maxSize;
+
+  if (!reservePasswords())
+    return (false);
+
+  _kernel.setArg(_arg_index + 6, _private_start_index);
+  _kernel.setArg(_arg_index + 7, _private_stop_index);
+
+  *size = _private_stop_index - _private_start_index;
+  return (true);
+}
+
+void MaskPassGen::setCounter(uint64_t index)
+{
+  _mask = upper_bound(_mask_offsets.begin(), _mask_offsets.end(), index)
+      - _mask_offsets.begin() - 1;
+
+  uint64_t local_index = index - _mask_offsets[_mask];
+  cl_uint position = _mask_positions[_mask];
+
+  for (int p = _mask_lengths[_mask] - 1; p >= 0; p--)
+  {
+    cl_uint size = _charset_sizes[position + p];
+
+    _counter[p] = local_index % size;
+    local_index = local_index / size;
+    _candidate[p] = _charsets[(position + p) * ASCII_CHARSET_SIZE + _counter[p]];
+  }
+}
+
+std::string MaskPassGen::getPassword(uint64_t index)
+{
+  if (index >= stopIndex())
+    return (string {""});
+
+  std::size_t mask = upper_bound(_mask_offsets.begin(), _mask_offsets.end(),
+                                 index) - _mask_offsets.begin() - 1;
+
+  uint64_t local_index = index - _mask_offsets[mask];
+  cl_uint position = _mask_positions[mask];
+  string password(_mask_lengths[mask], '\0');
+
+  for (int p = _mask_lengths[mask] - 1; p >= 0; p--)
+  {
+    cl_uint size = _charset_sizes[position + p];
+
+    password[p] = _charsets[(position + p) * ASCII_CHARSET_SIZE
+                            + local_index % size];
+    local_index = local_index / size;
+  }
+
+  return (password);
+}
+
+bool MaskPassGen::getPassword(char* pass, uint32_t* len)
+{
+  if (_private_start_index >= _private_stop_index)
+  {
+    if (!reservePasswords())
+      return (false);
+
+    setCounter(_private_start_index);
+  }
+
+  cl_uint length = _mask_lengths[_mask];
+  memcpy(pass, _candidate, length);
+  *len = length;
+
+  _private_start_index++;
+  if (_private_start_index >= _private_stop_index)
+    return (true);
+
+  // All passwords of current mask have been generated
+  if (_private_start_index == _mask_offsets[_mask + 1])
+  {
+    setCounter(_private_start_index);
+    return (true);
+  }
+
+  // Increment counter, the last position changes most frequently
+  cl_uint position = _mask_positions[_mask];
+  for (int p = length - 1; p >= 0; p--)
+  {
+    const cl_uchar *charset = _charsets.data()
+        + (position + p) * ASCII_CHARSET_SIZE;
+
+    if (++_counter[p] < _charset_sizes[position + p])
+    {
+      _candidate[p] = charset[_counter[p]];
+      break;
+    }
+
+    _counter[p] = 0;
+    _candidate[p] = charset[0];
+  }
+
+  return (true);
+}
+
+void MaskPassGen::saveState(std::string filename)
+{
+  saveIndex(filename, PASSGEN_ID_MASK);
+}
+
+void MaskPassGen::loadState(std::string filename)
+{
+  loadIndex(filename, PASSGEN_ID_MASK);
+}
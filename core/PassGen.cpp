@@ -25,6 +25,7 @@
 #include <math.h>
 #include <time.h>
 #include <iostream>
+#include <sstream>
 
 #include "PassGen.h"
 #include "UnicodePassGen.h"
@@ -51,6 +52,34 @@ PassGen::KernelCode* PassGen::getKernelCode(){
     return NULL;
 }
 
+PassGen::KernelCode* PassGen::getFusedCode(){
+    return NULL;
+}
+
+uint32_t PassGen::initFusedKernel(cl::Kernel *kernel, cl::CommandQueue *que, cl::Context *context, uint32_t argIndex) {
+    return 0;
+}
+
+uint64_t PassGen::kernelStepIndex() {
+    return 0;
+}
+
+bool PassGen::nextKernelWindow(uint64_t maxSize, uint64_t *size) {
+    return false;
+}
+
+uint32_t PassGen::kernelStepLength() {
+    return 0;
+}
+
+bool PassGen::kernelStepLengths(uint32_t *min, uint32_t *max) {
+    return false;
+}
+
+std::string PassGen::getPassword(uint64_t index) {
+    return "";
+}
+
 void PassGen::setKernelGWS(uint64_t gws) {
     this->gws = gws;
     this->gpu_mode = true;
@@ -231,16 +260,14 @@ DictionaryPassGen::~DictionaryPassGen(){
 bool DictionaryPassGen::getPassword(char* pass, uint32_t* len) {
     if(file->bad())
         return false;
+    // Buffer is shared by all threads, so line is copied while locked
     pthread_mutex_lock(&mutex);
     this->file->getline(buffer,128);
-    pthread_mutex_unlock(&mutex);
     int read = strlen(buffer);
     *len = read>maxPassLen()?maxPassLen():read;
-    if(read == 0)
-        return false;
-    
     ::memcpy(pass,buffer,*len);
-    return true;
+    pthread_mutex_unlock(&mutex);
+    return read != 0;
 }
 
 uint8_t DictionaryPassGen::maxPassLen(){
@@ -355,6 +382,9 @@ void ThreadedBrutePassGen::setKernelGWS(uint64_t gws) {
 PassGen::KernelCode* ThreadedBrutePassGen::getKernelCode() {
     gpuCode.filename = "kernels/brute_passgen.cl";
     gpuCode.name = "brute_passgen";
+    std::stringstream options;
+    options << "-DCHARSET_SIZE=" << chars_count;
+    gpuCode.options = options.str();
     return &gpuCode;
 }
 
@@ -377,7 +407,7 @@ void ThreadedBrutePassGen::initKernel(cl::Kernel *kernel, cl::CommandQueue *que,
     
     delete[] powers;
     
-    kernel->setArg(2,maxLen);
+    kernel->setArg(2,(cl_uint)gws);        // Stride of password buffer
     kernel->setArg(3,charsBuffer);
     kernel->setArg(4,chars_count);
     kernel->setArg(5,powersBuffer);
@@ -535,6 +565,10 @@ void PassGen::setStep(unsigned step)
 {
 }
 
+void PassGen::replicateData(unsigned node)
+{
+}
+
 bool PassGen::nextKernelStep()
 {
   return(false);
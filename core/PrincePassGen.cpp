@@ -0,0 +1,370 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <PrincePassGen.h>
+
+#include <algorithm>        // upper_bound
+#include <cstring>
+#include <limits>
+#include <sstream>          // stringstream
+#include <stdexcept>
+#include <unordered_set>
+
+using namespace std;
+
+bool PrincePassGen::_cpu_mode;
+PassGen::KernelCode PrincePassGen::_gpu_code;
+cl_uint PrincePassGen::_min_length;
+cl_uint PrincePassGen::_max_length;
+unsigned PrincePassGen::_max_elements;
+std::vector<cl_uchar> PrincePassGen::_elements;
+cl_uint PrincePassGen::_element_offsets[MAX_ELEMENT_LENGTH + 1];
+cl_uint PrincePassGen::_element_counts[MAX_ELEMENT_LENGTH + 1];
+std::vector<cl_ulong> PrincePassGen::_chain_offsets;
+std::vector<cl_uchar> PrincePassGen::_chain_elements;
+int PrincePassGen::_num_instances;
+
+PrincePassGen::PrincePassGen(Options& options, bool cpu_mode) :
+    _instance_id { FACTORY_INSTANCE_ID }
+{
+  _cpu_mode = cpu_mode;
+
+  // Parse length values
+  stringstream ss { options.length };
+  string substr;
+
+  std::getline(ss, substr, ':');
+  _min_length = stoi(substr);
+
+  std::getline(ss, substr);
+  _max_length = stoi(substr);
+
+  if (_min_length < MIN_PASS_LENGTH || _max_length > MAX_PASS_LENGTH
+      || _min_length > _max_length)
+    throw invalid_argument("Invalid value for argument 'length'");
+
+  _max_elements = options.max_elements;
+  if (_max_elements < 1 || _max_elements > MAX_ELEMENTS)
+    throw invalid_argument("Invalid number of PRINCE elements");
+
+  loadElements(options.wordlist);
+
+  if (countChains() > MAX_CHAINS)
+    throw runtime_error("Too many PRINCE chains, reduce length or "
+                        "number of elements");
+
+  // Create chains ordered by their total length
+  vector<cl_uchar> chain;
+  _chain_offsets.assign(1, 0);
+  _chain_elements.clear();
+
+  for (unsigned length = _min_length; length <= _max_length; length++)
+  {
+    createChains(length, chain);
+  }
+
+  if (_chain_offsets.back() == 0)
+    throw runtime_error("Wordlist doesn't contain any usable element");
+
+  setRange(0, _chain_offsets.back());
+
+  _num_instances = 0;
+
+  _gpu_code.filename = _kernel_source;
+  _gpu_code.name = _kernel_name;
+}
+
+PrincePassGen::PrincePassGen(const PrincePassGen& o) :
+    IndexPassGen(o), _instance_id { o._num_instances++ }
+{
+}
+
+PrincePassGen::~PrincePassGen()
+{
+  if (_instance_id == FACTORY_INSTANCE_ID)
+  {
+    for (auto i : _instances)
+      delete i;
+  }
+}
+
+void PrincePassGen::loadElements(const std::string & wordlist)
+{
+  ifstream input { wordlist };
+  if (!input.is_open())
+    throw runtime_error("Unable to open wordlist " + wordlist);
+
+  vector<string> elements[MAX_ELEMENT_LENGTH + 1];
+  unordered_set<string> unique;
+  string line;
+
+  while (getline(input, line))
+  {
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+
+    if (line.empty() || line.size() > MAX_ELEMENT_LENGTH
+        || line.size() > _max_length)
+      continue;
+
+    if (unique.insert(line).second)
+      elements[line.size()].push_back(line);
+  }
+
+  // Store elements grouped by length
+  _elements.clear();
+  for (unsigned l = 0; l <= MAX_ELEMENT_LENGTH; l++)
+  {
+    _element_offsets[l] = _elements.size();
+    _element_counts[l] = elements[l].size();
+
+    for (auto & e : elements[l])
+      _elements.insert(_elements.end(), e.begin(), e.end());
+  }
+}
+
+void PrincePassGen::createChains(unsigned length, std::vector<cl_uchar> & chain)
+{
+  // Chain is complete, add it into table
+  if (length == 0)
+  {
+    cl_ulong keyspace = 1;
+    for (auto l : chain)
+    {
+      if (keyspace > numeric_limits<cl_ulong>::max() / _element_counts[l])
+        throw runtime_error("Too many PRINCE passwords, reduce length or "
+                            "number of elements");
+      keyspace *= _element_counts[l];
+    }
+
+    if (_chain_offsets.back() > numeric_limits<cl_ulong>::max() - keyspace)
+      throw runtime_error("Too many PRINCE passwords, reduce length or "
+                          "number of elements");
+
+    _chain_offsets.push_back(_chain_offsets.back() + keyspace);
+    _chain_elements.insert(_chain_elements.end(), chain.begin(), chain.end());
+    _chain_elements.resize(_chain_elements.size() + MAX_ELEMENTS - chain.size(), 0);
+    return;
+  }
+
+  if (chain.size() == _max_elements)
+    return;
+
+  for (unsigned l = 1; l <= length && l <= MAX_ELEMENT_LENGTH; l++)
+  {
+    if (_element_counts[l] == 0)
+      continue;
+
+    chain.push_back(l);
+    createChains(length - l, chain);
+    chain.pop_back();
+  }
+}
+
+cl_ulong PrincePassGen::countChains()
+{
+  // Number of chains of given number of elements and total length
+  vector<vector<cl_ulong>> count(_max_elements + 1,
+                                 vector<cl_ulong>(_max_length + 1, 0));
+  count[0][0] = 1;
+  cl_ulong total = 0;
+
+  // Counts are saturated, so they can't overflow
+  for (unsigned e = 1; e <= _max_elements; e++)
+  {
+    for (unsigned length = 1; length <= _max_length; length++)
+    {
+      for (unsigned l = 1; l <= length && l <= MAX_ELEMENT_LENGTH; l++)
+      {
+        if (_element_counts[l] != 0)
+          count[e][length] = min(count[e][length] + count[e - 1][length - l],
+                                 MAX_CHAINS + 1);
+      }
+
+      if (length >= _min_length)
+        total = min(total + count[e][length], MAX_CHAINS + 1);
+    }
+  }
+
+  return (total);
+}
+
+PassGen::KernelCode* PrincePassGen::getKernelCode()
+{
+  if (_cpu_mode)
+    return (nullptr);
+  else
+    return (&_gpu_code);
+}
+
+bool PrincePassGen::isFactory()
+{
+  return (_instance_id == FACTORY_INSTANCE_ID);
+}
+
+PassGen* PrincePassGen::createGenerator()
+{
+  if (_instance_id == FACTORY_INSTANCE_ID)
+  {
+    PrincePassGen * new_instance = new PrincePassGen { *this };
+    _instances.push_back(new_instance);
+    return (new_instance);
+  }
+
+  return (nullptr);
+}
+
+uint8_t PrincePassGen::maxPassLen()
+{
+  return (static_cast<uint8_t>(_max_length));
+}
+
+void PrincePassGen::setKernelGWS(uint64_t gws)
+{
+  _gws = gws;
+  // Initialize reservation size
+  _min_reservation_size = 4 * _gws;
+  gpu_mode = true;
+}
+
+void PrincePassGen::initKernel(cl::Kernel* kernel, cl::CommandQueue* que,
+                               cl::Context* context)
+{
+  _kernel = *kernel;
+
+  // Invalid values to prevent kernel execution without reserved passwords
+  _private_start_index = 1;
+  _private_stop_index = 0;
+
+  _elements_buffer = cl::Buffer { *context, CL_MEM_READ_ONLY,
+                                  max<std::size_t>(_elements.size(), 1) };
+  que->enqueueWriteBuffer(_elements_buffer, CL_FALSE, 0, _elements.size(),
+                          _elements.data());
+
+  _element_offsets_buffer = cl::Buffer { *context, CL_MEM_READ_ONLY,
+                                         sizeof(_element_offsets) };
+  que->enqueueWriteBuffer(_element_offsets_buffer, CL_FALSE, 0,
+                          sizeof(_element_offsets), _element_offsets);
+
+  _element_counts_buffer = cl::Buffer { *context, CL_MEM_READ_ONLY,
+                                        sizeof(_element_counts) };
+  que->enqueueWriteBuffer(_element_counts_buffer, CL_FALSE, 0,
+                          sizeof(_element_counts), _element_counts);
+
+  _chain_offsets_buffer = cl::Buffer { *context, CL_MEM_READ_ONLY,
+                                       _chain_offsets.size() * sizeof(cl_ulong) };
+  que->enqueueWriteBuffer(_chain_offsets_buffer, CL_FALSE, 0,
+                          _chain_offsets.size() * sizeof(cl_ulong),
+                          _chain_offsets.data());
+
+  _chain_elements_buffer = cl::Buffer { *context, CL_MEM_READ_ONLY,
+                                        _chain_elements.size() };
+  que->enqueueWriteBuffer(_chain_elements_buffer, CL_FALSE, 0,
+                          _chain_elements.size(), _chain_elements.data());
+
+  cl_uint num_chains = _chain_offsets.size() - 1;
+
+  kernel->setArg(2, _elements_buffer);
+  kernel->setArg(3, _element_offsets_buffer);
+  kernel->setArg(4, _element_counts_buffer);
+  kernel->setArg(5, _chain_offsets_buffer);
+  kernel->setArg(6, _chain_elements_buffer);
+  kernel->setArg(7, num_chains);
+  kernel->setArg(8, _private_start_index);
+  kernel->setArg(9, _private_stop_index);
+}
+
+bool PrincePassGen::nextKernelStep()
+{
+  if (_private_start_index + _gws < _private_stop_index)
+  {
+    _private_start_index += _gws;
+    _kernel.setArg(8, _private_start_index);
+    return (true);
+  }
+
+  if (reservePasswords())
+  {
+    _kernel.setArg(8, _private_start_index);
+    _kernel.setArg(9, _private_stop_index);
+    return (true);
+  }
+
+  return (false);
+}
+
+bool PrincePassGen::reservePasswords()
+{
+  if (!IndexPassGen::reservePasswords())
+    return (false);
+
+  // Find chain of the first password
+  _chain = upper_bound(_chain_offsets.begin(), _chain_offsets.end(),
+                       _private_start_index) - _chain_offsets.begin() - 1;
+
+  return (true);
+}
+
+bool PrincePassGen::getPassword(char* pass, uint32_t* len)
+{
+  if (_private_start_index >= _private_stop_index)
+    if (!reservePasswords())
+      return (false);
+
+  uint64_t index = _private_start_index++;
+
+  // Determine current chain
+  while (index >= _chain_offsets[_chain + 1])
+    _chain++;
+
+  // Convert global index into index inside chain
+  index = index - _chain_offsets[_chain];
+  const cl_uchar *chain = _chain_elements.data() + _chain * MAX_ELEMENTS;
+  uint32_t length = 0;
+
+  // Create password
+  for (unsigned e = 0; e < MAX_ELEMENTS && chain[e] != 0; e++)
+  {
+    unsigned element_length = chain[e];
+    cl_uint count = _element_counts[element_length];
+    const cl_uchar *element = _elements.data()
+        + _element_offsets[element_length] + (index % count) * element_length;
+    index = index / count;
+
+    memcpy(pass + length, element, element_length);
+    length += element_length;
+  }
+
+  *len = length;
+  return (true);
+}
+
+void PrincePassGen::saveState(std::string filename)
+{
+  saveIndex(filename, PASSGEN_ID_PRINCE);
+}
+
+void PrincePassGen::loadState(std::string filename)
+{
+  loadIndex(filename, PASSGEN_ID_PRINCE);
+}
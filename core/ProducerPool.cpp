@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "ProducerPool.h"
+#include "CandidateBuffer.h"
+
+#include <stdexcept>
+#include <unistd.h>        // usleep
+
+using namespace std;
+
+ProducerPool::Consumer::Consumer(size_t capacity, uint32_t batch_size) :
+    free_batches { capacity }, full_batches { capacity },
+    batch_size { batch_size }, closed { false }, users { 0 }
+{
+}
+
+ProducerPool::ProducerPool(PassGen *passgen, unsigned num_producers) :
+    _passgen { passgen }, _num_producers { num_producers }, _num_consumers {
+        0 }, _stop { false }, _exhausted { false }, _running { 0 }
+{
+  if (_num_producers == 0)
+    _num_producers = 1;
+
+  pthread_mutex_init(&_consumers_mutex, nullptr);
+  pthread_mutex_init(&_threads_mutex, nullptr);
+}
+
+ProducerPool::~ProducerPool()
+{
+  stop();
+
+  for (unsigned i = 0; i < _num_consumers; i++)
+    delete _consumers[i];
+
+  pthread_mutex_destroy(&_consumers_mutex);
+  pthread_mutex_destroy(&_threads_mutex);
+}
+
+void ProducerPool::start()
+{
+  pthread_mutex_lock(&_threads_mutex);
+  if (!_threads.empty())
+  {
+    pthread_mutex_unlock(&_threads_mutex);
+    return;
+  }
+
+  if (_passgen->isFactory())
+    _passgen->setStep(_num_producers);
+
+  _args.resize(_num_producers);
+  _threads.resize(_num_producers);
+  _running = _num_producers;
+
+  for (unsigned i = 0; i < _num_producers; i++)
+  {
+    _args[i].pool = this;
+    _args[i].passgen =
+        _passgen->isFactory() ? _passgen->createGenerator() : _passgen;
+    pthread_create(&_threads[i], nullptr, producerThread, &_args[i]);
+  }
+  pthread_mutex_unlock(&_threads_mutex);
+}
+
+void ProducerPool::stop()
+{
+  _stop = true;
+
+  // Stop can be requested by several crackers at once
+  pthread_mutex_lock(&_threads_mutex);
+  for (auto & thread : _threads)
+    pthread_join(thread, nullptr);
+
+  _threads.clear();
+  pthread_mutex_unlock(&_threads_mutex);
+}
+
+ProducerPool::Consumer * ProducerPool::addConsumer(
+    vector<PasswordBatch *> & batches, uint32_t batch_size)
+{
+  size_t capacity = 2;
+  while (capacity < batches.size())
+    capacity <<= 1;
+
+  Consumer *consumer = new Consumer { capacity, batch_size };
+  for (auto batch : batches)
+  {
+    batch->count = 0;
+    consumer->free_batches.push(batch);
+  }
+
+  pthread_mutex_lock(&_consumers_mutex);
+  if (_num_consumers == MAX_CONSUMERS)
+  {
+    pthread_mutex_unlock(&_consumers_mutex);
+    delete consumer;
+    throw runtime_error { "Too many consumers of password producers" };
+  }
+  _consumers[_num_consumers] = consumer;
+  _num_consumers++;
+  pthread_mutex_unlock(&_consumers_mutex);
+
+  return (consumer);
+}
+
+void ProducerPool::removeConsumer(Consumer *consumer)
+{
+  consumer->closed = true;
+
+  // Wait until producers leave the consumer
+  while (consumer->users > 0)
+    usleep(IDLE_SLEEP_US);
+}
+
+PasswordBatch * ProducerPool::getBatch(Consumer *consumer, const bool & stop)
+{
+  PasswordBatch *batch;
+
+  while (!stop)
+  {
+    if (consumer->full_batches.pop(batch))
+      return (batch);
+
+    // Producers have finished, check the queue for the last time
+    if (_running == 0)
+      return (consumer->full_batches.pop(batch) ? batch : nullptr);
+
+    usleep(IDLE_SLEEP_US);
+  }
+
+  return (nullptr);
+}
+
+void ProducerPool::releaseBatch(Consumer *consumer, PasswordBatch *batch)
+{
+  batch->count = 0;
+  consumer->free_batches.push(batch);
+}
+
+void * ProducerPool::producerThread(void *arg)
+{
+  ThreadArg *thread_arg = static_cast<ThreadArg *>(arg);
+  thread_arg->pool->produce(thread_arg->passgen);
+  return (nullptr);
+}
+
+void ProducerPool::produce(PassGen *passgen)
+{
+  unsigned next = 0;
+  // Instance of factory ends with its own reservation, so only producers
+  // sharing one generator stop when another producer exhausts it
+  bool shared = !_passgen->isFactory();
+  bool exhausted = false;
+
+  while (!_stop && !exhausted)
+  {
+    bool produced = false;
+    unsigned num_consumers = _num_consumers;
+
+    // Serve consumers in round-robin order, so slower devices aren't starved
+    for (unsigned i = 0; i < num_consumers && !exhausted; i++)
+    {
+      Consumer *consumer = _consumers[(next + i) % num_consumers];
+      PasswordBatch *batch;
+
+      consumer->users++;
+      if (!consumer->closed && consumer->free_batches.pop(batch))
+      {
+        if (!fillBatch(passgen, batch, consumer))
+        {
+          exhausted = true;
+          if (shared)
+            _exhausted = true;
+        }
+
+        if (batch->count > 0)
+          consumer->full_batches.push(batch);
+        else
+          consumer->free_batches.push(batch);
+
+        produced = true;
+      }
+      consumer->users--;
+    }
+    next++;
+
+    if (shared && _exhausted)
+      exhausted = true;
+
+    // All consumers have enough passwords
+    if (!produced)
+      usleep(IDLE_SLEEP_US);
+  }
+
+  _running--;
+}
+
+bool ProducerPool::fillBatch(PassGen *passgen, PasswordBatch *batch,
+                             Consumer *consumer)
+{
+  uint32_t len;
+  char password[256];
+
+  for (batch->count = 0; batch->count < consumer->batch_size; batch->count++)
+  {
+    if (!passgen->getPassword(password, &len))
+      return (false);
+
+    CandidateBuffer::store(batch->passwords, consumer->batch_size,
+                           batch->count, password, len);
+  }
+
+  return (true);
+}
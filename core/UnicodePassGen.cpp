@@ -121,7 +121,7 @@ void UnicodePassGen::initKernel(cl::Kernel *kernel, cl::CommandQueue *que, cl::C
     
     delete[] powers;
     
-    kernel->setArg(2,maxLen);              // Maximum length of final UTF8 passwords
+    kernel->setArg(2,(cl_uint)gws);        // Stride of password buffer
     kernel->setArg(3,unicodeCharsBuffer);
     kernel->setArg(4,chars_count);
     kernel->setArg(5,powersBuffer);
@@ -46,6 +46,15 @@ uint64_t Utils::getFileModificationTS(std::string& filename) {
 #endif
 }
 
+uint64_t Utils::fnv1a(const char* data, size_t len) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for(size_t i = 0;i < len;i++){
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
 uint64_t Utils::pow(uint64_t x, uint64_t y) {
     if(y == 0)
         return 1;
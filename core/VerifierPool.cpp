@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "VerifierPool.h"
+#include "GPUCracker.h"
+
+#include <unistd.h>        // usleep
+
+using namespace std;
+
+VerifierPool::VerifierPool(CrackerFactory *factory, unsigned num_workers) :
+    _jobs { JOB_QUEUE_CAPACITY }, _results { RESULT_QUEUE_CAPACITY }, _stop {
+        false }
+{
+  if (num_workers == 0)
+    num_workers = 1;
+
+  for (unsigned i = 0; i < num_workers; i++)
+    _verifiers.push_back(dynamic_cast<GPUCracker *>(factory->createCracker()));
+
+  pthread_mutex_init(&_threads_mutex, nullptr);
+}
+
+VerifierPool::~VerifierPool()
+{
+  stop();
+
+  Job *job;
+  while (_jobs.pop(job))
+    delete job;
+
+  string *result;
+  while (_results.pop(result))
+    delete result;
+
+  for (auto verifier : _verifiers)
+    delete verifier;
+
+  pthread_mutex_destroy(&_threads_mutex);
+}
+
+void VerifierPool::start()
+{
+  pthread_mutex_lock(&_threads_mutex);
+  if (_threads.empty())
+  {
+    _args.resize(_verifiers.size());
+    _threads.resize(_verifiers.size());
+
+    for (size_t i = 0; i < _verifiers.size(); i++)
+    {
+      _args[i].pool = this;
+      _args[i].verifier = _verifiers[i];
+      pthread_create(&_threads[i], nullptr, workerThread, &_args[i]);
+    }
+  }
+  pthread_mutex_unlock(&_threads_mutex);
+}
+
+void VerifierPool::stop()
+{
+  _stop = true;
+
+  // Stop can be requested by several crackers at once
+  pthread_mutex_lock(&_threads_mutex);
+  for (auto & thread : _threads)
+    pthread_join(thread, nullptr);
+
+  _threads.clear();
+  pthread_mutex_unlock(&_threads_mutex);
+}
+
+bool VerifierPool::submit(const string & password, const string & data,
+                          atomic<uint32_t> *pending)
+{
+  Job *job = new Job { password, data, pending };
+
+  (*pending)++;
+  if (!_jobs.push(job))
+  {
+    (*pending)--;
+    delete job;
+    return (false);
+  }
+
+  return (true);
+}
+
+bool VerifierPool::getResult(string & password)
+{
+  string *result;
+
+  if (!_results.pop(result))
+    return (false);
+
+  password.assign(*result);
+  delete result;
+  return (true);
+}
+
+void * VerifierPool::workerThread(void *arg)
+{
+  ThreadArg *thread_arg = static_cast<ThreadArg *>(arg);
+  thread_arg->pool->work(thread_arg->verifier);
+  return (nullptr);
+}
+
+void VerifierPool::work(GPUCracker *verifier)
+{
+  Job *job;
+
+  while (!_stop)
+  {
+    if (!_jobs.pop(job))
+    {
+      usleep(IDLE_SLEEP_US);
+      continue;
+    }
+
+    // Result has to be in queue before submitter sees no pending password
+    if (verifier->verifyPassword(job->password, job->data))
+    {
+      string *result = new string { job->password };
+      if (!_results.push(result))
+        delete result;
+    }
+
+    (*job->pending)--;
+    delete job;
+  }
+}
@@ -27,15 +27,18 @@
 #define MAX_PASS_LEN 20
 #endif
 
+// Size of charset is compile-time constant if it's set by build options
+#ifndef CHARSET_SIZE
+#define CHARSET_SIZE chars_count
+#endif
+
 /**
  * @author Honza
  */
-kernel void brute_passgen(global uchar* passwords, ulong step, uint max_size, constant uchar *chars, uint chars_count, constant ulong *powers, constant uchar *char_pos) {
-    int id = get_global_id(0);
-
+kernel void brute_passgen(global uint* passwords, ulong step, uint stride, constant uchar *chars, uint chars_count, constant ulong *powers, constant uchar *char_pos) {
     uchar state[MAX_PASS_LEN] = {0};
-    uchar passlen = passwords[(max_size)*id];
-    global uchar *password = passwords+((max_size)*id)+1;
+    uchar password[(MAX_PASS_LEN+3)/4*4];
+    uchar passlen = load_candidate(get_global_id(0),password,passwords,stride);
     uchar first_char = MAX_PASS_LEN - passlen;
     ulong state_change = step;
     uchar lowest = MAX_PASS_LEN-1;
@@ -51,7 +54,7 @@ kernel void brute_passgen(global uchar* passwords, ulong step, uint max_size, co
         canAdd = 0;
         // prevedeme co muzeme pricist bez preteceni, do soustavy se kterou se dobre pocita
         for(int i = first_char;i<=lowest;i++){
-            canAdd += ((chars_count-1)-state[i])*powers[lowest-i];//prevod z n-kove soustavy do 10kove
+            canAdd += ((CHARSET_SIZE-1)-state[i])*powers[lowest-i];//prevod z n-kove soustavy do 10kove
         }
         if(state_change > canAdd)
             toAdd = canAdd;
@@ -63,12 +66,12 @@ kernel void brute_passgen(global uchar* passwords, ulong step, uint max_size, co
         // pricteme co muzeme
         carry = 0;
         for(int i = lowest;toAdd>0 || carry;i--){
-            char state_add = toAdd % chars_count;
-            toAdd /= chars_count;
+            char state_add = toAdd % CHARSET_SIZE;
+            toAdd /= CHARSET_SIZE;
             state[i]+=state_add + carry;
-            if(state[i] >= chars_count){
+            if(state[i] >= CHARSET_SIZE){
                 carry = 1;
-                state[i] %= chars_count;
+                state[i] %= CHARSET_SIZE;
             }else{
                 carry = 0;
             }
@@ -85,8 +88,8 @@ kernel void brute_passgen(global uchar* passwords, ulong step, uint max_size, co
                     state[i]--;
                 }
                 state[i] += carry;
-                if(state[i]>chars_count-1){
-                    state[i] %= chars_count;
+                if(state[i]>CHARSET_SIZE-1){
+                    state[i] %= CHARSET_SIZE;
                     carry = 1;
                 }else{
                     break;
@@ -100,5 +103,5 @@ kernel void brute_passgen(global uchar* passwords, ulong step, uint max_size, co
     for(out_i=0, in_i=first_char;in_i<MAX_PASS_LEN;in_i++,out_i++){
         password[out_i] = chars[state[in_i]];
     }
-    passwords[(max_size)*id] = out_i;
+    store_candidate(passwords,stride,password,out_i);
 }
@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Header prepended to cracking and generator kernels. Candidates are read from
+ * password buffer filled by host or by generator kernel.
+ *
+ * Password buffer is transposed (see CandidateBuffer.h), first row holds
+ * lengths and row k + 1 holds k-th 4-byte word of every candidate, so
+ * neighbouring work items access neighbouring words. Stride is capacity of
+ * the buffer.
+ *
+ * Cracking kernels declare generator's parameters with PASSGEN_PARAMS after
+ * found_queue, get candidate with LOAD_CANDIDATE and report found candidate
+ * with REPORT_CANDIDATE, so the same kernel can be built with fused generator
+ * (see fused_candidate.cl). Candidate is cracked by function called from
+ * FOR_EACH_CANDIDATE loop of kernel with PASSGEN_ARGS. Work item cracks
+ * ITEM_CANDIDATES candidates (build option, default 1), work group takes
+ * consecutive block of candidates and its items step by local size, so
+ * accesses to the buffer stay coalesced.
+ *
+ * If kernel is built with PASS_LEN, all candidates of its dispatch have this
+ * length. Length returned by LOAD_CANDIDATE is passed through CANDIDATE_LENGTH,
+ * so loops over password and padding of hashes are resolved at compile time.
+ */
+
+#define PASSGEN_PARAMS
+#define PASSGEN_ARGS
+
+#ifndef ITEM_CANDIDATES
+#define ITEM_CANDIDATES 1
+#endif
+
+#define FOR_EACH_CANDIDATE(id) \
+  size_t first_##id = (get_global_id(0) - get_local_id(0)) * ITEM_CANDIDATES; \
+  for (size_t id = first_##id + get_local_id(0); \
+       id < first_##id + ITEM_CANDIDATES * get_local_size(0) && id < stride; \
+       id += get_local_size(0))
+
+/**
+ * Entry of found queue holds global index of work item, length and words of
+ * candidate
+ */
+#define FOUND_ENTRY_WORDS (2 + (MAX_PASS_LEN + 3) / 4)
+
+#ifdef PASS_LEN
+#define CANDIDATE_LENGTH(length) PASS_LEN
+#else
+#define CANDIDATE_LENGTH(length) (length)
+#endif
+
+/**
+ * Copies candidate of work item into private buffer
+ * @return length of candidate, -1 if work item has no candidate
+ */
+#define LOAD_CANDIDATE(id, buffer, passwords, stride) \
+  load_candidate (id, buffer, passwords, stride)
+
+/**
+ * Buffer has to have space for length rounded up to multiple of 4
+ */
+inline int load_candidate (size_t id, uchar *buffer, __global uint *passwords,
+                           uint stride)
+{
+#ifdef PASS_LEN
+  // Candidates of other lengths are stale entries of the buffer
+  if (passwords[id] != PASS_LEN)
+    return (-1);
+  const uint length = PASS_LEN;
+#else
+  uint length = passwords[id];
+#endif
+
+  for (uint k = 0; k < (length + 3) / 4; k++)
+  {
+    vstore4 (as_uchar4 (passwords[(k + 1) * stride + id]), k, buffer);
+  }
+
+  return (length);
+}
+
+/**
+ * Appends candidate of work item to found queue. Queue has the same capacity
+ * as password buffer, it can overflow only if counter isn't cleared between
+ * kernels (timed runs). Dropped hits are still counted, so host verifies all
+ * passwords of slot then. Candidate is copied from password buffer, because
+ * kernels modify private buffer.
+ */
+#define REPORT_CANDIDATE(id, found_count, found_queue, passwords, stride) \
+  report_candidate (id, found_count, found_queue, passwords, stride)
+
+inline void report_candidate (size_t id, __global uint *found_count,
+                              __global uint *found_queue,
+                              __global uint *passwords, uint stride)
+{
+  uint index = atomic_inc (found_count);
+  if (index >= stride)
+    return;
+
+  __global uint *entry = found_queue + index * FOUND_ENTRY_WORDS;
+  uint length = passwords[id];
+
+  entry[0] = id;
+  entry[1] = length;
+  for (uint k = 0; k < (length + 3) / 4; k++)
+  {
+    entry[k + 2] = passwords[(k + 1) * stride + id];
+  }
+}
+
+/**
+ * Stores candidate of work item into password buffer, bytes of the last word
+ * behind the candidate are zeroed
+ */
+inline void store_candidate (__global uint *passwords, uint stride,
+                             uchar *buffer, uint length)
+{
+  size_t id = get_global_id(0);
+
+  for (uint i = length; i % 4 != 0; i++)
+  {
+    buffer[i] = 0;
+  }
+
+  passwords[id] = length;
+  for (uint k = 0; k < (length + 3) / 4; k++)
+  {
+    passwords[(k + 1) * stride + id] = as_uint (vload4 (k, buffer));
+  }
+}
+
+/*
+ * Vector kernels for CPU devices are built with VECTOR_WIDTH (8 or 16). Work
+ * item cracks VECTOR_WIDTH consecutive candidates in lanes of u32x words, so
+ * a word of all its candidates is one vector load from transposed buffer and
+ * lanes are mapped to SIMD registers by compiler. Masks of lanes are i32x,
+ * comparisons of lanes are tested with ANY_LANE. Scalar kernels have u32x
+ * and i32x of one lane, so hash functions are shared by both variants. Host
+ * keeps stride multiple of VECTOR_WIDTH.
+ */
+#ifdef VECTOR_WIDTH
+
+// Width is expanded before it's pasted to name
+#define VECTOR_PASTE(name, width) name##width
+#define VECTOR_NAME_(name, width) VECTOR_PASTE(name, width)
+#define VECTOR_NAME(name) VECTOR_NAME_(name, VECTOR_WIDTH)
+
+typedef VECTOR_NAME (uint) u32x;
+typedef VECTOR_NAME (int) i32x;
+
+#define ANY_LANE(mask) any (mask)
+
+#define FOR_EACH_VECTOR(id) \
+  size_t id = get_global_id (0) * VECTOR_WIDTH; \
+  if (id < stride)
+
+/**
+ * Loads lengths and words of candidates of work item into lanes, rows of
+ * buffer are read up to the longest candidate (at most max_words)
+ * @return mask of lanes with candidate
+ */
+inline i32x load_vector (size_t id, u32x *length, u32x *words,
+                         uint max_words, __global uint *passwords,
+                         uint stride)
+{
+  *length = VECTOR_NAME (vload) (0, passwords + id);
+
+  for (uint k = 0; k < max_words; k++)
+  {
+    if (ANY_LANE (*length > 4 * k))
+      words[k] = VECTOR_NAME (vload) (0, passwords + (k + 1) * stride + id);
+    else
+      words[k] = 0;
+  }
+
+#ifdef PASS_LEN
+  return (*length == PASS_LEN);
+#else
+  return ((i32x) -1);
+#endif
+}
+
+/**
+ * Reports candidates of lanes set in mask
+ */
+inline void report_vector (size_t id, i32x found, __global uint *found_count,
+                           __global uint *found_queue,
+                           __global uint *passwords, uint stride)
+{
+  int lanes[VECTOR_WIDTH];
+
+  if (!ANY_LANE (found))
+    return;
+
+  VECTOR_NAME (vstore) (found, 0, lanes);
+  for (uint i = 0; i < VECTOR_WIDTH; i++)
+  {
+    if (lanes[i])
+      report_candidate (id + i, found_count, found_queue, passwords, stride);
+  }
+}
+
+#else
+
+typedef uint u32x;
+typedef int i32x;
+
+#define ANY_LANE(mask) (mask)
+
+#endif
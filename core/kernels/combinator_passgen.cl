@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#define MAX_WORD_LENGTH 20
+#define WORD_ENTRY_SIZE (MAX_WORD_LENGTH + 1)
+
+__kernel void combinator_passgen (__global uint *passwords, uint stride,
+                    __global uchar *left_words, __global uchar *right_words,
+                    ulong right_count, ulong left_base, ulong index_start,
+                    ulong index_stop)
+{
+  size_t id = get_global_id(0);
+  ulong global_index = index_start + id;
+  uchar buffer[(MAX_PASS_LEN + 3) / 4 * 4];
+
+  if (global_index >= index_stop)
+  {
+    return;
+  }
+
+  // Decode pair of words from global index
+  ulong left_index = global_index / right_count - left_base;
+  ulong right_index = global_index % right_count;
+
+  __global uchar *left = left_words + left_index * WORD_ENTRY_SIZE;
+  __global uchar *right = right_words + right_index * WORD_ENTRY_SIZE;
+  uint left_length = left[0];
+  uint right_length = right[0];
+
+  // Create password
+  for (uint i = 0; i < left_length; i++)
+  {
+    buffer[i] = left[i + 1];
+  }
+
+  for (uint i = 0; i < right_length; i++)
+  {
+    buffer[left_length + i] = right[i + 1];
+  }
+
+  store_candidate (passwords, stride, buffer, left_length + right_length);
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Common part of generators fused into cracking kernels. It's prepended to
+ * cracking kernel together with header of generator (e.g. markov_candidate.cl)
+ * instead of candidate.cl, so candidates are created in private memory and
+ * never stored in global memory. Found passwords are reported by index of
+ * work item and decoded by host.
+ *
+ * Header of generator defines PASSGEN_PARAMS and PASSGEN_ARGS, which end with
+ * PERSISTENT_PARAMS and PERSISTENT_ARGS, and LOAD_CANDIDATE returning -1 for
+ * index out of reservation.
+ *
+ * Kernel built with PERSISTENT is launched once for whole reservation of
+ * generator. Its work items take chunks of indexes from work_counter until
+ * window of indexes is exhausted or they see stop_flag set by host (it's only
+ * a hint, host limits time of windows).
+ */
+
+#ifdef PASS_LEN
+#define CANDIDATE_LENGTH(length) PASS_LEN
+#else
+#define CANDIDATE_LENGTH(length) (length)
+#endif
+
+/**
+ * Fused kernels are scalar, see vector kernels in candidate.cl
+ */
+typedef uint u32x;
+typedef int i32x;
+
+#define ANY_LANE(mask) (mask)
+
+/**
+ * Entry of found queue holds only global index of work item, candidate is
+ * created again by host
+ */
+#define FOUND_ENTRY_WORDS 1
+
+#define REPORT_CANDIDATE(id, found_count, found_queue, passwords, stride) \
+  report_index (id, found_count, found_queue, stride)
+
+/**
+ * Appends index of candidate to found queue with capacity of stride (one
+ * entry per candidate of launch), hits beyond it are only counted
+ */
+inline void report_index (size_t id, __global uint *found_count,
+                          __global uint *found_queue, uint stride)
+{
+  uint index = atomic_inc (found_count);
+  if (index < stride)
+    found_queue[index] = id;
+}
+
+#ifdef PERSISTENT
+
+/**
+ * Number of indexes taken from work_counter at once
+ */
+#define PERSISTENT_CHUNK 16
+
+#define PERSISTENT_PARAMS , __global uint *work_counter, \
+  __global volatile uint *stop_flag, uint window
+#define PERSISTENT_ARGS , work_counter, stop_flag, window
+
+#define FOR_EACH_CANDIDATE(id) \
+  uint next_index = 0, end_index = 0; \
+  for (size_t id; next_candidate (&id, &next_index, &end_index, \
+                                  work_counter, stop_flag, window);)
+
+/**
+ * Gets index of next candidate of work item
+ * @return false if window is exhausted or host has stopped the kernel
+ */
+inline bool next_candidate (size_t *id, uint *next_index, uint *end_index,
+                            __global uint *work_counter,
+                            __global volatile uint *stop_flag, uint window)
+{
+  if (*next_index == *end_index)
+  {
+    if (*stop_flag != 0)
+      return (false);
+
+    *next_index = atomic_add (work_counter, PERSISTENT_CHUNK);
+    if (*next_index >= window)
+      return (false);
+    *end_index = min (*next_index + PERSISTENT_CHUNK, window);
+  }
+
+  *id = (*next_index)++;
+  return (true);
+}
+
+#else
+
+#define PERSISTENT_PARAMS
+#define PERSISTENT_ARGS
+
+#ifndef ITEM_CANDIDATES
+#define ITEM_CANDIDATES 1
+#endif
+
+// Work group takes block of candidates, see candidate.cl
+#define FOR_EACH_CANDIDATE(id) \
+  size_t first_##id = (get_global_id(0) - get_local_id(0)) * ITEM_CANDIDATES; \
+  for (size_t id = first_##id + get_local_id(0); \
+       id < first_##id + ITEM_CANDIDATES * get_local_size(0) && id < stride; \
+       id += get_local_size(0))
+
+#endif
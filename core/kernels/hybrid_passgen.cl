@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#define CHARSET_SIZE 256
+
+#define MAX_WORD_LENGTH 20
+#define MAX_MASK_LENGTH 16
+#define WORD_ENTRY_SIZE (MAX_WORD_LENGTH + 1)
+
+__kernel void hybrid_passgen (__global uint *passwords, uint stride,
+                    __global uchar *words, __constant uchar *charsets,
+                    __constant uint *charset_sizes, uint mask_length,
+                    uint prepend, ulong keyspace, ulong index_start,
+                    ulong index_stop)
+{
+  size_t id = get_global_id(0);
+  ulong global_index = index_start + id;
+
+  if (global_index >= index_stop)
+  {
+    return;
+  }
+
+  // Split global index into word's index and mask's index
+  ulong word_index = global_index / keyspace;
+  ulong mask_index = global_index % keyspace;
+
+  __global uchar *word = words + word_index * WORD_ENTRY_SIZE;
+  uint word_length = word[0];
+
+  // Create password in private memory
+  uchar buffer[(MAX_WORD_LENGTH + MAX_MASK_LENGTH + 3) / 4 * 4];
+  uint word_offset = prepend ? mask_length : 0;
+  uint mask_offset = prepend ? 0 : word_length;
+
+  for (uint i = 0; i < word_length; i++)
+  {
+    buffer[word_offset + i] = word[i + 1];
+  }
+
+  for (int p = mask_length - 1; p >= 0; p--)
+  {
+    uint size = charset_sizes[p];
+    buffer[mask_offset + p] = charsets[p * CHARSET_SIZE + mask_index % size];
+    mask_index /= size;
+  }
+
+  store_candidate (passwords, stride, buffer, word_length + mask_length);
+}
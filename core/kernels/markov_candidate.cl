@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Markov generator fused into cracking kernels, see fused_candidate.cl.
+ *
+ * Kernel built with PASS_LEN is used only for steps of this length.
+ */
+
+#define MARKOV_CHARSET_SIZE 256
+
+#define PASSGEN_PARAMS , __global uchar *markov_table, \
+  __constant uint *thresholds, __constant ulong *permutations, \
+  uint max_threshold, ulong index_start, ulong index_stop, uint length \
+  PERSISTENT_PARAMS
+#define PASSGEN_ARGS , markov_table, thresholds, permutations, max_threshold, \
+  index_start, index_stop, length PERSISTENT_ARGS
+
+/**
+ * Creates candidate of work item in private buffer
+ * @return length of candidate, -1 if index of work item is out of reservation
+ */
+#define LOAD_CANDIDATE(id, buffer, passwords, stride) \
+  markov_candidate (id, buffer, markov_table, thresholds, permutations, \
+                    max_threshold, index_start, index_stop, length)
+
+inline int markov_candidate (size_t id, uchar *buffer,
+                             __global uchar *markov_table,
+                             __constant uint *thresholds,
+                             __constant ulong *permutations,
+                             uint max_threshold, ulong index_start,
+                             ulong index_stop, uint length)
+{
+  ulong global_index = index_start + id;
+
+  if (global_index >= index_stop)
+  {
+    return (-1);
+  }
+
+#ifdef PASS_LEN
+  // Kernel is dispatched only for indexes of this length
+  length = PASS_LEN;
+#else
+  // Determine current length
+  while (global_index >= permutations[length])
+  {
+    length++;
+  }
+#endif
+
+  // Convert global index into local index
+  ulong index = global_index - permutations[length - 1];
+  ulong partial_index;
+  uchar last_char = 0;
+
+  // Create password
+  for (int p = 0; p < length; p++)
+  {
+    partial_index = index % thresholds[p];
+    index = index / thresholds[p];
+
+    last_char = markov_table[p * MARKOV_CHARSET_SIZE * max_threshold
+                             + last_char * max_threshold + partial_index];
+
+    buffer[p] = last_char;
+  }
+
+  return (length);
+}
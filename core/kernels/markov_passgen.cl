@@ -23,18 +23,14 @@
 
 #define CHARSET_SIZE 256
 
-#define PASS_EXTRA_BYTES 1
-#define PASS_PAYLOAD_OFFSET 1
-#define PASS_LENGTH_OFFSET 0
-
-__kernel void markov_passgen (__global uchar *passwords, uchar entry_size,
+__kernel void markov_passgen (__global uint *passwords, uint stride,
                     __global uchar *markov_table, __constant uint *thresholds,
                     __constant ulong *permutations, uint max_threshold,
                     ulong index_start, ulong index_stop, uint length)
 {
   size_t id = get_global_id(0);
   ulong global_index = index_start + id;
-  __global uchar *password = passwords + id * entry_size;
+  uchar buffer[(MAX_PASS_LEN + 3) / 4 * 4];
 
   if (global_index >= index_stop)
   {
@@ -54,7 +50,6 @@ __kernel void markov_passgen (__global uchar *passwords, uchar entry_size,
   uchar last_char = 0;
 
   // Create password
-  password[PASS_LENGTH_OFFSET] = length;
   for (int p = 0; p < length; p++)
   {
     partial_index = index % thresholds[p];
@@ -63,6 +58,8 @@ __kernel void markov_passgen (__global uchar *passwords, uchar entry_size,
     last_char = markov_table[p * CHARSET_SIZE * max_threshold
                              + last_char * max_threshold + partial_index];
 
-    password[p + PASS_PAYLOAD_OFFSET] = last_char;
+    buffer[p] = last_char;
   }
+
+  store_candidate (passwords, stride, buffer, length);
 }
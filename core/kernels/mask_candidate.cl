@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Mask generator fused into cracking kernels, see fused_candidate.cl.
+ */
+
+#define MASK_CHARSET_SIZE 256
+
+#define PASSGEN_PARAMS , __global uchar *charsets, \
+  __global uint *charset_sizes, __global uint *mask_positions, \
+  __global uint *mask_lengths, __global ulong *mask_offsets, uint num_masks, \
+  ulong index_start, ulong index_stop PERSISTENT_PARAMS
+#define PASSGEN_ARGS , charsets, charset_sizes, mask_positions, mask_lengths, \
+  mask_offsets, num_masks, index_start, index_stop PERSISTENT_ARGS
+
+/**
+ * Creates candidate of work item in private buffer
+ * @return length of candidate, -1 if index of work item is out of reservation
+ */
+#define LOAD_CANDIDATE(id, buffer, passwords, stride) \
+  mask_candidate (id, buffer, charsets, charset_sizes, mask_positions, \
+                  mask_lengths, mask_offsets, num_masks, index_start, \
+                  index_stop)
+
+inline int mask_candidate (size_t id, uchar *buffer, __global uchar *charsets,
+                           __global uint *charset_sizes,
+                           __global uint *mask_positions,
+                           __global uint *mask_lengths,
+                           __global ulong *mask_offsets, uint num_masks,
+                           ulong index_start, ulong index_stop)
+{
+  ulong global_index = index_start + id;
+
+  if (global_index >= index_stop)
+  {
+    return (-1);
+  }
+
+  // Find mask of the password (mask_offsets has num_masks + 1 items)
+  uint low = 0;
+  uint high = num_masks;
+  while (high - low > 1)
+  {
+    uint middle = (low + high) / 2;
+    if (mask_offsets[middle] <= global_index)
+      low = middle;
+    else
+      high = middle;
+  }
+
+  // Convert global index into index inside mask
+  ulong index = global_index - mask_offsets[low];
+  uint position = mask_positions[low];
+  uint length = mask_lengths[low];
+
+  // Create password, the last position changes most frequently
+  for (int p = length - 1; p >= 0; p--)
+  {
+    uint size = charset_sizes[position + p];
+
+    buffer[p] = charsets[(position + p) * MASK_CHARSET_SIZE + index % size];
+    index = index / size;
+  }
+
+  return (length);
+}
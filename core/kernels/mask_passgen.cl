@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#define CHARSET_SIZE 256
+
+__kernel void mask_passgen (__global uint *passwords, uint stride,
+                    __global uchar *charsets, __global uint *charset_sizes,
+                    __global uint *mask_positions, __global uint *mask_lengths,
+                    __global ulong *mask_offsets, uint num_masks,
+                    ulong index_start, ulong index_stop)
+{
+  size_t id = get_global_id(0);
+  ulong global_index = index_start + id;
+  uchar buffer[(MAX_PASS_LEN + 3) / 4 * 4];
+
+  if (global_index >= index_stop)
+  {
+    return;
+  }
+
+  // Find mask of the password (mask_offsets has num_masks + 1 items)
+  uint low = 0;
+  uint high = num_masks;
+  while (high - low > 1)
+  {
+    uint middle = (low + high) / 2;
+    if (mask_offsets[middle] <= global_index)
+      low = middle;
+    else
+      high = middle;
+  }
+
+  // Convert global index into index inside mask
+  ulong index = global_index - mask_offsets[low];
+  uint position = mask_positions[low];
+  uint length = mask_lengths[low];
+
+  // Create password
+  for (int p = length - 1; p >= 0; p--)
+  {
+    uint size = charset_sizes[position + p];
+
+    buffer[p] = charsets[(position + p) * CHARSET_SIZE + index % size];
+    index = index / size;
+  }
+
+  store_candidate (passwords, stride, buffer, length);
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#define MAX_ELEMENTS 8
+
+__kernel void prince_passgen (__global uint *passwords, uint stride,
+                    __global uchar *elements, __constant uint *element_offsets,
+                    __constant uint *element_counts,
+                    __global ulong *chain_offsets,
+                    __global uchar *chain_elements, uint num_chains,
+                    ulong index_start, ulong index_stop)
+{
+  size_t id = get_global_id(0);
+  ulong global_index = index_start + id;
+  uchar buffer[(MAX_PASS_LEN + 3) / 4 * 4];
+
+  if (global_index >= index_stop)
+  {
+    return;
+  }
+
+  // Find chain of the password (chain_offsets has num_chains + 1 items)
+  uint low = 0;
+  uint high = num_chains;
+  while (high - low > 1)
+  {
+    uint middle = (low + high) / 2;
+    if (chain_offsets[middle] <= global_index)
+      low = middle;
+    else
+      high = middle;
+  }
+
+  // Convert global index into index inside chain
+  ulong index = global_index - chain_offsets[low];
+  __global uchar *chain = chain_elements + low * MAX_ELEMENTS;
+  uint length = 0;
+
+  // Create password
+  for (uint e = 0; e < MAX_ELEMENTS && chain[e] != 0; e++)
+  {
+    uint element_length = chain[e];
+    uint count = element_counts[element_length];
+    __global uchar *element = elements + element_offsets[element_length]
+        + (index % count) * element_length;
+    index = index / count;
+
+    for (uint i = 0; i < element_length; i++)
+    {
+      buffer[length + i] = element[i];
+    }
+    length += element_length;
+  }
+
+  store_candidate (passwords, stride, buffer, length);
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * RC4 library of cracking kernels. It's placed before source of kernel, which
+ * sets kernelLibrary of cracker.
+ *
+ * States of work group are interleaved in local memory declared by kernel
+ * with RC4_LOCAL_SBOXES, byte i of S-box of work item w is at
+ * S[i * LOCAL_SIZE + w], so data-dependent accesses of neighbouring work items
+ * fall into different banks. Indexes i and j are kept in private memory.
+ *
+ * LOCAL_SIZE is set by build options of cracker, kernel is compiled for it
+ * with reqd_work_group_size.
+ */
+
+#ifndef LOCAL_SIZE
+#define LOCAL_SIZE 64
+#endif
+
+#define RC4_LOCAL_SBOXES(name) local uchar name[256 * LOCAL_SIZE]
+
+#define RC4_S(state, index) ((state)->S[(uint) (index) * LOCAL_SIZE])
+
+typedef struct
+{
+  local uchar *S;
+  uchar i;
+  uchar j;
+} RC4State;
+
+/**
+ * Binds state to S-box of work item in interleaved S-boxes
+ */
+inline void rc4_init (RC4State *state, local uchar *sboxes)
+{
+  state->S = sboxes + get_local_id (0);
+}
+
+/**
+ * Key schedule for key of constant length, loop is fully unrolled, so
+ * indexes of key are resolved at compile time
+ */
+inline void rc4_schedule (RC4State *state, const uchar *key, uint key_len)
+{
+  uchar j = 0;
+
+  #pragma unroll
+  for (uint i = 0; i < 256; i++)
+    RC4_S (state, i) = i;
+
+  #pragma unroll
+  for (uint i = 0; i < 256; i++)
+  {
+    uchar si = RC4_S (state, i);
+    j += si + key[i % key_len];
+    RC4_S (state, i) = RC4_S (state, j);
+    RC4_S (state, j) = si;
+  }
+
+  state->i = 0;
+  state->j = 0;
+}
+
+/**
+ * Key schedule for 5-byte (40-bit) key
+ */
+inline void rc4_set_key5 (RC4State *state, const uchar *key)
+{
+  rc4_schedule (state, key, 5);
+}
+
+/**
+ * Key schedule for 16-byte (128-bit) key
+ */
+inline void rc4_set_key16 (RC4State *state, const uchar *key)
+{
+  rc4_schedule (state, key, 16);
+}
+
+/**
+ * Next byte of keystream
+ */
+inline uchar rc4_keystream (RC4State *state)
+{
+  state->i++;
+  uchar si = RC4_S (state, state->i);
+  state->j += si;
+  uchar sj = RC4_S (state, state->j);
+  RC4_S (state, state->i) = sj;
+  RC4_S (state, state->j) = si;
+  return (RC4_S (state, (uchar) (si + sj)));
+}
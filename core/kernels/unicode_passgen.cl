@@ -27,7 +27,7 @@
 #define MAX_PASS_LEN 20
 #endif
 
-inline void uc_append(uint cp, global uchar* target, uchar *utf8len)
+inline void uc_append(uint cp, uchar* target, uchar *utf8len)
 {
     if (cp < 0x80) {                       // one octet
         *(target++) = (uchar)(cp);  
@@ -51,7 +51,7 @@ inline void uc_append(uint cp, global uchar* target, uchar *utf8len)
     }
 }
 
-inline void uc_utf32to8 (uint* start, uint* end, global uchar* target, uchar *utf8len)
+inline void uc_utf32to8 (uint* start, uint* end, uchar* target, uchar *utf8len)
 {
     while (start != end) {
         uc_append(*(start++), target, utf8len);
@@ -61,13 +61,11 @@ inline void uc_utf32to8 (uint* start, uint* end, global uchar* target, uchar *ut
 /**
  * @author Radek
  */
-kernel void unicode_passgen(global uchar* passwords, ulong step, uint max_size, constant uint *unicode_chars, uint chars_count, constant ulong *powers, constant uchar *char_pos, uint utf32_maxLen) {
-    int id = get_global_id(0);
-    
+kernel void unicode_passgen(global uint* passwords, ulong step, uint stride, constant uint *unicode_chars, uint chars_count, constant ulong *powers, constant uchar *char_pos, uint utf32_maxLen) {
     uchar state[MAX_PASS_LEN] = {0};
-    uchar passlen = passwords[max_size*id];
     uint uc_password[MAX_PASS_LEN] = {0};
-    global uchar *password = passwords+(max_size*id)+1;
+    uchar password[(MAX_PASS_LEN+3)/4*4];
+    uchar passlen = load_candidate(get_global_id(0),password,passwords,stride);
     uchar first_char = MAX_PASS_LEN - passlen;
     ulong state_change = step;
     uchar lowest = MAX_PASS_LEN-1;
@@ -137,6 +135,6 @@ kernel void unicode_passgen(global uchar* passwords, ulong step, uint max_size,
     uchar utf8len = 0;
     uc_utf32to8(uc_password, uc_password + out_i, password, &utf8len);
     printf("%d", utf8len);
-    passwords[max_size*id] = utf8len; // Update length to UTF-8 length
+    store_candidate(passwords,stride,password,utf8len); // Length is UTF-8 length
     
 }
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef BATCHPASSGEN_H_
+#define BATCHPASSGEN_H_
+
+#include "PassGen.h"
+#include "ProducerPool.h"
+
+#include <vector>
+#include <cstdint>
+
+/**
+ * Generator which takes passwords from batches of producer pool. It lets CPU
+ * crackers run next to GPU crackers on the same passwords: pool serves every
+ * consumer as fast as it frees its batches, so each cracker gets share of
+ * passwords proportional to its speed.
+ */
+class BatchPassGen : public PassGen
+{
+public:
+  /**
+   * @param pool Pool of producers filling batches of the generator
+   * @param max_length Maximum length of password
+   * @param stop Flag which stops waiting for batch
+   */
+  BatchPassGen(ProducerPool *pool, uint8_t max_length, const bool & stop);
+  virtual ~BatchPassGen();
+
+  virtual bool getPassword(char *pass, uint32_t *len);
+  virtual uint8_t maxPassLen();
+
+private:
+  // Small batches, so CPU crackers don't hold back passwords on stop
+  static const uint32_t BATCH_SIZE = 1024;
+  static const unsigned NUM_BATCHES = 2;
+
+  ProducerPool *_pool;
+  ProducerPool::Consumer *_consumer;
+  std::vector<char> _buffer;
+  std::vector<PasswordBatch> _batches;
+  PasswordBatch *_batch;
+  uint32_t _index;
+  uint8_t _max_length;
+  const bool & _stop;
+};
+
+#endif /* BATCHPASSGEN_H_ */
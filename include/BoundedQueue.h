@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef BOUNDEDQUEUE_H_
+#define BOUNDEDQUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+/**
+ * Bounded lock-free multi-producer multi-consumer queue (Dmitry Vyukov's
+ * algorithm). Every cell has sequence number, which says if the cell is
+ * ready to be written or read in current lap of the ring buffer.
+ */
+template<typename T>
+class BoundedQueue
+{
+public:
+  /**
+   * Create queue
+   * @param capacity Capacity of queue (must be power of 2)
+   */
+  BoundedQueue(std::size_t capacity) :
+      _buffer { new Cell[checkCapacity(capacity)] }, _mask { capacity - 1 }
+  {
+    for (std::size_t i = 0; i < capacity; i++)
+      _buffer[i].sequence.store(i, std::memory_order_relaxed);
+
+    _enqueue_pos.store(0, std::memory_order_relaxed);
+    _dequeue_pos.store(0, std::memory_order_relaxed);
+  }
+
+  ~BoundedQueue()
+  {
+    delete[] _buffer;
+  }
+
+  /**
+   * Insert item into queue
+   * @param item
+   * @return FALSE if queue is full
+   */
+  bool push(const T & item)
+  {
+    Cell *cell;
+    std::size_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+
+    while (true)
+    {
+      cell = &_buffer[pos & _mask];
+      std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+      if (diff == 0)
+      {
+        if (_enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0)
+      {
+        return (false);
+      }
+      else
+      {
+        pos = _enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+
+    cell->data = item;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return (true);
+  }
+
+  /**
+   * Remove item from queue
+   * @param item
+   * @return FALSE if queue is empty
+   */
+  bool pop(T & item)
+  {
+    Cell *cell;
+    std::size_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+
+    while (true)
+    {
+      cell = &_buffer[pos & _mask];
+      std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+
+      if (diff == 0)
+      {
+        if (_dequeue_pos.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0)
+      {
+        return (false);
+      }
+      else
+      {
+        pos = _dequeue_pos.load(std::memory_order_relaxed);
+      }
+    }
+
+    item = cell->data;
+    cell->sequence.store(pos + _mask + 1, std::memory_order_release);
+    return (true);
+  }
+
+private:
+  BoundedQueue(const BoundedQueue & o);
+  BoundedQueue & operator=(const BoundedQueue & o);
+
+  static std::size_t checkCapacity(std::size_t capacity)
+  {
+    if (capacity < 2 || (capacity & (capacity - 1)) != 0)
+      throw std::invalid_argument("Capacity of queue must be power of 2");
+    return (capacity);
+  }
+
+  struct Cell
+  {
+    std::atomic<std::size_t> sequence;
+    T data;
+  };
+
+  // Positions are on separate cache lines to avoid false sharing
+  static const std::size_t CACHE_LINE_SIZE = 64;
+
+  Cell * const _buffer;
+  const std::size_t _mask;
+  char _pad0[CACHE_LINE_SIZE];
+  std::atomic<std::size_t> _enqueue_pos;
+  char _pad1[CACHE_LINE_SIZE];
+  std::atomic<std::size_t> _dequeue_pos;
+  char _pad2[CACHE_LINE_SIZE];
+};
+
+#endif /* BOUNDEDQUEUE_H_ */
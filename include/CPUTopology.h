@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CPUTOPOLOGY_H_
+#define CPUTOPOLOGY_H_
+
+#include <vector>
+#include <string>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+/**
+ * Logical CPUs of the process grouped by physical cores and NUMA nodes.
+ * Topology is read from sysfs on Linux, elsewhere every CPU is its own core
+ * on single node and threads can't be pinned.
+ */
+class CPUTopology
+{
+public:
+  struct CPU
+  {
+    // Index of logical CPU in the system
+    unsigned id;
+    // Index of physical core (0 .. number of cores - 1)
+    unsigned core;
+    // NUMA node of the CPU
+    unsigned node;
+    // FALSE for the first thread of core, TRUE for its SMT siblings
+    bool sibling;
+  };
+
+  CPUTopology();
+
+  /**
+   * Logical CPUs in order of placement: first threads of all cores
+   * alternating between nodes, then their SMT siblings
+   * @return
+   */
+  const std::vector<CPU> & getCPUs() const;
+
+  /**
+   * @return Number of physical cores
+   */
+  unsigned getNumCores() const;
+
+  /**
+   * @return Number of NUMA nodes
+   */
+  unsigned getNumNodes() const;
+
+  /**
+   * Pin calling thread to logical CPU
+   * @param cpu Index of logical CPU in the system
+   * @return FALSE if thread can't be pinned
+   */
+  static bool pinThread(unsigned cpu);
+
+  /**
+   * Let calling thread run on all CPUs of the process again
+   * @return FALSE if affinity can't be set
+   */
+  bool unpinThread() const;
+
+private:
+  /**
+   * Read the first number from file
+   * @return Number or fallback if file can't be read
+   */
+  static int readNumber(const std::string & path, int fallback);
+
+  /**
+   * NUMA node of logical CPU (nodeN entry of its sysfs directory)
+   */
+  static unsigned readNode(unsigned cpu);
+
+  /**
+   * Every CPU is its own core on single node
+   */
+  void loadFlat();
+
+  /**
+   * Order CPUs for placement
+   */
+  void sortCPUs();
+
+  std::vector<CPU> _cpus;
+  unsigned _num_cores;
+  unsigned _num_nodes;
+
+#ifdef __linux__
+  cpu_set_t _allowed;
+#endif
+};
+
+#endif /* CPUTOPOLOGY_H_ */
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef CANDIDATEBUFFER_H_
+#define CANDIDATEBUFFER_H_
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Layout of password buffers shared by host and OpenCL kernels.
+ *
+ * Buffer is an array of 32-bit words transposed by passwords: the first row
+ * holds lengths, row k + 1 holds word k (bytes 4k..4k+3) of all passwords,
+ * so work items of a kernel load consecutive words. Stride of rows is the
+ * number of passwords the buffer is allocated for. Last word of password is
+ * padded by zeros, words after it aren't written.
+ *
+ * Kernels use the same layout through load_candidate() and store_candidate()
+ * in kernels/candidate.cl.
+ */
+class CandidateBuffer
+{
+public:
+  /**
+   * Number of words of the longest password
+   * @param max_length Maximum length of password
+   * @return
+   */
+  static uint32_t words(uint32_t max_length);
+
+  /**
+   * Size of buffer in bytes
+   * @param count Number of passwords (stride)
+   * @param max_length Maximum length of password
+   * @return
+   */
+  static std::size_t size(uint32_t count, uint32_t max_length);
+
+  /**
+   * Store password into buffer
+   * @param buffer
+   * @param stride Number of passwords the buffer is allocated for
+   * @param index Index of password
+   * @param password
+   * @param length
+   */
+  static void store(char *buffer, uint32_t stride, uint32_t index,
+                    const char *password, uint32_t length);
+
+  /**
+   * Load password from buffer
+   * @param buffer
+   * @param stride Number of passwords the buffer is allocated for
+   * @param index Index of password
+   * @return
+   */
+  static std::string load(const char *buffer, uint32_t stride,
+                          uint32_t index);
+};
+
+#endif /* CANDIDATEBUFFER_H_ */
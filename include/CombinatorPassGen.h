@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef COMBINATORPASSGEN_H_
+#define COMBINATORPASSGEN_H_
+
+#include "IndexPassGen.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/**
+ * Combinator generator concatenates every word of left dictionary with every
+ * word of right dictionary. Pairs are addressed by single 64-bit index
+ * (index = left * number_of_right_words + right).
+ */
+class CombinatorPassGen : public IndexPassGen
+{
+public:
+  struct Options
+  {
+    std::string left_dictionary;
+    std::string right_dictionary;
+  };
+
+  /**
+   * Constructor for factory object. This object only loads dictionaries and
+   * creates instances of generators
+   * @param options Command-line options
+   * @param cpu_mode If TRUE run generator on CPU instead GPU
+   */
+  CombinatorPassGen (Options & options, bool cpu_mode = false);
+  virtual ~CombinatorPassGen ();
+
+  /**
+   * Get path to kernel's source code and name of kernel's function
+   * @return Pointer to object with these informations
+   */
+  virtual KernelCode * getKernelCode();
+
+  /**
+   * Set global work-size
+   * @param gws
+   */
+  virtual void setKernelGWS(uint64_t gws);
+
+  /**
+   * Initialize OpenCL buffers (right dictionary is copied to device)
+   * @param kernel OpenCL kernel
+   * @param que OpenCL command-queue
+   * @param context OpenCL context
+   */
+  virtual void initKernel(cl::Kernel *kernel, cl::CommandQueue *que, cl::Context *context);
+
+  /**
+   * Initialize kernel's arguments for next step
+   * (increments indexes, makes reservation)
+   * @return FALSE if all passwords have already been generated
+   */
+  virtual bool nextKernelStep();
+
+  /**
+   * Test if this is only factory for password generator and not generator itself.
+   * @return TRUE if it's factory object, FALSE otherwise
+   */
+  virtual bool isFactory();
+
+  /**
+   * Create new instance of the generator
+   * @return
+   */
+  virtual PassGen *createGenerator();
+
+  /**
+   * Save the lowest pair index which is being processed
+   * @param filename
+   */
+  virtual void saveState(std::string filename);
+
+  /**
+   * Load and restore saved state of the generator
+   * @param filename
+   */
+  virtual void loadState(std::string filename);
+
+  /**
+   * Get maximum length of password
+   * @return
+   */
+  virtual uint8_t maxPassLen();
+
+  /**
+   * Get next password
+   * @param pass Pointer to array to store the password
+   * @param len Length of returned password
+   * @return FALSE if all passwords have been generated
+   */
+  virtual bool getPassword(char* pass, uint32_t *len);
+
+  /**
+   * Maximal length of dictionary word (longer words are truncated)
+   */
+  static const unsigned MAX_WORD_LENGTH = 20;
+private:
+
+  /**
+   * Construct new instance of generator from factory object
+   */
+  CombinatorPassGen (const CombinatorPassGen & o);
+
+  /**
+   * Size of word's entry ([length][word])
+   */
+  static const unsigned WORD_ENTRY_SIZE = MAX_WORD_LENGTH + 1;
+  /**
+   * Maximal number of left words covered by one reservation
+   */
+  static const unsigned MAX_LEFT_WORDS = 65536;
+  /**
+   * Path to kernel's source
+   */
+  const std::string _kernel_source = "kernels/combinator_passgen.cl";
+  /**
+   * Name of kernel's function
+   */
+  const std::string _kernel_name = "combinator_passgen";
+  /**
+   * ID of factory object (generators have ID from 1 to number of generators)
+   */
+  const int FACTORY_INSTANCE_ID = -1;
+
+  /**
+   * Load words of dictionary into array of entries
+   * @param filename
+   * @param words
+   * @return number of loaded words
+   */
+  static cl_ulong loadDictionary(const std::string & filename,
+                                 std::vector<cl_uchar> & words);
+
+  /**
+   * Reserve new set of indexes and upload its left words to device
+   * @return TRUE if successful, FALSE otherwise
+   */
+  virtual bool reservePasswords();
+
+  /**
+   * Limit reservation, so its left words fit into device's buffer
+   * @param start
+   * @param stop
+   * @return
+   */
+  virtual cl_ulong limitReservation(cl_ulong start, cl_ulong stop);
+
+  static bool _cpu_mode;
+
+  static KernelCode _gpu_code;
+  static std::vector<cl_uchar> _left_words;
+  static std::vector<cl_uchar> _right_words;
+  static cl_ulong _left_count;
+  static cl_ulong _right_count;
+
+  static int _num_instances;
+
+  // First left word uploaded to device
+  cl_ulong _left_base = 0;
+
+  int _instance_id;
+  std::vector<CombinatorPassGen *> _instances;
+
+  cl::Kernel _kernel;
+  cl::CommandQueue _que;
+  cl::Buffer _left_words_buffer;
+  cl::Buffer _right_words_buffer;
+};
+
+#endif /* COMBINATORPASSGEN_H_ */
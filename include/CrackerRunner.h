@@ -30,6 +30,9 @@
 #include "Cracker.h"
 #include "FileFormat.h"
 #include "GPUCracker.h"
+#include "VerifierPool.h"
+#include "BatchPassGen.h"
+#include "CPUTopology.h"
 #include <vector>
 
 #ifdef __WIN32
@@ -43,6 +46,14 @@
  */
 class CrackerRunner {
 public:
+    /**
+     * Number of CPU crackers relative to SMT threads of cores
+     */
+    enum SMTMode {
+        SMT_THREADS,    // one cracker per logical CPU
+        SMT_CORES,      // one cracker per physical core
+        SMT_AUTO        // one of above, chosen by calibration of crackers
+    };
     CrackerRunner();
     CrackerRunner(const CrackerRunner& orig);
     virtual ~CrackerRunner();
@@ -51,11 +62,46 @@ public:
      * @param c
      */
     void setCrackerFactory(CrackerFactory* c);
+    /**
+     * Sets factory of CPU crackers which run next to GPU crackers, NULL means
+     * only crackers of main factory are spawned
+     * @param c
+     */
+    void setCPUCrackerFactory(CrackerFactory* c);
     /**
      * Explicitly sets number of threads, 0 means spawn number of threads equal to cpu count
+     * (with GPU crackers it's number of CPU crackers, 0 means CPUs not feeding GPUs)
      * @param threads number of threads to spawn
      */
     void setNumThreads(uint32_t threads);
+    /**
+     * Explicitly sets number of host threads generating passwords for GPU crackers,
+     * 0 means number of CPUs not used by crackers (at least one)
+     * @param producers number of producer threads
+     */
+    void setNumProducers(uint32_t producers);
+    /**
+     * Pin CPU crackers to logical CPUs, first threads of cores are used first
+     * @param pin
+     */
+    void setPinThreads(bool pin);
+    /**
+     * Sets number of CPU crackers relative to SMT threads (when number of threads isn't set explicitly)
+     * @param mode
+     */
+    void setSMTMode(SMTMode mode);
+    /**
+     * Create CPU crackers and their generators on NUMA nodes they run on, so read-only
+     * target data and generator tables are replicated per node (pins threads)
+     * @param replicate
+     */
+    void setReplicateData(bool replicate);
+    /**
+     * Explicitly sets number of host threads verifying passwords found by GPU crackers,
+     * 0 means one thread per mapped device
+     * @param verifiers number of verifier threads
+     */
+    void setNumVerifiers(uint32_t verifiers);
     /**
      * Map threads to OpenCL devices. First device in vector goes to the firts thread.
      * @param confs Devices to map
@@ -129,6 +175,27 @@ private:
      * @return nothing 
      */
     static void* start_thread(void *arg);
+    /**
+     * Entry point for thread of SMT calibration
+     * @param arg initialised BenchmarkArg
+     * @return nothing
+     */
+    static void* benchmark_thread(void *arg);
+    /**
+     * Run created CPU crackers on first threads of cores and then on all threads
+     * @return true if SMT siblings increase total speed
+     */
+    bool calibrateSMT();
+    /**
+     * Check passwords by created CPU crackers for CALIBRATION_TIME
+     * @param siblings run also crackers placed on SMT siblings
+     * @return number of checked passwords
+     */
+    uint64_t benchmarkCrackers(bool siblings);
+    /**
+     * Milliseconds of each calibration run
+     */
+    static const uint32_t CALIBRATION_TIME = 500;
     /**
      * Get devices currently mapped 
      * @return 
@@ -139,7 +206,11 @@ private:
      */
     CrackerFactory *factory;
     /**
-     * Returns number of processors in system
+     * Factory for creating CPU crackers running next to GPU crackers (NULL if not used)
+     */
+    CrackerFactory *cpuFactory;
+    /**
+     * Returns number of processors available to the process (cores in SMT_CORES mode)
      * @return number of CPUs
      */
     uint32_t getCPUCount();
@@ -147,6 +218,42 @@ private:
      * Explicitly set number of threads
      */
     uint32_t explicitThreads;
+    /**
+     * Logical CPUs of the process
+     */
+    CPUTopology topology;
+    /**
+     * Flag set if CPU crackers are pinned to CPUs
+     */
+    bool pinThreads;
+    /**
+     * Number of CPU crackers relative to SMT threads
+     */
+    SMTMode smtMode;
+    /**
+     * Flag set if crackers and generators are created on their NUMA nodes
+     */
+    bool replicate;
+    /**
+     * Explicitly set number of producer threads
+     */
+    uint32_t explicitProducers;
+    /**
+     * Pool of host threads generating passwords for GPU crackers (NULL if not used)
+     */
+    ProducerPool *producerPool;
+    /**
+     * Explicitly set number of verifier threads
+     */
+    uint32_t explicitVerifiers;
+    /**
+     * Pool of host threads verifying passwords of GPU crackers (NULL if not used)
+     */
+    VerifierPool *verifierPool;
+    /**
+     * Generators of CPU crackers taking passwords from producer pool
+     */
+    std::vector<BatchPassGen*> batchPassGens;
     /**
      * Current number of threads
      */
@@ -159,6 +266,10 @@ private:
      * flag set if password found
      */
     bool pass_found;
+    /**
+     * flag set when crackers are stopped
+     */
+    bool stopping;
     /**
      * Argument struct for thread arg
      */
@@ -171,6 +282,19 @@ private:
          * Pointer to runner which spawns this cracker
          */
         CrackerRunner* runner;
+        /**
+         * CPU the thread is pinned to, -1 if it isn't pinned
+         */
+        int cpu;
+    };
+    /**
+     * Argument struct for calibration thread
+     */
+    struct BenchmarkArg{
+        Cracker* cracker;
+        int cpu;
+        volatile bool *stop;
+        uint64_t count;
     };
     
     /**
@@ -189,6 +313,10 @@ private:
      * Pointers to Spawned crackers
      */
     std::vector<Cracker*> crackers;
+    /**
+     * Index of CPU in topology for each cracker, -1 for GPU crackers
+     */
+    std::vector<int> placements;
     /**
      * Vector of current speeds
      */
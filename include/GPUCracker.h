@@ -25,12 +25,17 @@
 #define	GPUCRACKER_H
 
 #include "Cracker.h"
+#include "ProducerPool.h"
 #include <map>
+#include <set>
+#include <atomic>
 
 #define __CL_ENABLE_EXCEPTIONS
 #include <CL/cl.hpp>
 
-#define PASS_EXTRA_BYTES 1
+#define DEFAULT_GLOBAL_WORK_SIZE 65536
+
+class VerifierPool;
 
 struct PlatformDevices{
     cl::Platform platform;
@@ -40,13 +45,100 @@ struct PlatformDevices{
 struct DeviceConfig{
     uint32_t platform;
     uint32_t device;
+    /**
+     * 0 means global work size is loaded from tuning cache or found by autotune
+     */
     uint32_t globalWorkSize;
 };
 
+/**
+ * One stage of cracking pipeline. Every slot has its own buffers and command
+ * queue, so upload, kernel and readback of different slots can overlap.
+ */
+struct PipelineSlot{
+    /**
+     * Que for uploading passwords, cracking and reading results
+     */
+    cl::CommandQueue que;
+    /**
+     * Buffer for passwords
+     */
+    cl::Buffer passwordBuffer;
+    /**
+     * Buffer for number of found passwords (atomic counter of found queue)
+     */
+    cl::Buffer foundCountBuffer;
+    /**
+     * Buffer for queue of found passwords
+     */
+    cl::Buffer foundQueueBuffer;
+    /**
+     * Buffer for counter of passwords taken by persistent kernel
+     */
+    cl::Buffer workCounterBuffer;
+    /**
+     * Pinned host memory (CL_MEM_ALLOC_HOST_PTR) for passwords
+     */
+    cl::Buffer stagingBuffer;
+    /**
+     * Mapped pointer to stagingBuffer or to passwords of batch
+     */
+    char *passwords;
+    /**
+     * Batch from producer pool (NULL if passwords are generated by cracker)
+     */
+    PasswordBatch *batch;
+    /**
+     * Number of found passwords loaded from GPU
+     */
+    cl_uint foundCount;
+    /**
+     * Initial value of work counter uploaded before persistent kernel
+     */
+    cl_uint workCounter;
+    /**
+     * Event of generating passwords by passgen in GPU
+     */
+    cl::Event passwordsReady;
+    /**
+     * Event of reading number of found passwords
+     */
+    cl::Event resultsRead;
+    /**
+     * Event of first cracking kernel of slot (used for measuring kernel time)
+     */
+    cl::Event kernelDone;
+    /**
+     * Global index of first password of slot (generator fused into kernel)
+     */
+    uint64_t firstIndex;
+    /**
+     * Number of passwords in slot
+     */
+    uint32_t count;
+    /**
+     * Length of all passwords in slot, 0 if lengths are mixed
+     */
+    uint32_t length;
+    /**
+     * Number of cracked passwords (count rounded up to local size)
+     */
+    uint32_t workSize;
+    /**
+     * Work size of kernel measured by kernelDone
+     */
+    uint32_t chunkSize;
+    /**
+     * Flag set if slot is waiting for results
+     */
+    bool active;
+};
+
 /**
  * Base class for GPU (OpenCL) Cracking
  */
 class GPUCracker: public Cracker {
+    friend class VerifierPool;
 public:
     GPUCracker();
     GPUCracker(const GPUCracker& orig);
@@ -60,11 +152,79 @@ public:
      * Destroys all references to OpenCL data and structs
      */
     static void destroyOpenCL();
+    /**
+     * Returns configs of all GPUs and accelerators (all devices if there is none),
+     * work size of each device is tuned
+     * @return 
+     */
+    static std::vector<DeviceConfig> allDevices();
     /**
      * Sets device for this cracker
      * @param config
      */
     void setDevice(DeviceConfig &config);
+    /**
+     * Sets number of batches processed by device at once (default 3)
+     * @param depth
+     */
+    static void setPipelineDepth(uint32_t depth);
+    /**
+     * Sets time of one cracking kernel which work size is adjusted to (default 50 ms).
+     * 0 means whole slot is cracked by one kernel.
+     * @param ms
+     */
+    static void setTargetKernelTime(uint32_t ms);
+    /**
+     * Enables fusing of GPU passgen into cracking kernel (default true).
+     * Fused kernel creates passwords in private memory, so they aren't written
+     * into global memory and read back by cracking kernel.
+     * @param fuse
+     */
+    static void setFusedPassGen(bool fuse);
+    /**
+     * Enables kernels built for each password length (default true). They're
+     * used if passgen in GPU creates kernel steps of single length, so loops
+     * over password and padding of hashes are unrolled.
+     * @param enable
+     */
+    static void setLengthKernels(bool enable);
+    /**
+     * Enables persistent fused kernels (default false). Persistent kernel is
+     * launched once per slot with work size filling compute units, its work
+     * items take chunks of passwords from counter in device memory until
+     * window of slot is exhausted or they see stop flag. Window is sized to
+     * take at most about PERSISTENT_MAX_WINDOW_TIME. Only generators with
+     * fused code (Markov, mask) are persistent, brute-force generator
+     * advances state of previous passwords, so it isn't addressed by index.
+     * @param enable
+     */
+    static void setPersistentKernels(bool enable);
+    /**
+     * Sets maximum size of encrypted data, which is authenticated in GPU by
+     * formats supporting it (default 64 KiB). Positive passwords of larger
+     * data are authenticated by host.
+     * @param bytes
+     */
+    static void setDeviceVerifySize(uint32_t bytes);
+    /**
+     * Sets number of candidates cracked in vector lanes by one work item on
+     * CPU devices (default 8, 16 suits CPUs with 512-bit vectors). CPUs use
+     * scalar kernel if it's 0 or if format has no vector kernel.
+     * @param width 0, 8 or 16
+     */
+    static void setCPUVectorWidth(uint32_t width);
+    /**
+     * Sets pool of host threads, which generate passwords for this cracker.
+     * Used only if passgen isn't placed in GPU.
+     * @param pool
+     */
+    void setProducerPool(ProducerPool *pool);
+    /**
+     * Sets pool of host threads, which verify positive passwords of this cracker,
+     * so device doesn't wait for verification.
+     * @param pool
+     */
+    void setVerifierPool(VerifierPool *pool);
     virtual void run();
     
 protected:
@@ -76,14 +236,57 @@ protected:
     static std::vector<cl::Platform> platforms;
     
     /**
-     * Prepares passwords for update OpenCL device. Can be called while Kernel running.
+     * Prepares passwords of slot for update OpenCL device. Can be called while Kernel running.
+     * @param slot
+     */
+    virtual void preparePasswords(PipelineSlot &slot);
+    
+    /**
+     * Updates passwords of slot in OpenCL device (without waiting)
+     * @param slot
+     */
+    virtual void updatePasswords(PipelineSlot &slot);
+    
+    /**
+     * Prepares and updates passwords of slot, enqueues cracking kernel and
+     * reading of results
+     * @param slot
+     * @return false if there is no password for slot
+     */
+    virtual bool launchSlot(PipelineSlot &slot);
+    
+    /**
+     * Returns batch of processed slot back to producer pool
+     * @param slot
      */
-    virtual void preparePasswords();
+    void releasePasswords(PipelineSlot &slot);
     
     /**
-     * Updates passwords in OpenCL device
+     * Adjusts work size of cracking kernels by measured time of kernel of slot
+     * @param slot
      */
-    virtual void updatePasswords();
+    void updateWorkSize(PipelineSlot &slot);
+    
+    /**
+     * Verifies positive passwords or submits them to verifier pool
+     */
+    void verifyPositivePasswords();
+    /**
+     * Removes false positives from positivePasswords before they're verified
+     * by host. Cracker can check them by another kernel on device.
+     */
+    virtual void filterPositivePasswords();
+    
+    /**
+     * Checks completion queue of verifier pool and sets found password
+     */
+    void checkVerifiedPasswords();
+    /**
+     * Sets stop flag of running persistent kernels, so they can leave their
+     * windows early. It's only a hint, running kernel may not see the write
+     * (does nothing if flag is already set)
+     */
+    void stopPersistentKernels();
     
     /**
      * Initializes device and loads kernels.
@@ -91,12 +294,69 @@ protected:
      */
     virtual bool initDevice();
     
+    /**
+     * Sets global and local work size. They are loaded from tuning cache or found by autotune,
+     * if global work size isn't set by user.
+     */
+    virtual void tuneWorkSize();
+    
+    /**
+     * Sweeps local and global work size of cracking kernel using short timed runs
+     */
+    void autotune();
+    
+    /**
+     * Measures speed of cracking kernel with dummy passwords
+     * @param gws global work size
+     * @param lws local work size
+     * @param kernelTime time of one kernel run in seconds
+     * @return passwords per second (0 if work size isn't supported)
+     */
+    double benchmarkWorkSize(uint32_t gws, uint32_t lws, double *kernelTime);
+    
+    /**
+     * Returns maximum global work size, for which buffers of all slots fit into device memory
+     * @return 
+     */
+    uint32_t maxGlobalWorkSize();
+    
+    /**
+     * Returns key of device, kernel and passgen in tuning cache
+     * @return 
+     */
+    std::string tuningKey();
+    
     /**
      * Initializes data common for all crackers.
      * @return 
      */
     virtual bool initCommonData();
     
+    /**
+     * Waits for all slots and releases data common for all crackers.
+     */
+    virtual void destroyCommonData();
+    
+    /**
+     * Loads cracking kernel for each length of passgen's kernel steps
+     * @param headers Headers prepended to cracking kernel
+     */
+    void loadLengthKernels(const std::vector<std::string> &headers);
+    
+    /**
+     * Sets common arguments and cracker specific data of kernels built for
+     * each length (initData() is called for each of them)
+     * @return true if all data initialised successfully
+     */
+    bool initLengthKernels();
+    
+    /**
+     * Returns kernel which cracks the slot
+     * @param slot
+     * @return kernel built for length of slot or general kernel
+     */
+    cl::Kernel &slotKernel(PipelineSlot &slot);
+    
     /**
      * Pure virtual method for initialize cracker specific data.
      * @return true if all data initialised successfully
@@ -110,12 +370,21 @@ protected:
      * @return returns true if password is realy valid
      */
     virtual bool verifyPassword(std::string &pass);
+    /**
+     * Checks password with data derived for it by filterPositivePasswords().
+     * By default data is ignored and verifyPassword(pass) is called.
+     * @param pass password to check
+     * @param data data of password from positiveData (empty if there's none)
+     * @return returns true if password is realy valid
+     */
+    virtual bool verifyPassword(std::string &pass, const std::string &data);
     
     /**
-     * Checks if at least one kernel found matching password
+     * Waits for results of slot and checks if at least one kernel found matching password
+     * @param slot
      * @return true if password is found
      */
-    virtual bool passFound();
+    virtual bool passFound(PipelineSlot &slot);
     
     /**
      * Used for kernel debugging. If framework is compiled without NDEBUG, this is called after each kernel run (clFinsih).
@@ -125,21 +394,84 @@ protected:
     virtual void debugKernel(int clFinishRes);
     
     /**
-     * Loads all found passwords from OpenCL device into positivePasswords vector
+     * Loads all found passwords of slot from OpenCL device into positivePasswords vector
+     * @param slot
      */
-    virtual void loadPositvePasswords();
+    virtual void loadPositvePasswords(PipelineSlot &slot);
+    /**
+     * Loads all passwords of slot into positivePasswords, used if kernels
+     * found more passwords than found queue holds
+     * @param slot
+     */
+    void loadSlotPasswords(PipelineSlot &slot);
     
     /**
-     * Loads kernel form source or binary file if exists. 
-     * If binary version is out-of-date, compiles program from source and saves binary.
+     * Loads kernel from cached program binary if exists. Otherwise compiles program
+     * from (embedded) source and saves binary into cache. Cache is keyed by hash of
+     * source, build options, device name and driver version. Program for the same
+     * key is built only once, other threads wait for its binary.
      * 
      * @param filename source code filename
      * @param kernelName name of kernel function
      * @param kernel loaded kernel
      * @param program loaded program
+     * @param options build options (-D definitions)
+     * @param headers source code filenames prepended to source in given order
      * @return true if kernel was loaded succesully
      */
-    virtual bool loadKernel(std::string& filename, std::string& kernelName, cl::Kernel *kernel, cl::Program *program);
+    virtual bool loadKernel(std::string& filename, std::string& kernelName, cl::Kernel *kernel, cl::Program *program, const std::string &options = "", const std::vector<std::string> &headers = std::vector<std::string>());
+    
+    /**
+     * Returns build options of cracking kernel. Modules override this to pass
+     * constants of cracked file (salts, lengths, counts) as -D definitions,
+     * so kernel is specialized for one job. Base options define MAX_PASS_LEN.
+     * @return 
+     */
+    virtual std::string kernelBuildOptions();
+    /**
+     * Kernel library placed before source of cracking kernel (empty if
+     * kernel doesn't use any), e.g. kernels/rc4.cl
+     */
+    std::string kernelLibrary;
+    /**
+     * Returns build options of cracking kernel with fused passgen (kernel
+     * options and PERSISTENT if persistent kernels are enabled)
+     * @return 
+     */
+    std::string fusedBuildOptions();
+    /**
+     * Returns build options of cracking kernel reading passwords from buffer
+     * (kernel options and VECTOR_WIDTH if vector kernel is used)
+     * @return 
+     */
+    std::string crackBuildOptions();
+    
+    /**
+     * Formats bytes as build option defining array initializer, e.g. -DNAME={0x01,0x02}
+     * @param name name of macro
+     * @param bytes
+     * @param len
+     * @return 
+     */
+    static std::string defineBytes(const char *name, const uint8_t *bytes, uint32_t len);
+    
+    /**
+     * Formats bytes as build option defining initializer of big endian words,
+     * e.g. -DNAME={0x01020304u}
+     * @param name name of macro
+     * @param bytes
+     * @param len multiple of 4
+     * @return 
+     */
+    static std::string defineWords(const char *name, const uint8_t *bytes, uint32_t len);
+    
+    /**
+     * Builds program for device and prints build log on failure
+     * @param program
+     * @param options build options
+     * @return true if program was built succesfully
+     */
+    bool buildProgram(cl::Program *program, const std::string &options);
     
     /**
      * Maximum length of password. Used to allocate mem in GPU
@@ -149,6 +481,47 @@ protected:
      * Flag set if passgen is placed in GPU
      */
     bool GPUPassGen;
+    /**
+     * Flag set if passgen is fused into cracking kernel
+     */
+    bool fusedPassGen;
+    /**
+     * Flag set if fused kernel is persistent
+     */
+    bool persistentKernel;
+    /**
+     * Number of lanes of vector kernel, 0 if kernel is scalar
+     */
+    uint32_t vectorWidth;
+    /**
+     * Index of first kernel param of persistent kernel (work counter, stop
+     * flag and size of window)
+     */
+    uint8_t persistentArgIndex;
+    /**
+     * Index of first kernel param of fused passgen (it follows common params)
+     */
+    uint8_t passgenArgIndex;
+    /**
+     * Work size of persistent kernel
+     */
+    uint32_t persistentWorkSize;
+    /**
+     * Maximum number of passwords cracked by one launch of persistent kernel
+     */
+    uint32_t maxWindowSize;
+    /**
+     * Size of window of next persistent kernel, adjusted by measured time
+     */
+    uint32_t windowSize;
+    /**
+     * Flag telling persistent kernels to stop taking new passwords
+     */
+    cl::Buffer stopFlagBuffer;
+    /**
+     * Value of stop flag uploaded to stopFlagBuffer
+     */
+    cl_uint stopFlag;
     /**
      * Flag set if initial passgen seed has been completed
      */
@@ -175,6 +548,11 @@ protected:
      * Name of kernel function
      */
     std::string kernelName;
+    /**
+     * Name of kernel function cracking candidates in vector lanes, used
+     * instead of kernelName on CPU devices (empty if format has none)
+     */
+    std::string vectorKernelName;
     
     /**
      * OpenCL Context
@@ -185,7 +563,7 @@ protected:
      */
     cl::Device device;
     /**
-     * Que for sending commands
+     * Que for sending commands (initialization and passgen in GPU)
      */
     cl::CommandQueue que;
     
@@ -206,19 +584,45 @@ protected:
      * Passgen kernel
      */
     cl::Kernel passgenKernel;
+    /**
+     * Programs of cracking kernels built for single password length
+     */
+    std::vector<cl::Program> lengthPrograms;
+    /**
+     * Cracking kernels built for single password length
+     */
+    std::map<uint32_t, cl::Kernel> lengthKernels;
     
     /**
-     * Buffer for passwords
+     * Slots of pipeline
      */
-    cl::Buffer passwordBuffer;
+    std::vector<PipelineSlot> slots;
+    
+    /**
+     * Pool of host password producers (NULL if not used)
+     */
+    ProducerPool *producerPool;
+    /**
+     * Handle of this cracker in producer pool
+     */
+    ProducerPool::Consumer *consumer;
     /**
-     * Buffer for global found flag
+     * Pinned host memory for batches of producer pool
      */
-    cl::Buffer foundFlagBuffer;
+    std::vector<cl::Buffer> batchBuffers;
     /**
-     * Buffer for found bitfield
+     * Batches of producer pool mapped to batchBuffers
      */
-    cl::Buffer foundBitmapBuffer;
+    std::vector<PasswordBatch> batches;
+    
+    /**
+     * Pool of host password verifiers (NULL if not used)
+     */
+    VerifierPool *verifierPool;
+    /**
+     * Number of passwords submitted to verifier pool, which haven't been verified yet
+     */
+    std::atomic<uint32_t> pendingVerifications;
     
     /**
      * GWS
@@ -230,15 +634,39 @@ protected:
      * @see initData
      */
     cl::NDRange localSize;
+    /**
+     * Local work size used for localSize
+     */
+    uint32_t localWorkSize;
+    /**
+     * Number of candidates cracked by one work item of kernel built with
+     * ITEM_CANDIDATES (can be set by cracker)
+     */
+    uint32_t itemCandidates;
+    /**
+     * Work size of one cracking kernel, slot is cracked by several kernels.
+     * Buffers are allocated for deviceConfig.globalWorkSize.
+     */
+    uint32_t activeWorkSize;
     
     /**
-     * Pointer to array of password to be sent to GPU
+     * Entries of found queue loaded from GPU
+     */
+    std::vector<cl_uint> foundEntries;
+    /**
+     * Size of entry of found queue in words (index of work item, or index,
+     * length and words of password if passwords are read from buffer)
+     */
+    uint32_t foundEntryWords;
+    /**
+     * Capacity of found queue in entries, it's the maximum number of candidates
+     * cracked by one launch of slot (stride of password buffer of fused kernel)
      */
-    char *passwdsToGPU;
+    uint32_t foundCapacity;
     /**
-     * Pointer to passwords loaded from GPU
+     * Flag set if overflow of found queue has been reported
      */
-    char *passwdsFromGPU;
+    bool foundOverflowReported;
     /**
      * flag set if passgen was exhausted
      */
@@ -248,19 +676,27 @@ protected:
      */
     uint8_t userParamIndex;
     /**
-     * Global found flag loaded from GPU
+     * Vector of positive passwords loaded from GPU based on found queue
+     * @see foundEntries
+     */
+    std::vector<std::string> positivePasswords;
+    /**
+     * Data derived for positive passwords by filterPositivePasswords() (same
+     * index as in positivePasswords), it goes with password to verifier
      */
-    char foundFlag;
+    std::vector<std::string> positiveData;
     /**
-     * Bitfield found flag from GPU
+     * Maximum size of data authenticated in GPU
      */
-    uint32_t* foundBitmap;
-    
+    static uint32_t deviceVerifySize;
     /**
-     * Vector of positive passwords loaded from GPU based on found bitfield
-     * @see foundBitmap
+     * Header of cracking kernels reading passwords from buffer
      */
-    std::vector<std::string> positivePasswords;
+    static const char *CANDIDATE_HEADER;
+    /**
+     * Header of cracking kernels with fused passgen, it precedes header of passgen
+     */
+    static const char *FUSED_HEADER;
     
 private:
     /**
@@ -273,6 +709,121 @@ private:
      * @see initOpenCL
      */
     static bool init_done;
+    /**
+     * Mutex for initOpenCL (crackers are initialized in their threads)
+     */
+    static pthread_mutex_t initMutex;
+    
+    /**
+     * Reads program binary from cache file and validates it
+     * @param filename
+     * @param key hash of program
+     * @return binary or empty string if file is missing or invalid
+     */
+    static std::string readProgramBinary(const std::string &filename, uint64_t key);
+    /**
+     * Writes program binary into cache file
+     * @param filename
+     * @param key hash of program
+     * @param binary
+     */
+    static void writeProgramBinary(const std::string &filename, uint64_t key, const std::string &binary);
+    /**
+     * Binaries of programs built by this process
+     */
+    static std::map<uint64_t, std::string> programBinaries;
+    /**
+     * Keys of programs being built
+     */
+    static std::set<uint64_t> programsBuilding;
+    static pthread_mutex_t programMutex;
+    /**
+     * Signaled when some program is built
+     */
+    static pthread_cond_t programBuilt;
+    static const uint32_t PROGRAM_CACHE_MAGIC = 0x4e425257;   // "WRBN"
+    /**
+     * Number of slots in pipeline
+     */
+    static uint32_t pipelineDepth;
+    /**
+     * Number of producer pool batches per slot
+     */
+    static const uint32_t BATCHES_PER_SLOT = 2;
+    /**
+     * Target time of one cracking kernel in milliseconds
+     */
+    static uint32_t targetKernelTime;
+    /**
+     * Flag set if GPU passgen is fused into cracking kernel when it's supported
+     */
+    static bool fusePassGen;
+    /**
+     * Flag set if cracking kernel is built for each password length
+     */
+    static bool buildLengthKernels;
+    /**
+     * Flag set if fused kernels are persistent
+     */
+    static bool persistentKernels;
+    /**
+     * Number of lanes of vector kernels on CPU devices, 0 disables them
+     */
+    static uint32_t cpuVectorWidth;
+    /**
+     * Window of persistent kernel in multiples of global work size
+     */
+    static const uint32_t PERSISTENT_WINDOW_STEPS = 16;
+    /**
+     * Number of work groups of persistent kernel per compute unit
+     */
+    static const uint32_t PERSISTENT_GROUPS_PER_UNIT = 4;
+    /**
+     * Time limit of persistent kernel in seconds, it bounds stop latency
+     */
+    static constexpr double PERSISTENT_MAX_WINDOW_TIME = 0.2;
+    /**
+     * Maximum number of kernels built for single password length
+     */
+    static const uint32_t MAX_LENGTH_KERNELS = 16;
+    
+    /**
+     * Loads work size from tuning cache
+     * @param key
+     * @param gws
+     * @param lws
+     * @return false if there is no entry for key
+     */
+    static bool loadTuning(const std::string &key, uint32_t *gws, uint32_t *lws);
+    /**
+     * Stores work size into tuning cache
+     * @param key
+     * @param gws
+     * @param lws
+     */
+    static void saveTuning(const std::string &key, uint32_t gws, uint32_t lws);
+    /**
+     * Mutex for tuning cache file
+     */
+    static pthread_mutex_t tuningMutex;
+    static const char *TUNING_CACHE_FILE;
+    static const uint32_t TUNING_RUNS = 3;
+    static const uint32_t TUNING_PASS_LENGTH = 8;
+    static const uint32_t TUNING_MAX_LOCAL_SIZE = 256;
+    static const uint32_t TUNING_MAX_GLOBAL_SIZE = 1 << 24;
+    static const uint32_t TUNING_GROUPS_PER_UNIT = 16;
+    /**
+     * Only a part of device memory is used for passwords
+     */
+    static const uint32_t TUNING_MEM_FRACTION = 4;
+    /**
+     * Longer kernels make cracker unresponsive (stop, display)
+     */
+    static constexpr double TUNING_MAX_KERNEL_TIME = 0.1;
+    /**
+     * Larger global work size is used only if it's faster at least by 5 %
+     */
+    static constexpr double TUNING_MIN_GAIN = 1.05;
     
 };
 
@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef HYBRIDPASSGEN_H_
+#define HYBRIDPASSGEN_H_
+
+#include "PassGen.h"
+#include "Mask.h"
+
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <cstdint>
+
+/**
+ * Hybrid generator combines every word of a dictionary with all
+ * passwords given by a mask (appended or prepended to the word)
+ */
+class HybridPassGen : public PassGen
+{
+public:
+  struct Options
+  {
+    std::string dictionary;
+    std::string mask;
+    bool prepend = false;
+  };
+
+  /**
+   * Constructor for factory object. This object only initializes memory and
+   * creates instances of generators
+   * @param options Command-line options
+   * @param cpu_mode If TRUE run generator on CPU instead GPU
+   */
+  HybridPassGen (Options & options, bool cpu_mode = false);
+  virtual ~HybridPassGen ();
+
+  /**
+   * Get path to kernel's source code and name of kernel's function
+   * @return Pointer to object with these informations
+   */
+  virtual KernelCode * getKernelCode();
+
+  /**
+   * Set global work-size
+   * @param gws
+   */
+  virtual void setKernelGWS(uint64_t gws);
+
+  /**
+   * Initialize OpenCL buffers
+   * @param kernel OpenCL kernel
+   * @param que OpenCL command-queue
+   * @param context OpenCL context
+   */
+  virtual void initKernel(cl::Kernel *kernel, cl::CommandQueue *que, cl::Context *context);
+
+  /**
+   * Initialize kernel's arguments for next step
+   * (increments index, uploads next batch of words)
+   * @return FALSE if all passwords have already been generated
+   */
+  virtual bool nextKernelStep();
+
+  /**
+   * Test if this is only factory for password generator and not generator itself.
+   * @return TRUE if it's factory object, FALSE otherwise
+   */
+  virtual bool isFactory();
+
+  /**
+   * Create new instance of the generator
+   * @return
+   */
+  virtual PassGen *createGenerator();
+
+  /**
+   * Save position in dictionary of the oldest batch which is being processed
+   * @param filename
+   */
+  virtual void saveState(std::string filename);
+
+  /**
+   * Load and restore saved state of the generator
+   * @param filename
+   */
+  virtual void loadState(std::string filename);
+
+  /**
+   * Get maximum length of password
+   * @return
+   */
+  virtual uint8_t maxPassLen();
+
+  /**
+   * Get next password
+   * @param pass Pointer to array to store the password
+   * @param len Length of returned password
+   * @return FALSE if all passwords have been generated
+   */
+  virtual bool getPassword(char* pass, uint32_t *len);
+
+  /**
+   * Maximal length of dictionary word (longer words are truncated)
+   */
+  static const unsigned MAX_WORD_LENGTH = 20;
+  /**
+   * Maximal number of metacharacters in mask
+   */
+  static const unsigned MAX_MASK_LENGTH = 16;
+private:
+
+  /**
+   * Construct new instance of generator from factory object
+   */
+  HybridPassGen (const HybridPassGen & o);
+
+  /**
+   * Size of word's entry in batch ([length][word])
+   */
+  static const unsigned WORD_ENTRY_SIZE = MAX_WORD_LENGTH + 1;
+  /**
+   * Maximal number of words in one batch
+   */
+  static const unsigned MAX_BATCH_WORDS = 65536;
+  /**
+   * Number of words in one batch when generator runs on CPU
+   */
+  static const unsigned CPU_BATCH_WORDS = 64;
+  /**
+   * Path to kernel's source
+   */
+  const std::string _kernel_source = "kernels/hybrid_passgen.cl";
+  /**
+   * Name of kernel's function
+   */
+  const std::string _kernel_name = "hybrid_passgen";
+  /**
+   * ID of factory object (generators have ID from 1 to number of generators)
+   */
+  const int FACTORY_INSTANCE_ID = -1;
+
+  /**
+   * Read next batch of words from shared dictionary
+   * @return FALSE if dictionary is exhausted
+   */
+  bool loadWords();
+
+  /**
+   * Put current word and first mask password into candidate buffer
+   */
+  void spliceWord();
+
+  static bool _cpu_mode;
+
+  static KernelCode _gpu_code;
+  static std::ifstream *_dictionary;
+  static pthread_mutex_t _dictionary_mutex;
+  static pthread_mutexattr_t _dictionary_mutex_attr;
+
+  static bool _prepend;
+  static cl_uint _mask_length;
+  static cl_uchar _charsets[MAX_MASK_LENGTH * ASCII_CHARSET_SIZE];
+  static cl_uint _charset_sizes[MAX_MASK_LENGTH];
+  static cl_ulong _keyspace;
+
+  static int _num_instances;
+
+  std::size_t _gws = 256;
+  unsigned _words_per_batch = CPU_BATCH_WORDS;
+
+  // Current batch of words
+  cl_uchar *_words = nullptr;
+  unsigned _num_words = 0;
+  uint64_t _batch_position = UINT64_MAX;
+
+  // Kernel's indexes into current batch
+  cl_ulong _index = 0;
+  cl_ulong _index_stop = 0;
+
+  // CPU generator's state
+  unsigned _word = 0;
+  cl_uint _odometer[MAX_MASK_LENGTH];
+  char _candidate[MAX_WORD_LENGTH + MAX_MASK_LENGTH];
+  uint32_t _candidate_length = 0;
+  unsigned _mask_offset = 0;
+
+  int _instance_id;
+  std::vector<HybridPassGen *> _instances;
+
+  cl::Kernel _kernel;
+  cl::CommandQueue _que;
+  cl::Buffer _words_buffer;
+  cl::Buffer _charsets_buffer;
+  cl::Buffer _charset_sizes_buffer;
+};
+
+#endif /* HYBRIDPASSGEN_H_ */
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef INDEXPASSGEN_H_
+#define INDEXPASSGEN_H_
+
+#include "PassGen.h"
+
+#include <string>
+#include <vector>
+#include <ctime>           // timespec
+#include <pthread.h>
+#include <cstdint>
+
+/**
+ * Base of generators addressing passwords by 64-bit index. Factory object
+ * owns range of indexes, which is shared by its instances. Every instance
+ * reserves consecutive indexes, size of reservation follows its speed.
+ */
+class IndexPassGen : public PassGen
+{
+public:
+  /**
+   * Constructor for factory object, which owns range of indexes
+   */
+  IndexPassGen ();
+  virtual ~IndexPassGen ();
+
+protected:
+
+  /**
+   * Construct new instance sharing range of indexes with factory object
+   */
+  IndexPassGen (const IndexPassGen & o);
+
+  /**
+   * Set range of indexes of all passwords
+   * @param start
+   * @param stop
+   */
+  void setRange(cl_ulong start, cl_ulong stop);
+
+  /**
+   * Get end of range of indexes
+   * @return
+   */
+  cl_ulong stopIndex();
+
+  /**
+   * Reserve new set of indexes (from _private_start_index
+   * to _private_stop_index)
+   * @return TRUE if successful, FALSE otherwise
+   */
+  virtual bool reservePasswords();
+
+  /**
+   * Shorten non-empty reservation, called while range is locked
+   * @param start First reserved index
+   * @param stop End of reservation
+   * @return New end of reservation (greater than start)
+   */
+  virtual cl_ulong limitReservation(cl_ulong start, cl_ulong stop);
+
+  /**
+   * Save the lowest index which is being processed by instances
+   * (only factory object saves it)
+   * @param filename
+   * @param id ID of generator
+   */
+  void saveIndex(std::string filename, char id);
+
+  /**
+   * Restore start of range from file saved by saveIndex
+   * @param filename
+   * @param id ID of generator
+   */
+  void loadIndex(std::string filename, char id);
+
+  cl_ulong _private_start_index = 1;
+  cl_ulong _private_stop_index = 0;
+  cl_ulong _min_reservation_size = 1024;
+  cl_ulong _reservation_size = 1024;
+  // Limit of reservation (0 means unlimited)
+  cl_ulong _max_reservation_size = 0;
+
+  std::size_t _gws = 256;
+
+private:
+
+  /**
+   * Range of indexes shared by factory object and its instances
+   */
+  struct Range
+  {
+    cl_ulong start_index = 0;
+    cl_ulong stop_index = 0;
+    pthread_mutex_t mutex;
+    std::vector<IndexPassGen *> generators;
+  };
+
+  Range *_range;
+  bool _range_owner;
+
+  // First index of current reservation (UINT64_MAX if there is none)
+  cl_ulong _reservation_start = UINT64_MAX;
+  struct timespec _speed_clock;
+};
+
+#endif /* INDEXPASSGEN_H_ */
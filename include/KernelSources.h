@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef KERNELSOURCES_H_
+#define KERNELSOURCES_H_
+
+#include <string>
+#include <cstddef>
+
+/**
+ * OpenCL kernel sources embedded into library at build time
+ * (generated by cmake/EmbedKernels.cmake)
+ */
+class KernelSources
+{
+public:
+  /**
+   * Get source code of kernel. Embedded source is preferred, the file is read
+   * only if kernel isn't embedded.
+   * @param filename Path of kernel (e.g. kernels/zip_pk_kernel.cl)
+   * @param source Source code of kernel
+   * @return FALSE if kernel doesn't exist
+   */
+  static bool get(const std::string & filename, std::string & source);
+
+private:
+  struct Entry
+  {
+    const char *name;
+    const char *source;
+    std::size_t length;
+  };
+
+  static const Entry _entries[];
+  static const std::size_t _num_entries;
+};
+
+#endif /* KERNELSOURCES_H_ */
@@ -24,7 +24,7 @@
 #ifndef MARKOVPASSGEN_H_
 #define MARKOVPASSGEN_H_
 
-#include "PassGen.h"
+#include "IndexPassGen.h"
 #include "Mask.h"
 
 #ifdef _WIN32
@@ -34,12 +34,10 @@
 #include <arpa/inet.h>     // ntohl, ntohs
 #endif
 #include <string>
-#include <ctime>           // timespec
-#include <pthread.h>
 #include <cstdlib>         // atoi, qsort
 #include <cstdint>
 
-class MarkovPassGen : public PassGen
+class MarkovPassGen : public IndexPassGen
 {
 public:
   struct Options
@@ -67,6 +65,13 @@ public:
    */
   virtual KernelCode * getKernelCode();
 
+  /**
+   * Get path to source code of device function creating password by index,
+   * which is fused into cracking kernel
+   * @return NULL in CPU mode
+   */
+  virtual KernelCode * getFusedCode();
+
   /**
    * Set global work-size
    * @param gws
@@ -81,6 +86,37 @@ public:
    */
   virtual void initKernel(cl::Kernel *kernel, cl::CommandQueue *que, cl::Context *context);
 
+  /**
+   * Initialize OpenCL buffers and arguments of generator fused into cracking kernel
+   * @param kernel Cracking kernel
+   * @param que OpenCL command-queue
+   * @param context OpenCL context
+   * @param argIndex Index of first argument of generator
+   * @return Number of arguments of generator
+   */
+  virtual uint32_t initFusedKernel(cl::Kernel *kernel, cl::CommandQueue *que,
+                                   cl::Context *context, uint32_t argIndex);
+
+  /**
+   * Get global index of first password of last kernel step
+   * @return
+   */
+  virtual uint64_t kernelStepIndex();
+
+  /**
+   * Get length of passwords of last kernel step
+   * @return
+   */
+  virtual uint32_t kernelStepLength();
+
+  /**
+   * Get range of lengths of kernel steps
+   * @param min
+   * @param max
+   * @return TRUE, reservations are split by length
+   */
+  virtual bool kernelStepLengths(uint32_t *min, uint32_t *max);
+
   /**
    * Initialize kernel's arguments for next step
    * (increments indexes, makes reservation)
@@ -88,6 +124,15 @@ public:
    */
   virtual bool nextKernelStep();
 
+  /**
+   * Make reservation of at most maxSize passwords and initialize kernel's
+   * arguments for it
+   * @param maxSize
+   * @param size Number of reserved passwords
+   * @return FALSE if all passwords have already been generated
+   */
+  virtual bool nextKernelWindow(uint64_t maxSize, uint64_t *size);
+
   /**
    * Test if this is only factory for password generator and not generator itself.
    * @return TRUE if it's factory object, FALSE otherwise
@@ -100,6 +145,12 @@ public:
    */
   virtual PassGen *createGenerator();
 
+  /**
+   * Use copy of Markov table allocated on node (shared by its instances)
+   * @param node
+   */
+  virtual void replicateData(unsigned node);
+
   /**
    * Save current state (NOT IMPLEMENTED because validation of flags in cracker
    * is after incrementing index, i.e. saved index can be ahead)
@@ -121,11 +172,11 @@ public:
   virtual uint8_t maxPassLen();
 
   /**
-   * Get password by index (only for experiments)
+   * Get password by index (decodes passwords found by fused kernel)
    * @param index
    * @return
    */
-  std::string getPassword(uint64_t index);
+  virtual std::string getPassword(uint64_t index);
 
   /**
    * Get next password
@@ -170,6 +221,14 @@ private:
    * Name of kernel's function
    */
   const std::string _kernel_name = "markov_passgen";
+  /**
+   * Path to source of device function for fused kernels
+   */
+  const std::string _fused_source = "kernels/markov_candidate.cl";
+  /**
+   * Number of kernel's arguments of generator
+   */
+  static const uint32_t NUM_KERNEL_ARGS = 7;
   /**
    * ID of factory object (generators have ID from 1 to number of generators)
    */
@@ -182,10 +241,28 @@ private:
   void initMemory(std::string stat_file);
 
   /**
-   * Reserve new set of indexes
-   * @return TRUE if successful, FALSE otherwise
+   * Initialize OpenCL buffers and kernel's arguments
+   * @param kernel OpenCL kernel
+   * @param que OpenCL command-queue
+   * @param context OpenCL context
+   * @param argIndex Index of first argument of generator
+   */
+  void initArguments(cl::Kernel *kernel, cl::CommandQueue *que,
+                     cl::Context *context, uint32_t argIndex);
+
+  /**
+   * Set kernel's arguments from initialized buffers and current reservation
+   * @param kernel OpenCL kernel
+   */
+  void setArguments(cl::Kernel *kernel);
+
+  /**
+   * Limit reservation to passwords of single length
+   * @param start
+   * @param stop
+   * @return
    */
-  bool reservePasswords();
+  virtual cl_ulong limitReservation(cl_ulong start, cl_ulong stop);
 
   /**
    * Parse command line options
@@ -243,10 +320,13 @@ private:
   static bool _cpu_mode;
 
   static KernelCode _gpu_code;
+  static KernelCode _fused_code;
   static Mask _mask;
   static Model _model;
   static cl_uchar *_markov_table;
   static std::size_t _markov_table_size;
+  // Copies of Markov table on NUMA nodes
+  static std::vector<cl_uchar *> _node_tables;
   static cl_ulong *_permutations;
   static cl_uint _min_length;
   static cl_uint _max_length;
@@ -254,25 +334,18 @@ private:
   static cl_uint _max_threshold;
 
   static int _num_instances;
-  static cl_ulong _shared_start_index;
-  static cl_ulong _shared_stop_index;
-  static pthread_mutex_t _shared_index_mutex;
-  static pthread_mutexattr_t _shared_index_mutex_attr;
-
-  cl_ulong _private_start_index = 1;
-  cl_ulong _private_stop_index = 0;
-  unsigned _min_reservation_size;
-  unsigned _reservation_size;
-
-  std::size_t _gws = 256;
-  struct timespec _speed_clock;
   // Current length
   cl_uint _length = 1;
 
   int _instance_id;
+  // Markov table used by instance (copy on its node or the shared one)
+  cl_uchar *_table;
   std::vector<MarkovPassGen *> _instances;
 
-  cl::Kernel _kernel;
+  // Kernels with generator's arguments (cracking kernel can be built per length)
+  std::vector<cl::Kernel> _kernels;
+  // Index of first generator's argument (markov_table) in _kernels
+  uint32_t _arg_index = 2;
   cl::Buffer _markov_table_buffer;
   cl::Buffer _thresholds_buffer;
   cl::Buffer _permutations_buffer;
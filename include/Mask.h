@@ -40,6 +40,10 @@ struct MaskRange
 };
 
 const unsigned NUM_METACHARS = 7;
+/**
+ * Number of user-defined charsets (?1 - ?4)
+ */
+const unsigned NUM_CUSTOM_CHARSETS = 4;
 /**
  * Array of lambda functions with character ranges of metacharacters
  */
@@ -68,6 +72,14 @@ public:
    */
   MaskElement(const std::string & single_mask);
 
+  /**
+   * Construct object from user-defined charset, which can contain
+   * characters and metacharacters (e.g. "?l?d_")
+   * @param charset
+   * @return
+   */
+  static MaskElement FromCharset(const std::string & charset);
+
   /**
    * Test if given character satisfy the mask
    * @param character 8-bit character
@@ -80,6 +92,12 @@ public:
    * @return
    */
   std::size_t Count() const;
+
+  /**
+   * Get characters that satisfy mask in ascending order
+   * @return
+   */
+  std::vector<uint8_t> Chars() const;
 private:
   std::bitset<ASCII_CHARSET_SIZE> _charset_flags;
 };
@@ -91,10 +109,22 @@ class Mask
 {
 public:
   Mask();
-  Mask(const std::string &mask);
+  /**
+   * Parse mask
+   * @param mask String representation of mask
+   * @param custom_charsets User-defined charsets referenced by ?1 - ?4
+   */
+  Mask(const std::string &mask,
+       const std::vector<std::string> &custom_charsets = {});
   ~Mask();
 
   const MaskElement & operator[](std::size_t idx);
+
+  /**
+   * Get number of metacharacters in mask
+   * @return
+   */
+  std::size_t Size() const;
 private:
   /**
    * Each element corresponds to one metacharecter in mask
@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef MASKPASSGEN_H_
+#define MASKPASSGEN_H_
+
+#include "IndexPassGen.h"
+#include "Mask.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/**
+ * Mask generator creates all passwords satisfying one or more masks.
+ * Masks are processed in given order and every password is addressed by
+ * 64-bit index (index of first password of mask + index inside mask).
+ * The last position of mask changes most frequently.
+ */
+class MaskPassGen : public IndexPassGen
+{
+public:
+  struct Options
+  {
+    /**
+     * Mask or path to file with masks (hashcat's .hcmask format)
+     */
+    std::string mask;
+    /**
+     * User-defined charsets ?1 - ?4
+     */
+    std::vector<std::string> custom_charsets =
+        std::vector<std::string>(NUM_CUSTOM_CHARSETS);
+  };
+
+  /**
+   * Constructor for factory object. This object only initializes memory and
+   * creates instances of generators
+   * @param options Command-line options
+   * @param cpu_mode If TRUE run generator on CPU instead GPU
+   */
+  MaskPassGen (Options & options, bool cpu_mode = false);
+  virtual ~MaskPassGen ();
+
+  /**
+   * Get path to kernel's source code and name of kernel's function
+   * @return Pointer to object with these informations
+   */
+  virtual KernelCode * getKernelCode();
+
+  /**
+   * Get path to source code of device function creating password by index,
+   * which is fused into cracking kernel
+   * @return NULL in CPU mode
+   */
+  virtual KernelCode * getFusedCode();
+
+  /**
+   * Set global work-size
+   * @param gws
+   */
+  virtual void setKernelGWS(uint64_t gws);
+
+  /**
+   * Initialize OpenCL buffers (charsets of all masks)
+   * @param kernel OpenCL kernel
+   * @param que OpenCL command-queue
+   * @param context OpenCL context
+   */
+  virtual void initKernel(cl::Kernel *kernel, cl::CommandQueue *que, cl::Context *context);
+
+  /**
+   * Initialize OpenCL buffers and arguments of generator fused into cracking kernel
+   * @param kernel Cracking kernel
+   * @param que OpenCL command-queue
+   * @param context OpenCL context
+   * @param argIndex Index of first argument of generator
+   * @return Number of arguments of generator
+   */
+  virtual uint32_t initFusedKernel(cl::Kernel *kernel, cl::CommandQueue *que,
+                                   cl::Context *context, uint32_t argIndex);
+
+  /**
+   * Get global index of first password of last kernel step
+   * @return
+   */
+  virtual uint64_t kernelStepIndex();
+
+  /**
+   * Initialize kernel's arguments for next step
+   * (increments indexes, makes reservation)
+   * @return FALSE if all passwords have already been generated
+   */
+  virtual bool nextKernelStep();
+
+  /**
+   * Make reservation of at most maxSize passwords and initialize kernel's
+   * arguments for it
+   * @param maxSize
+   * @param size Number of reserved passwords
+   * @return FALSE if all passwords have already been generated
+   */
+  virtual bool nextKernelWindow(uint64_t maxSize, uint64_t *size);
+
+  /**
+   * Test if this is only factory for password generator and not generator itself.
+   * @return TRUE if it's factory object, FALSE otherwise
+   */
+  virtual bool isFactory();
+
+  /**
+   * Create new instance of the generator
+   * @return
+   */
+  virtual PassGen *createGenerator();
+
+  /**
+   * Save the lowest index which is being processed
+   * @param filename
+   */
+  virtual void saveState(std::string filename);
+
+  /**
+   * Load and restore saved state of the generator
+   * @param filename
+   */
+  virtual void loadState(std::string filename);
+
+  /**
+   * Get maximum length of password
+   * @return
+   */
+  virtual uint8_t maxPassLen();
+
+  /**
+   * Get password by index (decodes passwords found by fused kernel)
+   * @param index
+   * @return
+   */
+  virtual std::string getPassword(uint64_t index);
+
+  /**
+   * Get next password
+   * @param pass Pointer to array to store the password
+   * @param len Length of returned password
+   * @return FALSE if all passwords have been generated
+   */
+  virtual bool getPassword(char* pass, uint32_t *len);
+private:
+
+  /**
+   * Construct new instance of generator from factory object
+   */
+  MaskPassGen (const MaskPassGen & o);
+
+  /**
+   * Path to kernel's source
+   */
+  const std::string _kernel_source = "kernels/mask_passgen.cl";
+  /**
+   * Name of kernel's function
+   */
+  const std::string _kernel_name = "mask_passgen";
+  /**
+   * Path to source of device function for fused kernels
+   */
+  const std::string _fused_source = "kernels/mask_candidate.cl";
+  /**
+   * Number of kernel's arguments of generator
+   */
+  static const uint32_t NUM_KERNEL_ARGS = 8;
+  /**
+   * ID of factory object (generators have ID from 1 to number of generators)
+   */
+  const int FACTORY_INSTANCE_ID = -1;
+
+  /**
+   * Parse line of .hcmask file ([?1,][?2,][?3,][?4,]mask, "\," is comma)
+   * @param line
+   * @param custom_charsets Charsets from command line, overwritten by charsets
+   * from the line
+   */
+  void parseMaskLine(const std::string & line,
+                     std::vector<std::string> custom_charsets);
+
+  /**
+   * Append mask to table of masks
+   * @param mask
+   */
+  void addMask(Mask & mask);
+
+  /**
+   * Initialize OpenCL buffers and kernel's arguments
+   * @param kernel OpenCL kernel
+   * @param que OpenCL command-queue
+   * @param context OpenCL context
+   * @param argIndex Index of first argument of generator
+   */
+  void initArguments(cl::Kernel *kernel, cl::CommandQueue *que,
+                     cl::Context *context, uint32_t argIndex);
+
+  /**
+   * Set counter of CPU generator to given index
+   * @param index
+   */
+  void setCounter(uint64_t index);
+
+  static bool _cpu_mode;
+
+  static KernelCode _gpu_code;
+  static KernelCode _fused_code;
+  static cl_uint _max_length;
+
+  // Charsets of all positions of all masks
+  static std::vector<cl_uchar> _charsets;
+  static std::vector<cl_uint> _charset_sizes;
+  // First position and length of every mask
+  static std::vector<cl_uint> _mask_positions;
+  static std::vector<cl_uint> _mask_lengths;
+  // Index of first password of every mask (last item is total count)
+  static std::vector<cl_ulong> _mask_offsets;
+
+  static int _num_instances;
+
+  // CPU generator's state
+  std::size_t _mask = 0;
+  cl_uint _counter[MAX_PASS_LENGTH];
+  char _candidate[MAX_PASS_LENGTH];
+
+  int _instance_id;
+  std::vector<MaskPassGen *> _instances;
+
+  // Kernel with generator's arguments (generator's own or cracking kernel)
+  cl::Kernel _kernel;
+  // Index of first generator's argument (charsets) in _kernel
+  uint32_t _arg_index = 2;
+  cl::Buffer _charsets_buffer;
+  cl::Buffer _charset_sizes_buffer;
+  cl::Buffer _mask_positions_buffer;
+  cl::Buffer _mask_lengths_buffer;
+  cl::Buffer _mask_offsets_buffer;
+};
+
+#endif /* MASKPASSGEN_H_ */
@@ -43,6 +43,10 @@ enum PassGenID{
     PASSGEN_ID_BRUTE = 2,
     PASSGEN_ID_THREADED_BRUTE = 3,
     PASSGEN_ID_MARKOV = 4,
+    PASSGEN_ID_HYBRID = 5,
+    PASSGEN_ID_COMBINATOR = 6,
+    PASSGEN_ID_PRINCE = 7,
+    PASSGEN_ID_MASK = 8,
 };
 
 /**
@@ -56,6 +60,10 @@ public:
     struct KernelCode{
         std::string filename;
         std::string name;
+        /**
+         * Build options of kernel (e.g. -D definitions of generator's constants)
+         */
+        std::string options;
     };
     
     PassGen();
@@ -75,11 +83,51 @@ public:
      * @return false if this is last password
      */
     virtual bool getPassword(char* pass, uint32_t *len);
+    /**
+     * Get password by its global index. Used to decode passwords found by fused kernel.
+     * @param index
+     * @return empty string if index is out of range
+     */
+    virtual std::string getPassword(uint64_t index);
     /**
      * Returns code which can be run in OpenCL 
      * @return 
      */
     virtual KernelCode* getKernelCode();
+    /**
+     * Returns code of device function, which creates password by index of work item.
+     * It's fused into cracking kernel, so passwords live only in private memory.
+     * Name of code is unused, file is prepended to cracking kernel.
+     * @return NULL if generator can't be fused
+     */
+    virtual KernelCode* getFusedCode();
+    /**
+     * Initializes generator fused into cracking kernel
+     * @param kernel cracking kernel
+     * @param que
+     * @param context
+     * @param argIndex index of first argument of generator in cracking kernel
+     * @return number of arguments of generator
+     */
+    virtual uint32_t initFusedKernel(cl::Kernel *kernel, cl::CommandQueue *que, cl::Context *context, uint32_t argIndex);
+    /**
+     * Returns global index of first password of last kernel step
+     * @return 
+     */
+    virtual uint64_t kernelStepIndex();
+    /**
+     * Returns length of all passwords of last kernel step
+     * @return 0 if passwords of the step have different lengths
+     */
+    virtual uint32_t kernelStepLength();
+    /**
+     * Returns range of lengths of kernel steps, cracking kernel is built
+     * for each length if kernel steps have single length
+     * @param min
+     * @param max
+     * @return false if kernel steps aren't split by length
+     */
+    virtual bool kernelStepLengths(uint32_t *min, uint32_t *max);
     /**
      * Set global-work-size
      * @param gws
@@ -95,6 +143,14 @@ public:
      * @return
      */
     virtual bool nextKernelStep();
+    /**
+     * Set arguments to kernel for next window of passwords, which is cracked
+     * by one launch of persistent kernel. Window starts at kernelStepIndex().
+     * @param maxSize maximum number of passwords in window
+     * @param size number of passwords in window
+     * @return false if generator is exhausted or doesn't support windows
+     */
+    virtual bool nextKernelWindow(uint64_t maxSize, uint64_t *size);
     /**
      * Initializes generator in OpenCL kernel
      * @param kernel
@@ -123,6 +179,13 @@ public:
      */
     virtual void setStep(unsigned step);
 
+    /**
+     * Use copy of read-only tables on NUMA node of calling thread, which is
+     * pinned to CPU of the node
+     * @param node NUMA node of the generator's thread
+     */
+    virtual void replicateData(unsigned node);
+
     /**
      * Save current state of the generator
      * @param filename filename where to save state
@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef PRINCEPASSGEN_H_
+#define PRINCEPASSGEN_H_
+
+#include "IndexPassGen.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/**
+ * PRINCE generator creates passwords by chaining elements (words) from
+ * a single wordlist. Chains are ordered by their total length and every
+ * password is addressed by 64-bit index:
+ *  - chain table holds all combinations of element lengths (e.g. 3+5, 5+3)
+ *    with index of their first password,
+ *  - index inside chain is mixed-radix number of element indexes.
+ */
+class PrincePassGen : public IndexPassGen
+{
+public:
+  struct Options
+  {
+    std::string wordlist;
+    std::string length = "1:10";
+    unsigned max_elements = 4;
+  };
+
+  /**
+   * Constructor for factory object. This object only initializes memory and
+   * creates instances of generators
+   * @param options Command-line options
+   * @param cpu_mode If TRUE run generator on CPU instead GPU
+   */
+  PrincePassGen (Options & options, bool cpu_mode = false);
+  virtual ~PrincePassGen ();
+
+  /**
+   * Get path to kernel's source code and name of kernel's function
+   * @return Pointer to object with these informations
+   */
+  virtual KernelCode * getKernelCode();
+
+  /**
+   * Set global work-size
+   * @param gws
+   */
+  virtual void setKernelGWS(uint64_t gws);
+
+  /**
+   * Initialize OpenCL buffers (element and chain tables)
+   * @param kernel OpenCL kernel
+   * @param que OpenCL command-queue
+   * @param context OpenCL context
+   */
+  virtual void initKernel(cl::Kernel *kernel, cl::CommandQueue *que, cl::Context *context);
+
+  /**
+   * Initialize kernel's arguments for next step
+   * (increments indexes, makes reservation)
+   * @return FALSE if all passwords have already been generated
+   */
+  virtual bool nextKernelStep();
+
+  /**
+   * Test if this is only factory for password generator and not generator itself.
+   * @return TRUE if it's factory object, FALSE otherwise
+   */
+  virtual bool isFactory();
+
+  /**
+   * Create new instance of the generator
+   * @return
+   */
+  virtual PassGen *createGenerator();
+
+  /**
+   * Save the lowest index which is being processed
+   * @param filename
+   */
+  virtual void saveState(std::string filename);
+
+  /**
+   * Load and restore saved state of the generator
+   * @param filename
+   */
+  virtual void loadState(std::string filename);
+
+  /**
+   * Get maximum length of password
+   * @return
+   */
+  virtual uint8_t maxPassLen();
+
+  /**
+   * Get next password
+   * @param pass Pointer to array to store the password
+   * @param len Length of returned password
+   * @return FALSE if all passwords have been generated
+   */
+  virtual bool getPassword(char* pass, uint32_t *len);
+
+  /**
+   * Maximal length of element (longer words are ignored)
+   */
+  static const unsigned MAX_ELEMENT_LENGTH = 16;
+  /**
+   * Maximal number of elements in chain
+   */
+  static const unsigned MAX_ELEMENTS = 8;
+  /**
+   * Maximal number of chains (table of chains is searched by every password)
+   */
+  static const cl_ulong MAX_CHAINS = 1 << 20;
+private:
+
+  /**
+   * Construct new instance of generator from factory object
+   */
+  PrincePassGen (const PrincePassGen & o);
+
+  /**
+   * Path to kernel's source
+   */
+  const std::string _kernel_source = "kernels/prince_passgen.cl";
+  /**
+   * Name of kernel's function
+   */
+  const std::string _kernel_name = "prince_passgen";
+  /**
+   * ID of factory object (generators have ID from 1 to number of generators)
+   */
+  const int FACTORY_INSTANCE_ID = -1;
+
+  /**
+   * Load elements from wordlist and group them by length
+   * @param wordlist
+   */
+  void loadElements(const std::string & wordlist);
+
+  /**
+   * Create table of chains of given total length
+   * @param length Remaining length of chain
+   * @param chain Element lengths of current chain
+   */
+  void createChains(unsigned length, std::vector<cl_uchar> & chain);
+
+  /**
+   * Count chains of all lengths without creating them
+   * @return Number of chains (at most MAX_CHAINS + 1)
+   */
+  cl_ulong countChains();
+
+  /**
+   * Reserve new set of indexes and find chain of its first password
+   * @return TRUE if successful, FALSE otherwise
+   */
+  virtual bool reservePasswords();
+
+  static bool _cpu_mode;
+
+  static KernelCode _gpu_code;
+  static cl_uint _min_length;
+  static cl_uint _max_length;
+  static unsigned _max_elements;
+
+  // Elements grouped by length, elements of same length are stored
+  // one after another without delimiters
+  static std::vector<cl_uchar> _elements;
+  static cl_uint _element_offsets[MAX_ELEMENT_LENGTH + 1];
+  static cl_uint _element_counts[MAX_ELEMENT_LENGTH + 1];
+
+  // Index of first password of every chain (last item is total count)
+  static std::vector<cl_ulong> _chain_offsets;
+  // Element lengths of every chain (MAX_ELEMENTS per chain, 0 terminated)
+  static std::vector<cl_uchar> _chain_elements;
+
+  static int _num_instances;
+  // Current chain
+  std::size_t _chain = 0;
+
+  int _instance_id;
+  std::vector<PrincePassGen *> _instances;
+
+  cl::Kernel _kernel;
+  cl::Buffer _elements_buffer;
+  cl::Buffer _element_offsets_buffer;
+  cl::Buffer _element_counts_buffer;
+  cl::Buffer _chain_offsets_buffer;
+  cl::Buffer _chain_elements_buffer;
+};
+
+#endif /* PRINCEPASSGEN_H_ */
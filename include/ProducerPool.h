@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef PRODUCERPOOL_H_
+#define PRODUCERPOOL_H_
+
+#include "PassGen.h"
+#include "BoundedQueue.h"
+
+#include <atomic>
+#include <vector>
+#include <pthread.h>
+#include <cstdint>
+
+/**
+ * Batch of passwords in CandidateBuffer layout with stride of batch size
+ */
+struct PasswordBatch
+{
+  char *passwords;
+  uint32_t count;
+};
+
+/**
+ * Pool of host threads which generate passwords into batches owned by
+ * consumers (GPU crackers). Every consumer has a queue of free and a queue
+ * of full batches, so passwords are generated while consumer's device is
+ * busy with previous batch.
+ */
+class ProducerPool
+{
+public:
+  struct Consumer
+  {
+    Consumer(std::size_t capacity, uint32_t batch_size);
+
+    BoundedQueue<PasswordBatch *> free_batches;
+    BoundedQueue<PasswordBatch *> full_batches;
+    uint32_t batch_size;
+    std::atomic<bool> closed;
+    std::atomic<int> users;
+  };
+
+  /**
+   * @param passgen Generator of passwords. If it is factory, every producer
+   * gets its own instance, otherwise generator is shared by all producers
+   * @param num_producers Number of producer threads
+   */
+  ProducerPool(PassGen *passgen, unsigned num_producers);
+  ~ProducerPool();
+
+  /**
+   * Spawn producer threads
+   */
+  void start();
+
+  /**
+   * Stop and join producer threads
+   */
+  void stop();
+
+  /**
+   * Register consumer with its (preallocated) batches
+   * @param batches Batches with space for batch_size passwords
+   * @param batch_size Number of passwords in batch
+   * @return Consumer handle, it's valid until the pool is destroyed
+   */
+  Consumer * addConsumer(std::vector<PasswordBatch *> & batches,
+                         uint32_t batch_size);
+
+  /**
+   * Unregister consumer. After return no producer touches its batches.
+   * @param consumer
+   */
+  void removeConsumer(Consumer *consumer);
+
+  /**
+   * Wait for next full batch of consumer
+   * @param consumer
+   * @param stop Flag of consumer which stops waiting
+   * @return Full batch or nullptr if generator is exhausted or stop is set
+   */
+  PasswordBatch * getBatch(Consumer *consumer, const bool & stop);
+
+  /**
+   * Return processed batch to producers
+   * @param consumer
+   * @param batch
+   */
+  void releaseBatch(Consumer *consumer, PasswordBatch *batch);
+
+private:
+  // GPU crackers and CPU crackers of hybrid run
+  static const unsigned MAX_CONSUMERS = 256;
+  static const unsigned IDLE_SLEEP_US = 100;
+
+  static void * producerThread(void *arg);
+
+  /**
+   * Main loop of producer thread
+   * @param passgen Generator used by the thread
+   */
+  void produce(PassGen *passgen);
+
+  /**
+   * Fill batch with passwords
+   * @return FALSE if generator is exhausted
+   */
+  bool fillBatch(PassGen *passgen, PasswordBatch *batch, Consumer *consumer);
+
+  struct ThreadArg
+  {
+    ProducerPool *pool;
+    PassGen *passgen;
+  };
+
+  PassGen *_passgen;
+  unsigned _num_producers;
+  std::vector<ThreadArg> _args;
+  std::vector<pthread_t> _threads;
+  pthread_mutex_t _threads_mutex;
+
+  Consumer *_consumers[MAX_CONSUMERS];
+  std::atomic<unsigned> _num_consumers;
+  pthread_mutex_t _consumers_mutex;
+
+  std::atomic<bool> _stop;
+  // Set when generator shared by producers (not a factory) is exhausted
+  std::atomic<bool> _exhausted;
+  std::atomic<unsigned> _running;
+};
+
+#endif /* PRODUCERPOOL_H_ */
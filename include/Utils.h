@@ -26,6 +26,13 @@ public:
      * @return 
      */
     static uint64_t pow(uint64_t x, uint64_t y);
+    /**
+     * Computes 64-bit FNV-1a hash
+     * @param data
+     * @param len
+     * @return 
+     */
+    static uint64_t fnv1a(const char *data, size_t len);
 };
 
 #endif	/* UTILS_H */
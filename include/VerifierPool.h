@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2016 Peter Gazdik
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef VERIFIERPOOL_H_
+#define VERIFIERPOOL_H_
+
+#include "FileFormat.h"
+#include "BoundedQueue.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <cstdint>
+
+class GPUCracker;
+
+/**
+ * Pool of host threads verifying positive passwords found by GPU crackers.
+ * Every thread has its own cracker instance (created by factory), so
+ * verifyPassword() of a module doesn't need to be thread-safe. Passwords
+ * which passed verification are returned through completion queue.
+ */
+class VerifierPool
+{
+public:
+  /**
+   * @param factory Factory of GPU crackers of cracked file
+   * @param num_workers Number of verification threads
+   */
+  VerifierPool(CrackerFactory *factory, unsigned num_workers);
+  ~VerifierPool();
+
+  /**
+   * Spawn verification threads
+   */
+  void start();
+
+  /**
+   * Stop and join verification threads
+   */
+  void stop();
+
+  /**
+   * Submit password for verification
+   * @param password
+   * @param data Data of password derived by submitter (e.g. key computed in
+   * device), which is passed to verifyPassword() with the password
+   * @param pending Counter of submitter, which is decremented after the
+   * password is verified (and possibly inserted into completion queue)
+   * @return FALSE if queue of jobs is full
+   */
+  bool submit(const std::string & password, const std::string & data,
+              std::atomic<uint32_t> *pending);
+
+  /**
+   * Get password which passed verification
+   * @param password
+   * @return FALSE if no password has been verified
+   */
+  bool getResult(std::string & password);
+
+private:
+  static const std::size_t JOB_QUEUE_CAPACITY = 1024;
+  static const std::size_t RESULT_QUEUE_CAPACITY = 16;
+  static const unsigned IDLE_SLEEP_US = 100;
+
+  struct Job
+  {
+    std::string password;
+    std::string data;
+    std::atomic<uint32_t> *pending;
+  };
+
+  struct ThreadArg
+  {
+    VerifierPool *pool;
+    GPUCracker *verifier;
+  };
+
+  static void * workerThread(void *arg);
+
+  /**
+   * Main loop of verification thread
+   * @param verifier Cracker used for verification
+   */
+  void work(GPUCracker *verifier);
+
+  std::vector<GPUCracker *> _verifiers;
+  std::vector<ThreadArg> _args;
+  std::vector<pthread_t> _threads;
+  pthread_mutex_t _threads_mutex;
+
+  BoundedQueue<Job *> _jobs;
+  BoundedQueue<std::string *> _results;
+
+  std::atomic<bool> _stop;
+};
+
+#endif /* VERIFIERPOOL_H_ */
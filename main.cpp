@@ -44,6 +44,10 @@
 #include <cstdint>
 #include "UnicodeParser.h"
 #include <MarkovPassGen.h>
+#include <HybridPassGen.h>
+#include <CombinatorPassGen.h>
+#include <PrincePassGen.h>
+#include <MaskPassGen.h>
 
 #ifdef WRATHION_MPI
 #include <mpi.h>
@@ -66,7 +70,18 @@ const string help = "wrathion [OPTIONS]\n"
 "    --modules -l - list loaded modules\n"
 "    --devices -s - list platforms and devices\n"
 "    --cpu-cracker -c - prefer CPU cracker over GPU generator\n"
+"    --cpu-and-gpu - run CPU crackers next to GPU crackers, --threads sets\n"
+"                    their number (default: CPUs not feeding GPUs)\n"
+"    --pin - pin CPU cracker threads to CPUs, first threads of cores are\n"
+"            used first, spread over NUMA nodes\n"
+"    --smt=MODE - number of CPU crackers without --threads: thread (one per\n"
+"                 SMT thread), core (one per physical core) or auto\n"
+"                 (chosen by short calibration) (default: thread)\n"
+"    --numa-replicate - create CPU crackers and generators on NUMA nodes\n"
+"                       they run on, so each node has its own copy of\n"
+"                       target data and Markov table (implies --pin)\n"
 "    --map -d - devices to use <platform>:<device>[:<GWS>][,<platform>:<device>[:<GWS>],...]\n"
+"               (default: all GPUs, GWS is autotuned and stored in tuning.cache)\n"
 "    --chars -p - chars for creating passwords (default: abcdefghijklmnopqrstuvwxyz)\n"
 "    -u (alternative of --chars) - file with unicode characters in hex form\n"
 "    -m - maximum length of password (default: 10)\n"
@@ -76,6 +91,27 @@ const string help = "wrathion [OPTIONS]\n"
 "    --mpi - run in MPI mode\n"
 #endif
 "    --threads=NUMTHREADS, -t - number of threads for CPU Cracking\n"
+"    --pipeline=N - number of batches processed by GPU at once (default: 3)\n"
+"    --kernel-time=MS - target time of one GPU kernel, work size is adjusted\n"
+"                       to it (default: 50, 0 disables adjusting)\n"
+"    --producers=N - number of CPU threads generating passwords for GPU\n"
+"                    (default: number of CPUs not used by GPU threads)\n"
+"    --verifiers=N - number of CPU threads verifying passwords found by GPU\n"
+"                    (default: one per device)\n"
+"    --no-fuse - run GPU generator in its own kernel instead of fusing it\n"
+"                into cracking kernel\n"
+"    --no-length-kernels - don't build cracking kernel for each password length\n"
+"                          of GPU generator\n"
+"    --persistent - launch fused cracking kernel once per window of passwords,\n"
+"                   work items take passwords from counter in device memory\n"
+"                   (Markov and mask generators, brute force runs its own\n"
+"                   generator kernel)\n"
+"    --device-verify=N - maximum size of encrypted data in bytes, which\n"
+"                        positive passwords are authenticated against in GPU\n"
+"                        (default: 65536)\n"
+"    --cpu-vector=N - number of passwords cracked in vector lanes by one work\n"
+"                     item on CPU OpenCL devices, 8 or 16 (default: 8,\n"
+"                     0 runs scalar kernels)\n"
 "    -v - verbose mode (more information is displayed)\n"
 "\n"
 "Markov attack\n"
@@ -91,14 +127,34 @@ const string help = "wrathion [OPTIONS]\n"
 "          - layered - Layered Markov model\n"
 "    -I - return password on given index\n"
 "    -C, --cpu-generator - prefer CPU generator over GPU generator (works only\n"
-"                          with a Markov generator)\n"
+"                          with Markov, hybrid, combinator, PRINCE and mask\n"
+"                          generators)\n"
+"\n"
+"Hybrid attack (requires --dict)\n"
+"    -A, --hybrid-append=mask    append passwords given by mask to every word\n"
+"    -P, --hybrid-prepend=mask   prepend passwords given by mask to every word\n"
+"\n"
+"Combinator attack (requires --dict)\n"
+"    -R, --right-dict=file       dictionary with words appended to every word\n"
+"                                of --dict\n"
+"\n"
+"PRINCE attack (chains of words ordered by length, uses --length)\n"
+"    -W, --prince=file           wordlist with elements of chains\n"
+"    -E, --prince-elements=num   maximal number of elements in chain (default 4)\n"
+"\n"
+"Mask attack\n"
+"    -K, --mask-attack=mask|file mask or file with masks (.hcmask format:\n"
+"                                [?1,][?2,][?3,][?4,]mask, one per line)\n"
+"    -1, -2, -3, -4, --custom-charset1..4=charset\n"
+"                                user-defined charsets ?1 - ?4 (e.g. ?l?d_)\n"
 "\n"
 "Mask syntax: (same syntax as Hashcat and John the Ripper)\n"
 "    ?l - lower-case letters (abcdefghijklmnopqrstuvwxyz)\n"
 "    ?u - upper-case letters (ABCDEFGHIJKLMNOPQRSTUVWXYZ)\n"
 "    ?d - digits (0123456789)\n"
 "    ?s - punctuation and symbols (<<space>>!\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~)\n"
-"    ?a - all previous (?l?u?d?s)\n";
+"    ?a - all previous (?l?u?d?s)\n"
+"    ?1 - ?4 - user-defined charsets (only mask attack)\n";
 
 struct opts : MarkovPassGen::Options {
     opts():
@@ -119,13 +175,32 @@ struct opts : MarkovPassGen::Options {
     bool show_devices;
     bool prefer_cpu_cracker;
     bool prefer_cpu_generator = false;
+    bool cpu_and_gpu = false;
+    bool pin = false;
+    string smt;
+    bool numa_replicate = false;
     string devices_mapping;
     char chars[256] = {0};
     UnicodeParser unicodeParser;
     int max_pass_len = 10;
     int threads = 0;
+    int pipeline = 0;
+    int kernel_time = -1;
+    int producers = 0;
+    int verifiers = 0;
+    bool no_fuse = false;
+    bool no_length_kernels = false;
+    bool persistent = false;
+    int device_verify = -1;
+    int cpu_vector = -1;
     string dict;
     string unicode_file;
+    string hybrid_mask;
+    string right_dict;
+    string prince_wordlist;
+    int prince_elements = 4;
+    MaskPassGen::Options mask_attack;
+    bool hybrid_prepend = false;
     bool stdin_mode;
 #ifdef WRATHION_MPI
     bool mpi;
@@ -167,7 +242,20 @@ int main(int argc, char** argv) {
                {"devices", no_argument, 0, 's'},
                {"dict",    required_argument, 0, 'r'},
                {"threads",  required_argument, 0, 't'},
+               {"pipeline",  required_argument, 0, 'Q'},
+               {"kernel-time",  required_argument, 0, 'k'},
+               {"producers",  required_argument, 0, 'Y'},
+               {"verifiers",  required_argument, 0, 'V'},
+               {"no-fuse",  no_argument, 0, 'F'},
+               {"no-length-kernels",  no_argument, 0, 'B'},
+               {"persistent",  no_argument, 0, 'G'},
+               {"device-verify",  required_argument, 0, 'D'},
+               {"cpu-vector",  required_argument, 0, 'N'},
                {"cpu-cracker",  no_argument, 0, 'c'},
+               {"cpu-and-gpu",  no_argument, 0, 'H'},
+               {"pin",  no_argument, 0, 'O'},
+               {"smt",  required_argument, 0, 'J'},
+               {"numa-replicate",  no_argument, 0, 'U'},
                {"cpu-generator",  no_argument, 0, 'C'},
                {"map",  required_argument, 0, 'd'},
                {"chars",    required_argument, 0, 'p'},
@@ -180,9 +268,23 @@ int main(int argc, char** argv) {
 							 {"length", required_argument, 0, 'L'},
 							 {"model", required_argument, 0, 'X'},
 							 {"mask", required_argument, 0, 'M'},
+							 // Hybrid attack
+							 {"hybrid-append", required_argument, 0, 'A'},
+							 {"hybrid-prepend", required_argument, 0, 'P'},
+							 // Combinator attack
+							 {"right-dict", required_argument, 0, 'R'},
+							 // PRINCE attack
+							 {"prince", required_argument, 0, 'W'},
+							 {"prince-elements", required_argument, 0, 'E'},
+							 // Mask attack
+							 {"mask-attack", required_argument, 0, 'K'},
+							 {"custom-charset1", required_argument, 0, '1'},
+							 {"custom-charset2", required_argument, 0, '2'},
+							 {"custom-charset3", required_argument, 0, '3'},
+							 {"custom-charset4", required_argument, 0, '4'},
                {0, 0, 0, 0}
              };
-    while ((opt = getopt_long(argc, argv, "hf:lscd:p:u:r:t:vm:S:T:L:M:X:I:C", long_options,&opt_index)) != -1){
+    while ((opt = getopt_long(argc, argv, "hf:lscd:p:u:r:t:vm:S:T:L:M:X:I:CA:P:R:W:E:K:1:2:3:4:", long_options,&opt_index)) != -1){
         switch(opt){
         	  case 'S':
         	  	o.stat_file = optarg;
@@ -205,6 +307,32 @@ int main(int argc, char** argv) {
         	  case 'C':
         	    o.prefer_cpu_generator = true;
         	    break;
+        	  case 'A':
+        	    o.hybrid_mask = optarg;
+        	    o.hybrid_prepend = false;
+        	    break;
+        	  case 'P':
+        	    o.hybrid_mask = optarg;
+        	    o.hybrid_prepend = true;
+        	    break;
+        	  case 'R':
+        	    o.right_dict = optarg;
+        	    break;
+        	  case 'W':
+        	    o.prince_wordlist = optarg;
+        	    break;
+        	  case 'E':
+        	    o.prince_elements = atoi(optarg);
+        	    break;
+        	  case 'K':
+        	    o.mask_attack.mask = optarg;
+        	    break;
+        	  case '1':
+        	  case '2':
+        	  case '3':
+        	  case '4':
+        	    o.mask_attack.custom_charsets[opt - '1'] = optarg;
+        	    break;
             case 'h':
                 o.help = true; break;
             case 'f':
@@ -227,6 +355,32 @@ int main(int argc, char** argv) {
                 o.dict.assign(optarg); break;
             case 't':
                 o.threads = atoi(optarg); break;
+            case 'Q':
+                o.pipeline = atoi(optarg); break;
+            case 'k':
+                o.kernel_time = atoi(optarg); break;
+            case 'Y':
+                o.producers = atoi(optarg); break;
+            case 'V':
+                o.verifiers = atoi(optarg); break;
+            case 'F':
+                o.no_fuse = true; break;
+            case 'B':
+                o.no_length_kernels = true; break;
+            case 'G':
+                o.persistent = true; break;
+            case 'D':
+                o.device_verify = atoi(optarg); break;
+            case 'N':
+                o.cpu_vector = atoi(optarg); break;
+            case 'H':
+                o.cpu_and_gpu = true; break;
+            case 'O':
+                o.pin = true; break;
+            case 'J':
+                o.smt.assign(optarg); break;
+            case 'U':
+                o.numa_replicate = true; break;
             case 'v':
                 o.verbose = true; break;
 #ifdef WRATHION_MPI  
@@ -241,6 +395,16 @@ int main(int argc, char** argv) {
         return 0;
     }
     
+    if (o.prince_elements < 1 || o.prince_elements > (int) PrincePassGen::MAX_ELEMENTS) {
+        cout << "Number of PRINCE elements has to be from 1 to " << PrincePassGen::MAX_ELEMENTS << "." << endl;
+        return 0;
+    }
+    
+    if (!o.smt.empty() && o.smt != "thread" && o.smt != "core" && o.smt != "auto") {
+        cout << "Unknown SMT mode '" << o.smt << "', use thread, core or auto." << endl;
+        return 0;
+    }
+    
     signal(SIGINT, sigint_handler);
     
     if(o.chars[0] == 0){
@@ -265,6 +429,7 @@ int main(int argc, char** argv) {
     bool run = false;
     FileFormat* format = NULL;
     CrackerFactory *crackerFactory = NULL;
+    CrackerFactory *cpuCrackerFactory = NULL;
     PassGen *passgen = NULL;
     CrackerRunner runner;
     
@@ -292,7 +457,8 @@ int main(int argc, char** argv) {
       cout << pass << endl;
       return 0;
     }
-    if (o.dict.empty() && o.unicode_file.empty() &&  o.stat_file.empty())
+    if (o.dict.empty() && o.unicode_file.empty() &&  o.stat_file.empty()
+        && o.prince_wordlist.empty() && o.mask_attack.mask.empty())
     {
       cout << help;
       return 0;
@@ -345,6 +511,16 @@ int main(int argc, char** argv) {
         return 0;
     }
     
+    // CPU crackers run next to GPU crackers
+    if (run && o.cpu_and_gpu && crackerFactory->isGPU()) {
+        cpuCrackerFactory = format->getCPUCracker();
+        if(cpuCrackerFactory == NULL){
+            cout << "CPU cracker not found, using GPU cracker only" << endl;
+        }else{
+            cout << "Using CPU cracker next to GPU cracker" << endl;
+        }
+    }
+    
     // In case of GPU cracker we need additional 1 uchar point for current password length
     if (run && crackerFactory->isGPU()) {
         o.max_pass_len++;
@@ -358,6 +534,25 @@ int main(int argc, char** argv) {
             }
             o.unicodeParser.getCharsPtr();
             passgen = new UnicodePassGen(o.unicodeParser.getCharsPtr(), chars_count, o.max_pass_len*UTF8_CHAR_MAXSIZE, o.max_pass_len);
+        } else if (!o.mask_attack.mask.empty()){
+            passgen = new MaskPassGen(o.mask_attack, o.prefer_cpu_generator);
+        } else if (!o.prince_wordlist.empty()){
+            PrincePassGen::Options prince_options;
+            prince_options.wordlist = o.prince_wordlist;
+            prince_options.length = o.length;
+            prince_options.max_elements = o.prince_elements;
+            passgen = new PrincePassGen(prince_options, o.prefer_cpu_generator);
+        } else if (!o.dict.empty() && !o.right_dict.empty()){
+            CombinatorPassGen::Options combinator_options;
+            combinator_options.left_dictionary = o.dict;
+            combinator_options.right_dictionary = o.right_dict;
+            passgen = new CombinatorPassGen(combinator_options, o.prefer_cpu_generator);
+        } else if (!o.dict.empty() && !o.hybrid_mask.empty()){
+            HybridPassGen::Options hybrid_options;
+            hybrid_options.dictionary = o.dict;
+            hybrid_options.mask = o.hybrid_mask;
+            hybrid_options.prepend = o.hybrid_prepend;
+            passgen = new HybridPassGen(hybrid_options, o.prefer_cpu_generator);
         } else if (!o.dict.empty()){
             passgen = new DictionaryPassGen(o.dict);
         } else {
@@ -374,10 +569,49 @@ int main(int argc, char** argv) {
         }
         
         runner.setCrackerFactory(crackerFactory);  // set cracker factory
+        runner.setCPUCrackerFactory(cpuCrackerFactory);
         runner.setPassGen(passgen);                // set password generator
         if(o.threads > 0){
             runner.setNumThreads(o.threads);
         }
+        if(o.pipeline > 0){
+            GPUCracker::setPipelineDepth(o.pipeline);
+        }
+        if(o.kernel_time >= 0){
+            GPUCracker::setTargetKernelTime(o.kernel_time);
+        }
+        if(o.no_fuse){
+            GPUCracker::setFusedPassGen(false);
+        }
+        if(o.no_length_kernels){
+            GPUCracker::setLengthKernels(false);
+        }
+        if(o.persistent){
+            GPUCracker::setPersistentKernels(true);
+        }
+        if(o.device_verify >= 0){
+            GPUCracker::setDeviceVerifySize(o.device_verify);
+        }
+        if(o.cpu_vector >= 0){
+            GPUCracker::setCPUVectorWidth(o.cpu_vector);
+        }
+        if(o.pin){
+            runner.setPinThreads(true);
+        }
+        if(o.smt == "core"){
+            runner.setSMTMode(CrackerRunner::SMT_CORES);
+        }else if(o.smt == "auto"){
+            runner.setSMTMode(CrackerRunner::SMT_AUTO);
+        }
+        if(o.numa_replicate){
+            runner.setReplicateData(true);
+        }
+        if(o.producers > 0){
+            runner.setNumProducers(o.producers);
+        }
+        if(o.verifiers > 0){
+            runner.setNumVerifiers(o.verifiers);
+        }
         // Time measurement
         if (o.verbose){
             starttime = getMilliSecs();
@@ -424,6 +658,7 @@ int main(int argc, char** argv) {
         CrackerRunner::sleep(1000);
         delete passgen;
         delete crackerFactory;
+        delete cpuCrackerFactory;
     }
     GPUCracker::destroyOpenCL();
     return 0;
@@ -24,10 +24,12 @@
 #include "DOCRC4CrackerGPU.h"
 #include <iostream>
 #include <iomanip>
+#include <sstream>
 
 DOCRC4CrackerGPU::DOCRC4CrackerGPU(DOCInitData &data):data(data) {
     kernelFile = "kernels/doc_rc4_kernel.cl";
     kernelName = "doc_rc4_kernel";
+    kernelLibrary = "kernels/rc4.cl";
 }
 
 DOCRC4CrackerGPU::DOCRC4CrackerGPU(const DOCRC4CrackerGPU& orig) {
@@ -37,21 +39,19 @@ DOCRC4CrackerGPU::~DOCRC4CrackerGPU() {
 }
 
 bool DOCRC4CrackerGPU::initData() {
-    
-    buffer_salt = cl::Buffer(context,CL_MEM_READ_ONLY,sizeof(char)*16);
-    buffer_encVerifier = cl::Buffer(context,CL_MEM_READ_ONLY,sizeof(char)*16);
-    buffer_encVerifierHash = cl::Buffer(context,CL_MEM_READ_ONLY,sizeof(char)*16);
-    
-    que.enqueueWriteBuffer(buffer_salt,CL_TRUE,0,sizeof(char)*16,data.salt);
-    que.enqueueWriteBuffer(buffer_encVerifier,CL_TRUE,0,sizeof(char)*16,data.encVerifier);
-    que.enqueueWriteBuffer(buffer_encVerifierHash,CL_TRUE,0,sizeof(char)*16,data.encVerifierHash);
-    
-    kernel.setArg(userParamIndex,buffer_salt);
-    kernel.setArg(userParamIndex+1,buffer_encVerifier);
-    kernel.setArg(userParamIndex+2,buffer_encVerifierHash);
+    // Salt and verifier are passed to kernel by build options
     return true;
 }
 
+std::string DOCRC4CrackerGPU::kernelBuildOptions() {
+    std::stringstream ss;
+    ss << GPUCracker::kernelBuildOptions() << " -DLOCAL_SIZE=" << RC4_LOCAL_SIZE;
+    ss << " " << defineBytes("SALT",data.salt,16);
+    ss << " " << defineBytes("ENC_VERIFIER",data.encVerifier,16);
+    ss << " " << defineBytes("ENC_VERIFIER_HASH",data.encVerifierHash,16);
+    return ss.str();
+}
+
 void DOCRC4CrackerGPU::debugKernel(int clFinishRes) {
 }
 
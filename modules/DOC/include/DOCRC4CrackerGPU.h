@@ -36,15 +36,17 @@ public:
     virtual ~DOCRC4CrackerGPU();
     virtual bool initData();
 protected:
+    virtual std::string kernelBuildOptions();
 
     virtual void debugKernel(int clFinishRes);
 
 private:
     DOCInitData data;
-    cl::Buffer buffer_salt;
-    cl::Buffer buffer_encVerifier;
-    cl::Buffer buffer_encVerifierHash;
     cl::Buffer buffer_debug;
+    /**
+     * Work group size of kernel, local memory holds S-box of every work item
+     */
+    static const uint32_t RC4_LOCAL_SIZE = 64;
 };
 
 #endif	/* DOCRC4CRACKERGPU_H */
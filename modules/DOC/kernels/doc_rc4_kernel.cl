@@ -25,6 +25,11 @@
 
 #define ROL(x,c) rotate((uint)x,(uint)c)
 
+// SALT, ENC_VERIFIER and ENC_VERIFIER_HASH are defined by build options of cracker
+constant uchar salt[16] = SALT;
+constant uchar encVerifier[16] = ENC_VERIFIER;
+constant uchar encVerifierHash[16] = ENC_VERIFIER_HASH;
+
 #define F1(B,C,D) ((D) ^ ((B)&((C)^(D))))
 #define F2(B,C,D) ((C) ^ ((D) & ((B)^(C))))
 #define F3(B,C,D) ((B) ^ (C) ^ (D))
@@ -273,87 +278,23 @@ void inline md5_6blocks(uchar *input, ushort length,uchar *buffer){
 
 }
 
-typedef struct{
-    uchar S[256];
-    uchar i;
-    uchar j;
-} RC4State; 
-
-#define SWAP(A,B){uchar tmp = A; A = B; B = tmp; }
-
-void RC4Init128(local RC4State *State,uchar16 Key){
-    State->i = 0;
-    State->j = 0;
-    #pragma unroll
-    for (ushort i = 0;i<256;i++)
-        State->S[i] = i;
-    uchar j = 0;
-    
-    for (ushort i = 0;i<256;i+=16){
-        j += State->S[i] + Key.s0;
-        SWAP(State->S[i],State->S[j]);
-        j += State->S[i+1] + Key.s1;
-        SWAP(State->S[i+1],State->S[j]);
-        j += State->S[i+2] + Key.s2;
-        SWAP(State->S[i+2],State->S[j]);
-        j += State->S[i+3] + Key.s3;
-        SWAP(State->S[i+3],State->S[j]);
-        j += State->S[i+4] + Key.s4;
-        SWAP(State->S[i+4],State->S[j]);
-        j += State->S[i+5] + Key.s5;
-        SWAP(State->S[i+5],State->S[j]);
-        j += State->S[i+6] + Key.s6;
-        SWAP(State->S[i+6],State->S[j]);
-        j += State->S[i+7] + Key.s7;
-        SWAP(State->S[i+7],State->S[j]);
-        j += State->S[i+8] + Key.s8;
-        SWAP(State->S[i+8],State->S[j]);
-        j += State->S[i+9] + Key.s9;
-        SWAP(State->S[i+9],State->S[j]);
-        j += State->S[i+10] + Key.sa;
-        SWAP(State->S[i+10],State->S[j]);
-        j += State->S[i+11] + Key.sb;
-        SWAP(State->S[i+11],State->S[j]);
-        j += State->S[i+12] + Key.sc;
-        SWAP(State->S[i+12],State->S[j]);
-        j += State->S[i+13] + Key.sd;
-        SWAP(State->S[i+13],State->S[j]);
-        j += State->S[i+14] + Key.se;
-        SWAP(State->S[i+14],State->S[j]);
-        j += State->S[i+15] + Key.sf;
-        SWAP(State->S[i+15],State->S[j]);
-    }
-}
-
-uchar inline RC4Keystream(local RC4State *State){
-    uchar i = State->i + 1;
-    uchar j = State->j + State->S[i];
-    uchar Si,Sj;
-    Si = State->S[i];
-    Sj = State->S[j];
-    SWAP(Si,Sj);
-    uchar pos = Si + Sj;
-    State->i = i;
-    State->j = j;
-    State->S[i] = Si;
-    State->S[j] = Sj;
-    return State->S[pos];
-}
-
 /**
  * @author Honza
  */
-kernel void doc_rc4_kernel(global uchar* passwords, uchar pass_len, global uchar *found_flag, global uint *found_vector, constant uchar *salt, constant uchar *encVerifier, constant uchar *encVerifierHash) {
-    int id = get_global_id(0);
-    int lid = get_local_id(0);
-    uchar my_pass_len = passwords[id*pass_len];
+inline void doc_rc4_candidate(size_t id, global uint* passwords, uint stride, global uint *found_count, global uint *found_queue PASSGEN_PARAMS, local uchar *sboxes) {
+    RC4State rc4state;
     uchar buffer[64];
     uchar bufferLarge[384];
     
-    //copy and create Unicode16
-    for(int i = 0;i<my_pass_len;i++){
-        buffer[i*2] = passwords[id*pass_len+1+i];
+    int len = LOAD_CANDIDATE(id,buffer,passwords,stride);
+    if(len < 0)
+        return;
+    uchar my_pass_len = CANDIDATE_LENGTH(len);
+    
+    //create Unicode16 in place (from the end, so no char is overwritten)
+    for(int i = my_pass_len-1;i>=0;i--){
         buffer[i*2+1] = 0;
+        buffer[i*2] = buffer[i];
     }
     my_pass_len *= 2;
 
@@ -362,6 +303,7 @@ kernel void doc_rc4_kernel(global uchar* passwords, uchar pass_len, global uchar
     md5_1block(buffer,my_pass_len,buffer);
     
     //first 5 bytes of hash concatenate with 16bytes salt
+    #pragma unroll
     for(int i = 0;i<16;i++){
         buffer[i+5] = salt[i];
     }
@@ -382,29 +324,34 @@ kernel void doc_rc4_kernel(global uchar* passwords, uchar pass_len, global uchar
     
     md5_1block(buffer,9,buffer);
 
-    uchar16 RC4_key = (uchar16)( buffer[0],buffer[1],buffer[2],buffer[3],buffer[4],buffer[5],buffer[6],buffer[7],buffer[8],buffer[9],buffer[10],buffer[11],buffer[12],buffer[13],buffer[14],buffer[15]);
-    
-    //reuse no longer needed workspace in fast local memory 
-    local RC4State rc4state[64];
-    
-    //decrypt verifier
-    RC4Init128(&rc4state[lid],RC4_key);
+    //decrypt verifier (S-box of work item in local memory, see rc4.cl)
+    rc4_init(&rc4state,sboxes);
+    rc4_set_key16(&rc4state,buffer);
+    #pragma unroll
     for(int i = 0;i<16;i++){
-        buffer[i] = encVerifier[i] ^ RC4Keystream(&rc4state[lid]);
+        buffer[i] = encVerifier[i] ^ rc4_keystream(&rc4state);
     }
     
     //hash verifier
     md5_1block(buffer,16,buffer);
     
     for(int i = 0;i<16;i++){
-        uchar hash_byte = encVerifierHash[i] ^ RC4Keystream(&rc4state[lid]);
+        uchar hash_byte = encVerifierHash[i] ^ rc4_keystream(&rc4state);
         if(hash_byte != buffer[i]){
             return;
         }
     }
-    *found_flag = 1;
-    uint big_pos = id/32;
-    uint small_pos = id%32;
-    uint val = 0x80000000 >> small_pos;
-    atomic_or(found_vector+big_pos,val);
+    REPORT_CANDIDATE(id,found_count,found_queue,passwords,stride);
+}
+
+/**
+ * Cracks candidates of work item, see FOR_EACH_CANDIDATE
+ */
+__attribute__((reqd_work_group_size(LOCAL_SIZE,1,1)))
+kernel void doc_rc4_kernel(global uint* passwords, uint stride, global uint *found_count, global uint *found_queue PASSGEN_PARAMS) {
+    RC4_LOCAL_SBOXES(sboxes);
+    
+    FOR_EACH_CANDIDATE(id){
+        doc_rc4_candidate(id,passwords,stride,found_count,found_queue PASSGEN_ARGS,sboxes);
+    }
 }
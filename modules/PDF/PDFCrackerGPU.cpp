@@ -24,14 +24,17 @@
 #include "PDFCrackerGPU.h"
 #include "PDFFormat.h"
 #include <iostream>
+#include <sstream>
 
 PDFCrackerGPU::PDFCrackerGPU(PDFInitData &init):GPUCracker(),PDFCracker(init) {
     if (data.R <= 4) {
         kernelFile = "kernels/pdf_r3_kernel.cl";
         kernelName = "pdf_r3_kernel";
+        kernelLibrary = "kernels/rc4.cl";
     } else {
         kernelFile = "kernels/pdf_r5_kernel.cl";
         kernelName = "pdf_r5_kernel";
+        vectorKernelName = "pdf_r5_vector_kernel";
     }
 }
 
@@ -43,11 +46,19 @@ bool PDFCrackerGPU::verifyPassword(std::string password){
 }
 
 bool PDFCrackerGPU::initData(){
+    // All values of document are passed to kernel by build options
+    return true;
+}
+
+std::string PDFCrackerGPU::kernelBuildOptions(){
+    std::stringstream ss;
+    ss << GPUCracker::kernelBuildOptions();
+    
+    if (data.R <= 4) {
         uint8_t pad_ID1[48];
         uint8_t pad_ID1_digest[16];
-        char passpadding[52];
+        uint8_t passpadding[52];
         
-    if (data.R <= 4) {
         memcpy(pad_ID1,passpad,32);
         memcpy(pad_ID1+32,data.ID1.c_str(),16);
         MD5(pad_ID1,48,pad_ID1_digest);
@@ -56,30 +67,15 @@ bool PDFCrackerGPU::initData(){
         memcpy(passpadding+32,&data.P,4);
         memcpy(passpadding+36,data.ID1.c_str(),16);
         
-        buffer_U = cl::Buffer(context,CL_MEM_READ_ONLY,sizeof(char)*16);
-        buffer_Passpadding = cl::Buffer(context,CL_MEM_READ_ONLY,sizeof(char)*52);
-        buffer_Padhash = cl::Buffer(context,CL_MEM_READ_ONLY,sizeof(char)*16);
-        
-        que.enqueueWriteBuffer(buffer_U,CL_TRUE,0,sizeof(char)*16,data.U.c_str());
-        que.enqueueWriteBuffer(buffer_Passpadding,CL_TRUE,0,sizeof(char)*52,passpadding);
-        que.enqueueWriteBuffer(buffer_Padhash,CL_TRUE,0,sizeof(char)*16,pad_ID1_digest);
-        
-        kernel.setArg(userParamIndex,buffer_U);
-        kernel.setArg(userParamIndex+1,data.length/8);
-        kernel.setArg(userParamIndex+2,buffer_Passpadding);
-        kernel.setArg(userParamIndex+3,buffer_Padhash);
+        ss << " -DKEY_LEN=" << data.length/8 << " -DLOCAL_SIZE=" << RC4_LOCAL_SIZE;
+        ss << " " << defineBytes("U_VALUE",reinterpret_cast<const uint8_t*>(data.U.c_str()),16);
+        ss << " " << defineBytes("PASS_PADDING",passpadding,52);
+        ss << " " << defineBytes("PAD_ID1_HASH",pad_ID1_digest,16);
     } else {
-        buffer_U = cl::Buffer(context,CL_MEM_READ_ONLY,sizeof(char)*32);
-        buffer_U_valid_salt = cl::Buffer(context,CL_MEM_READ_ONLY,sizeof(char)*8);
-        
-        que.enqueueWriteBuffer(buffer_U,CL_TRUE,0,sizeof(char)*32,data.U.c_str());
-        que.enqueueWriteBuffer(buffer_U_valid_salt,CL_TRUE,0,sizeof(char)*8,data.U_valid_salt);
-        
-        kernel.setArg(userParamIndex,buffer_U);
-        kernel.setArg(userParamIndex+1,buffer_U_valid_salt);
+        ss << " " << defineWords("U_WORDS",reinterpret_cast<const uint8_t*>(data.U.c_str()),32);
+        ss << " " << defineWords("U_VALID_SALT_WORDS",data.U_valid_salt,8);
     }
-    
-    return true;
+    return ss.str();
 }
 
 
@@ -36,13 +36,12 @@ public:
     virtual ~PDFCrackerGPU();
     virtual bool verifyPassword(std::string password);
     virtual bool initData();
+    virtual std::string kernelBuildOptions();
 private:
-    
-    cl::Buffer buffer_Passpadding;
-    cl::Buffer buffer_Padhash;
-    cl::Buffer buffer_U;
-    cl::Buffer buffer_U_valid_salt; // for r5 only
-
+    /**
+     * Work group size of R3 kernel, local memory holds S-box of every work item
+     */
+    static const uint32_t RC4_LOCAL_SIZE = 32;
 };
 
 #endif	/* PDFCRACKERGPU_H */
@@ -23,97 +23,15 @@
  
  #pragma OPENCL EXTENSION cl_amd_printf : enable
 
-#define SWAP(A,B){uchar tmp = A; A = B; B = tmp; }
+// KEY_LEN, U_VALUE, PASS_PADDING and PAD_ID1_HASH are defined by build options of cracker
+constant const uchar U[16] = U_VALUE;
+constant const uchar pass_padding[52] = PASS_PADDING;
 
 constant const unsigned char passpad[] = {
     0x28,0xBF,0x4E,0x5E,0x4E,0x75,0x8A,0x41,0x64,0x00,0x4E,0x56,0xFF,0xFA,0x01,0x08,
     0x2E,0x2E,0x00,0xB6,0xD0,0x68,0x3E,0x80,0x2F,0x0C,0xA9,0xFE,0x64,0x53,0x69,0x7A
 };
 
-typedef struct{
-    uchar S[256];
-    uchar i;
-    uchar j;
-} RC4State; 
-
-void RC4KeySchedule(local RC4State *State,uchar16 Key,uchar KeyLength){
-    State->i = 0;
-    State->j = 0;
-    #pragma unroll
-    for (ushort i = 0;i<256;i++)
-        State->S[i] = i;
-    uchar j = 0;
-    
-    if(KeyLength == 5){
-        #pragma unroll
-        for (ushort i = 0;i<255;i+=5){
-            j += State->S[i] + Key.s0;
-            SWAP(State->S[i],State->S[j]);
-            j += State->S[i+1] + Key.s1;
-            SWAP(State->S[i+1],State->S[j]);
-            j += State->S[i+2] + Key.s2;
-            SWAP(State->S[i+2],State->S[j]);
-            j += State->S[i+3] + Key.s3;
-            SWAP(State->S[i+3],State->S[j]);
-            j += State->S[i+4] + Key.s4;
-            SWAP(State->S[i+4],State->S[j]);
-        }
-        j += State->S[255] + Key.s0;
-        SWAP(State->S[255],State->S[j]);
-    }else if(KeyLength == 16){
-        #pragma unroll
-        for (ushort i = 0;i<256;i+=16){
-            j += State->S[i] + Key.s0;
-            SWAP(State->S[i],State->S[j]);
-            j += State->S[i+1] + Key.s1;
-            SWAP(State->S[i+1],State->S[j]);
-            j += State->S[i+2] + Key.s2;
-            SWAP(State->S[i+2],State->S[j]);
-            j += State->S[i+3] + Key.s3;
-            SWAP(State->S[i+3],State->S[j]);
-            j += State->S[i+4] + Key.s4;
-            SWAP(State->S[i+4],State->S[j]);
-            j += State->S[i+5] + Key.s5;
-            SWAP(State->S[i+5],State->S[j]);
-            j += State->S[i+6] + Key.s6;
-            SWAP(State->S[i+6],State->S[j]);
-            j += State->S[i+7] + Key.s7;
-            SWAP(State->S[i+7],State->S[j]);
-            j += State->S[i+8] + Key.s8;
-            SWAP(State->S[i+8],State->S[j]);
-            j += State->S[i+9] + Key.s9;
-            SWAP(State->S[i+9],State->S[j]);
-            j += State->S[i+10] + Key.sa;
-            SWAP(State->S[i+10],State->S[j]);
-            j += State->S[i+11] + Key.sb;
-            SWAP(State->S[i+11],State->S[j]);
-            j += State->S[i+12] + Key.sc;
-            SWAP(State->S[i+12],State->S[j]);
-            j += State->S[i+13] + Key.sd;
-            SWAP(State->S[i+13],State->S[j]);
-            j += State->S[i+14] + Key.se;
-            SWAP(State->S[i+14],State->S[j]);
-            j += State->S[i+15] + Key.sf;
-            SWAP(State->S[i+15],State->S[j]);
-        }
-    }
-}
-
-uchar inline RC4Keystream(local RC4State *State){
-    uchar i = State->i + 1;
-    uchar j = State->j + State->S[i];
-    uchar Si,Sj;
-    Si = State->S[i];
-    Sj = State->S[j];
-    SWAP(Si,Sj);
-    uchar pos = Si + Sj;
-    State->i = i;
-    State->j = j;
-    State->S[i] = Si;
-    State->S[j] = Sj;
-    return State->S[pos];
-}
-
 #define ROL(x,c) rotate((uint)x,(uint)c)
 
 #define F1(B,C,D) ((D) ^ ((B)&((C)^(D))))
@@ -291,30 +209,29 @@ void inline MD5(uchar *input, uchar length, uchar *digest){
 /**
  * @author Honza
  */
-kernel void pdf_r3_kernel(global uchar* passwords, uchar pass_len, global uchar *found_flag, global uint *found_vector, constant const uchar* U, uint key_len, constant const uchar* pass_padding, constant const uchar* pad_ID1_hash) {
-    int id = get_global_id(0);
-    int lid = get_local_id(0);
+inline void pdf_r3_candidate(size_t id, global uint* passwords, uint stride, global uint *found_count, global uint *found_queue PASSGEN_PARAMS, local uchar *sboxes) {
+    RC4State rc_state;
     
-    uchar my_pass_len = passwords[id*pass_len];
-    uchar rc4_key_len = key_len;
+    const uchar rc4_key_len = KEY_LEN;
+    const uchar pad_ID1_hash[16] = PAD_ID1_HASH;
     uchar pass_buffer[84];
     uchar digest[16];
-    uchar16 RC4_key;
-    uchar16 RC4_key_actual;
+    uchar RC4_key_actual[16];
     uchar crypt_input[16];
     
-    local RC4State rc_state[32];
 
     //copy password to buffer
-    for(int i = 0;i<my_pass_len;i++){
-        pass_buffer[i] = passwords[id*pass_len+1+i];
-    }
+    int len = LOAD_CANDIDATE(id,pass_buffer,passwords,stride);
+    if(len < 0)
+        return;
+    uchar my_pass_len = CANDIDATE_LENGTH(len);
     
     //pad password to 32 bytes
     for(int i = 0;i<32-my_pass_len;i++){
         pass_buffer[my_pass_len+i] = passpad[i];
     }
     //pad with "salt"
+    #pragma unroll
     for(int i = 0;i<84-32;i++){
         pass_buffer[32+i] = pass_padding[i];
     }
@@ -326,22 +243,28 @@ kernel void pdf_r3_kernel(global uchar* passwords, uchar pass_len, global uchar
         MD5(digest,rc4_key_len,digest);
     }
     
-    switch(rc4_key_len){
-        case 5: RC4_key = (uchar16)( digest[0],digest[1],digest[2],digest[3],digest[4],0,0,0,0,0,0,0,0,0,0,0);break;
-        case 16: RC4_key = (uchar16)( digest[0],digest[1],digest[2],digest[3],digest[4],digest[5],digest[6],digest[7],digest[8],digest[9],digest[10],digest[11],digest[12],digest[13],digest[14],digest[15]);break;
-    }
-    
 
+    #pragma unroll
     for(int i = 0;i<16;i++){
         crypt_input[i] = pad_ID1_hash[i];
     }
 
+    // S-box of work item in local memory, see rc4.cl
+    rc4_init(&rc_state,sboxes);
     for(uchar i = 0;i<20;i++){
-        RC4_key_actual = RC4_key ^ i;
-        RC4KeySchedule(&rc_state[lid],RC4_key_actual,rc4_key_len);
+        #pragma unroll
+        for(int n = 0;n<KEY_LEN;n++)
+            RC4_key_actual[n] = digest[n] ^ i;
+#if KEY_LEN == 5
+        rc4_set_key5(&rc_state,RC4_key_actual);
+#elif KEY_LEN == 16
+        rc4_set_key16(&rc_state,RC4_key_actual);
+#else
+        rc4_schedule(&rc_state,RC4_key_actual,KEY_LEN);
+#endif
         
         for(uchar n = 0;n<16;n++){
-            uchar keystream = RC4Keystream(&rc_state[lid]);
+            uchar keystream = rc4_keystream(&rc_state);
             crypt_input[n] ^= keystream;
         }
     }
@@ -350,9 +273,17 @@ kernel void pdf_r3_kernel(global uchar* passwords, uchar pass_len, global uchar
             return;
     }
     
-    *found_flag = 1;
-    uint big_pos = id/32;
-    uint small_pos = id%32;
-    uint val = 0x80000000 >> small_pos;
-    atomic_or(found_vector+big_pos,val);
+    REPORT_CANDIDATE(id,found_count,found_queue,passwords,stride);
+}
+
+/**
+ * Cracks candidates of work item, see FOR_EACH_CANDIDATE
+ */
+__attribute__((reqd_work_group_size(LOCAL_SIZE,1,1)))
+kernel void pdf_r3_kernel(global uint* passwords, uint stride, global uint *found_count, global uint *found_queue PASSGEN_PARAMS) {
+    RC4_LOCAL_SBOXES(sboxes);
+    
+    FOR_EACH_CANDIDATE(id){
+        pdf_r3_candidate(id,passwords,stride,found_count,found_queue PASSGEN_ARGS,sboxes);
+    }
 }
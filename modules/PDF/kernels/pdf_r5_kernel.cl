@@ -23,12 +23,22 @@
  
  #pragma OPENCL EXTENSION cl_amd_printf : enable
  
-/* Password buffer size
- * default: 56 + 1 (56B is maximum for fast-SHA256)
- */
-#define PASS_BUFFER_SIZE 57
-#define SHA256_HASH_SIZE 32
 #define U_VALID_SALT_SIZE 8
+
+#ifndef MAX_PASS_LEN
+#define MAX_PASS_LEN 32
+#endif
+#define PASS_WORDS ((MAX_PASS_LEN + 3) / 4)
+
+/* Password with salt, padding bit and length has to fit one SHA256 block,
+ * 64 - 8 - 1 - 8 = 47B
+ */
+#define BLOCK_PASS_LEN 47
+#define BLOCK_PASS_WORDS (PASS_WORDS < 12 ? PASS_WORDS : 12)
+
+// U_WORDS and U_VALID_SALT_WORDS are big endian words defined by build options of cracker
+constant const uint U_words[8] = U_WORDS;
+constant const uint U_valid_salt[2] = U_VALID_SALT_WORDS;
 #define ROTR(x, n) (( x >> n ) | ( x << (32 - n)))
 #define Choice(x, y, z) ( z ^ ( x & ( y ^ z )))
 #define Majority(x, y, z) (( x & y ) ^ ( z & ( x ^ y )))
@@ -43,30 +53,78 @@
     h += Sigma0(a) + Majority(a ,b ,c);
 
 
-inline static void pdf_r5_sha256HashBlock(const uchar *blk, uint *hash) {
-    uint W[64];
-    uint A, B, C, D, E, F, G, H;
-    int i;
+#define SCHEDULE(i) \
+    W[(i) & 15] += sigma1(W[((i) - 2) & 15]) + W[((i) - 7) & 15] + sigma0(W[((i) - 15) & 15])
+
+#define ROUND_S(a,b,c,d,e,f,g,h,k,i)			\
+    SCHEDULE(i);					\
+    ROUND(a,b,c,d,e,f,g,h,k,W[(i) & 15])
 
+// Big endian word of 4 little endian bytes
+#define BSWAP32(x) (rotate((x) & 0x00ff00ffu, (u32x)24) | rotate((x) & 0xff00ff00u, (u32x)8))
+
+// Left part of word shifted right by s bits, s is multiple of 8 lower than 32
+#define SHIFT_OUT(x, s) select((u32x)0, (x) << (32 - (s)), (s) != 0)
+
+
+/**
+ * Builds the only message block of SHA256(password + U validation salt)
+ * directly in big endian words. Password words are byte swapped, salt words
+ * with padding bit are shifted by password length. All indices are constant,
+ * so the block stays in registers and with PASS_LEN selects are resolved
+ * at compile time. Lanes of vector kernel have their own lengths.
+ */
+inline void pdf_r5_message(const u32x *pass_words, u32x len, u32x *W) {
+    u32x index = len >> 2;
+    u32x shift = (len & 3) * 8;
+    u32x mask = ~((u32x)0xffffffffu >> shift);
+    u32x salt0 = U_valid_salt[0];
+    u32x salt1 = U_valid_salt[1];
+    u32x padding = 0x80000000u;
+    
+    // Salt and padding bit start at byte len and span up to 4 words
+    u32x tail0 = salt0 >> shift;
+    u32x tail1 = (salt1 >> shift) | SHIFT_OUT(salt0, shift);
+    u32x tail2 = (padding >> shift) | SHIFT_OUT(salt1, shift);
+    u32x tail3 = SHIFT_OUT(padding, shift);
+    
+    #pragma unroll
+    for (uint i = 0; i < BLOCK_PASS_WORDS; i++) {
+        u32x keep = select(select((u32x)0, mask, i == index), (u32x)0xffffffffu, i < index);
+        W[i] = BSWAP32(pass_words[i]) & keep;
+    }
     #pragma unroll
-    for (i = 0; i < 16; ++i) {
-        W[i] = (blk[i*4    ] << 24) 
-            | (blk[i*4 + 1] << 16) 
-            | (blk[i*4 + 2] << 8) 
-            |  blk[i*4 + 3];
+    for (uint i = BLOCK_PASS_WORDS; i < 14; i++) {
+        W[i] = 0;
     }
-    for (; i < 64; ++i) {
-        W[i] = sigma1(W[i-2]) + W[i-7] + sigma0(W[i-15]) + W[i-16];
+    #pragma unroll
+    for (uint i = 0; i < 14; i++) {
+        u32x k = i - index;
+        u32x tail = select((u32x)0, tail3, k == 3);
+        tail = select(tail, tail2, k == 2);
+        tail = select(tail, tail1, k == 1);
+        W[i] |= select(tail, tail0, k == 0);
     }
+    W[14] = 0;
+    W[15] = (len + U_VALID_SALT_SIZE) * 8;
+}
 
-    A = hash[0];
-    B = hash[1];
-    C = hash[2];
-    D = hash[3];
-    E = hash[4];
-    F = hash[5];
-    G = hash[6];
-    H = hash[7];
+/**
+ * Hashes message block and compares digest with U value. Last round that
+ * changes H is 60th, so its output word is compared before the last 3 rounds
+ * and almost all candidates are rejected without them, vector kernel skips
+ * them if no lane matches.
+ * @return mask of lanes matching U value
+ */
+inline i32x pdf_r5_sha256_check(u32x *W) {
+    u32x A = 0x6a09e667;
+    u32x B = 0xbb67ae85;
+    u32x C = 0x3c6ef372;
+    u32x D = 0xa54ff53a;
+    u32x E = 0x510e527f;
+    u32x F = 0x9b05688c;
+    u32x G = 0x1f83d9ab;
+    u32x H = 0x5be0cd19;
   
     ROUND(A, B, C, D, E, F, G, H, 0x428a2f98, W[ 0]);
     ROUND(H, A, B, C, D, E, F, G, 0x71374491, W[ 1]);
@@ -84,150 +142,124 @@ inline static void pdf_r5_sha256HashBlock(const uchar *blk, uint *hash) {
     ROUND(D, E, F, G, H, A, B, C, 0x80DEB1FE, W[13]);
     ROUND(C, D, E, F, G, H, A, B, 0x9BDC06A7, W[14]);
     ROUND(B, C, D, E, F, G, H, A, 0xC19BF174, W[15]); 
-    ROUND(A, B, C, D, E, F, G, H, 0xE49B69C1, W[16]);
-    ROUND(H, A, B, C, D, E, F, G, 0xEFBE4786, W[17]);
-    ROUND(G, H, A, B, C, D, E, F, 0x0FC19DC6, W[18]);
-    ROUND(F, G, H, A, B, C, D, E, 0x240CA1CC, W[19]);
-    ROUND(E, F, G, H, A, B, C, D, 0x2DE92C6F, W[20]);
-    ROUND(D, E, F, G, H, A, B, C, 0x4A7484AA, W[21]);
-    ROUND(C, D, E, F, G, H, A, B, 0x5CB0A9DC, W[22]);
-    ROUND(B, C, D, E, F, G, H, A, 0x76F988DA, W[23]);
-    ROUND(A, B, C, D, E, F, G, H, 0x983E5152, W[24]);
-    ROUND(H, A, B, C, D, E, F, G, 0xA831C66D, W[25]);
-    ROUND(G, H, A, B, C, D, E, F, 0xB00327C8, W[26]);
-    ROUND(F, G, H, A, B, C, D, E, 0xBF597FC7, W[27]);
-    ROUND(E, F, G, H, A, B, C, D, 0xC6E00BF3, W[28]);
-    ROUND(D, E, F, G, H, A, B, C, 0xD5A79147, W[29]);
-    ROUND(C, D, E, F, G, H, A, B, 0x06CA6351, W[30]);
-    ROUND(B, C, D, E, F, G, H, A, 0x14292967, W[31]);
-    ROUND(A, B, C, D, E, F, G, H, 0x27B70A85, W[32]);
-    ROUND(H, A, B, C, D, E, F, G, 0x2E1B2138, W[33]);
-    ROUND(G, H, A, B, C, D, E, F, 0x4D2C6DFC, W[34]);
-    ROUND(F, G, H, A, B, C, D, E, 0x53380D13, W[35]);
-    ROUND(E, F, G, H, A, B, C, D, 0x650A7354, W[36]);
-    ROUND(D, E, F, G, H, A, B, C, 0x766A0ABB, W[37]);
-    ROUND(C, D, E, F, G, H, A, B, 0x81C2C92E, W[38]);
-    ROUND(B, C, D, E, F, G, H, A, 0x92722C85, W[39]);
-    ROUND(A, B, C, D, E, F, G, H, 0xA2BFE8A1, W[40]);
-    ROUND(H, A, B, C, D, E, F, G, 0xA81A664B, W[41]);
-    ROUND(G, H, A, B, C, D, E, F, 0xC24B8B70, W[42]);
-    ROUND(F, G, H, A, B, C, D, E, 0xC76C51A3, W[43]);
-    ROUND(E, F, G, H, A, B, C, D, 0xD192E819, W[44]);
-    ROUND(D, E, F, G, H, A, B, C, 0xD6990624, W[45]);
-    ROUND(C, D, E, F, G, H, A, B, 0xF40E3585, W[46]);
-    ROUND(B, C, D, E, F, G, H, A, 0x106AA070, W[47]);
-    ROUND(A, B, C, D, E, F, G, H, 0x19A4C116, W[48]);
-    ROUND(H, A, B, C, D, E, F, G, 0x1E376C08, W[49]);
-    ROUND(G, H, A, B, C, D, E, F, 0x2748774C, W[50]);
-    ROUND(F, G, H, A, B, C, D, E, 0x34B0BCB5, W[51]);
-    ROUND(E, F, G, H, A, B, C, D, 0x391C0CB3, W[52]);
-    ROUND(D, E, F, G, H, A, B, C, 0x4ED8AA4A, W[53]);
-    ROUND(C, D, E, F, G, H, A, B, 0x5B9CCA4F, W[54]);
-    ROUND(B, C, D, E, F, G, H, A, 0x682E6FF3, W[55]);
-    ROUND(A, B, C, D, E, F, G, H, 0x748F82EE, W[56]);
-    ROUND(H, A, B, C, D, E, F, G, 0x78A5636F, W[57]);
-    ROUND(G, H, A, B, C, D, E, F, 0x84C87814, W[58]);
-    ROUND(F, G, H, A, B, C, D, E, 0x8CC70208, W[59]);
-    ROUND(E, F, G, H, A, B, C, D, 0x90BEFFFA, W[60]);
-    ROUND(D, E, F, G, H, A, B, C, 0xA4506CEB, W[61]);
-    ROUND(C, D, E, F, G, H, A, B, 0xBEF9A3F7, W[62]);
-    ROUND(B, C, D, E, F, G, H, A, 0xC67178F2, W[63]);
+    ROUND_S(A, B, C, D, E, F, G, H, 0xE49B69C1, 16);
+    ROUND_S(H, A, B, C, D, E, F, G, 0xEFBE4786, 17);
+    ROUND_S(G, H, A, B, C, D, E, F, 0x0FC19DC6, 18);
+    ROUND_S(F, G, H, A, B, C, D, E, 0x240CA1CC, 19);
+    ROUND_S(E, F, G, H, A, B, C, D, 0x2DE92C6F, 20);
+    ROUND_S(D, E, F, G, H, A, B, C, 0x4A7484AA, 21);
+    ROUND_S(C, D, E, F, G, H, A, B, 0x5CB0A9DC, 22);
+    ROUND_S(B, C, D, E, F, G, H, A, 0x76F988DA, 23);
+    ROUND_S(A, B, C, D, E, F, G, H, 0x983E5152, 24);
+    ROUND_S(H, A, B, C, D, E, F, G, 0xA831C66D, 25);
+    ROUND_S(G, H, A, B, C, D, E, F, 0xB00327C8, 26);
+    ROUND_S(F, G, H, A, B, C, D, E, 0xBF597FC7, 27);
+    ROUND_S(E, F, G, H, A, B, C, D, 0xC6E00BF3, 28);
+    ROUND_S(D, E, F, G, H, A, B, C, 0xD5A79147, 29);
+    ROUND_S(C, D, E, F, G, H, A, B, 0x06CA6351, 30);
+    ROUND_S(B, C, D, E, F, G, H, A, 0x14292967, 31);
+    ROUND_S(A, B, C, D, E, F, G, H, 0x27B70A85, 32);
+    ROUND_S(H, A, B, C, D, E, F, G, 0x2E1B2138, 33);
+    ROUND_S(G, H, A, B, C, D, E, F, 0x4D2C6DFC, 34);
+    ROUND_S(F, G, H, A, B, C, D, E, 0x53380D13, 35);
+    ROUND_S(E, F, G, H, A, B, C, D, 0x650A7354, 36);
+    ROUND_S(D, E, F, G, H, A, B, C, 0x766A0ABB, 37);
+    ROUND_S(C, D, E, F, G, H, A, B, 0x81C2C92E, 38);
+    ROUND_S(B, C, D, E, F, G, H, A, 0x92722C85, 39);
+    ROUND_S(A, B, C, D, E, F, G, H, 0xA2BFE8A1, 40);
+    ROUND_S(H, A, B, C, D, E, F, G, 0xA81A664B, 41);
+    ROUND_S(G, H, A, B, C, D, E, F, 0xC24B8B70, 42);
+    ROUND_S(F, G, H, A, B, C, D, E, 0xC76C51A3, 43);
+    ROUND_S(E, F, G, H, A, B, C, D, 0xD192E819, 44);
+    ROUND_S(D, E, F, G, H, A, B, C, 0xD6990624, 45);
+    ROUND_S(C, D, E, F, G, H, A, B, 0xF40E3585, 46);
+    ROUND_S(B, C, D, E, F, G, H, A, 0x106AA070, 47);
+    ROUND_S(A, B, C, D, E, F, G, H, 0x19A4C116, 48);
+    ROUND_S(H, A, B, C, D, E, F, G, 0x1E376C08, 49);
+    ROUND_S(G, H, A, B, C, D, E, F, 0x2748774C, 50);
+    ROUND_S(F, G, H, A, B, C, D, E, 0x34B0BCB5, 51);
+    ROUND_S(E, F, G, H, A, B, C, D, 0x391C0CB3, 52);
+    ROUND_S(D, E, F, G, H, A, B, C, 0x4ED8AA4A, 53);
+    ROUND_S(C, D, E, F, G, H, A, B, 0x5B9CCA4F, 54);
+    ROUND_S(B, C, D, E, F, G, H, A, 0x682E6FF3, 55);
+    ROUND_S(A, B, C, D, E, F, G, H, 0x748F82EE, 56);
+    ROUND_S(H, A, B, C, D, E, F, G, 0x78A5636F, 57);
+    ROUND_S(G, H, A, B, C, D, E, F, 0x84C87814, 58);
+    ROUND_S(F, G, H, A, B, C, D, E, 0x8CC70208, 59);
+    ROUND_S(E, F, G, H, A, B, C, D, 0x90BEFFFA, 60);
+    
+    // Early reject, H won't change in remaining rounds
+    i32x match = H + 0x5be0cd19 == U_words[7];
+    if (!ANY_LANE(match))
+        return match;
+    
+    ROUND_S(D, E, F, G, H, A, B, C, 0xA4506CEB, 61);
+    ROUND_S(C, D, E, F, G, H, A, B, 0xBEF9A3F7, 62);
+    ROUND_S(B, C, D, E, F, G, H, A, 0xC67178F2, 63);
   
-    hash[0] += A;
-    hash[1] += B;
-    hash[2] += C;
-    hash[3] += D;
-    hash[4] += E;
-    hash[5] += F;
-    hash[6] += G;
-    hash[7] += H;
+    return match
+        & (A + 0x6a09e667 == U_words[0])
+        & (B + 0xbb67ae85 == U_words[1])
+        & (C + 0x3c6ef372 == U_words[2])
+        & (D + 0xa54ff53a == U_words[3])
+        & (E + 0x510e527f == U_words[4])
+        & (F + 0x9b05688c == U_words[5])
+        & (G + 0x1f83d9ab == U_words[6]);
 }
 
 
-inline void pdf_r5_sha256f(const uchar *msg, const int msgLen, uchar *hash) {
-    uchar blk[64];
-    uint H[8];
-    int blkLen, i;
+#ifdef VECTOR_WIDTH
 
-    H[0] = 0x6a09e667;
-    H[1] = 0xbb67ae85;
-    H[2] = 0x3c6ef372;
-    H[3] = 0xa54ff53a;
-    H[4] = 0x510e527f;
-    H[5] = 0x9b05688c;
-    H[6] = 0x1f83d9ab;
-    H[7] = 0x5be0cd19;
-
-    blkLen = msgLen;
-    for (i = 0; i < blkLen; i++) {
-        blk[i] = msg[i];
-    }
-
-    blk[blkLen++] = 0x80;
-
-    while (blkLen < 56) {
-        blk[blkLen++] = 0;
-    }
-
-    blk[56] = 0;
-    blk[57] = 0;
-    blk[58] = 0;
-    blk[59] = 0;
-    blk[60] = (uchar)(msgLen >> 21);
-    blk[61] = (uchar)(msgLen >> 13);
-    blk[62] = (uchar)(msgLen >> 5);
-    blk[63] = (uchar)(msgLen << 3);
-    pdf_r5_sha256HashBlock(blk, H);
-
-    #pragma unroll
-    for (i = 0; i < 8; ++i) {
-        hash[i*4    ] = (uchar)(H[i] >> 24);
-        hash[i*4 + 1] = (uchar)(H[i] >> 16);
-        hash[i*4 + 2] = (uchar)(H[i] >> 8);
-        hash[i*4 + 3] = (uchar)(H[i]);
+/**
+ * Cracks VECTOR_WIDTH candidates in lanes, see FOR_EACH_VECTOR
+ */
+kernel void pdf_r5_vector_kernel(global uint* passwords, uint stride, global uint *found_count, global uint *found_queue) {
+    FOR_EACH_VECTOR(id){
+        u32x pass_words[BLOCK_PASS_WORDS];
+        u32x W[16];
+        u32x len;
+        
+        i32x valid = load_vector(id,&len,pass_words,BLOCK_PASS_WORDS,passwords,stride);
+        valid &= (len > 0) & (len <= BLOCK_PASS_LEN);
+        
+        pdf_r5_message(pass_words, (u32x)CANDIDATE_LENGTH(len), W);
+        report_vector(id,valid & pdf_r5_sha256_check(W),found_count,found_queue,passwords,stride);
     }
 }
 
+#else
 
 /**
  * @author Radek
  */
-kernel void pdf_r5_kernel(global uchar* passwords, uchar max_len, global uchar *found_flag, global uint *found_vector, constant const uchar* U, constant const uchar* U_valid_salt) {
+inline void pdf_r5_candidate(size_t id, global uint* passwords, uint stride, global uint *found_count, global uint *found_queue PASSGEN_PARAMS) {
     
-    int id = get_global_id(0);
-    int lid = get_local_id(0);
+    uint pass_words[PASS_WORDS];
+    uint W[16];
     
-    uchar my_pass_len = passwords[id*max_len];
-    if (my_pass_len == 0 || my_pass_len > max_len) {
+    // Copy password to buffer
+    int len = LOAD_CANDIDATE(id,(uchar *)pass_words,passwords,stride);
+    if (len <= 0 || len > BLOCK_PASS_LEN) {
         // overflowed invalid password
         return;
     }
-    uchar pass_buffer[PASS_BUFFER_SIZE];
-    uchar sha256_hash[SHA256_HASH_SIZE];
-    
-    // Copy password to buffer
-    for (int i = 0; i < my_pass_len; i++){
-        pass_buffer[i] = passwords[id*max_len+1+i];
-    }
-    
-    // Append password with User validation salt
-    #pragma unroll
-    for (int i = 0; i < U_VALID_SALT_SIZE; i++) {
-        pass_buffer[my_pass_len + i] = U_valid_salt[i];
-    }
+    uint my_pass_len = CANDIDATE_LENGTH(len);
     
-    // Perform SHA256
-    pdf_r5_sha256f(pass_buffer, my_pass_len + U_VALID_SALT_SIZE, sha256_hash);
+    // Perform SHA256 of password with User validation salt, check it with U value
+    pdf_r5_message(pass_words, my_pass_len, W);
+    if (!pdf_r5_sha256_check(W))
+        return;
     
-    // Check SHA256 hash with U value
-    for (uchar i = 0; i < SHA256_HASH_SIZE; i++){
-        if(U[i] != sha256_hash[i])
-            return;
+    REPORT_CANDIDATE(id,found_count,found_queue,passwords,stride);
+}
+
+/**
+ * Cracks candidates of work item, see FOR_EACH_CANDIDATE
+ */
+kernel void pdf_r5_kernel(global uint* passwords, uint stride, global uint *found_count, global uint *found_queue PASSGEN_PARAMS) {
+    FOR_EACH_CANDIDATE(id){
+        pdf_r5_candidate(id,passwords,stride,found_count,found_queue PASSGEN_ARGS);
     }
-    
-    *found_flag = 1;
-    uint big_pos = id/32;
-    uint small_pos = id%32;
-    uint val = 0x80000000 >> small_pos;
-    atomic_or(found_vector+big_pos,val);
 }
+
+#endif
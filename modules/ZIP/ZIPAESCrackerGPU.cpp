@@ -22,6 +22,9 @@
  */
 
 #include "ZIPAESCrackerGPU.h"
+#include "CandidateBuffer.h"
+#include <sstream>
+#include <cstring>
 
 ZIPAESCrackerGPU::ZIPAESCrackerGPU(std::vector<ZIPInitData> *data) {
     
@@ -33,16 +36,10 @@ ZIPAESCrackerGPU::ZIPAESCrackerGPU(std::vector<ZIPInitData> *data) {
     }
     
     kernelFile = "kernels/zip_aes_kernel.cl";
-    switch(this->data.keyLength){
-        case 128:
-            kernelName = "zip_aes128_kernel";break;
-        case 192:
-            kernelName = "zip_aes192_kernel";break;
-        case 256:
-            kernelName = "zip_aes256_kernel";break;
-        default:
-            break;
-    }
+    kernelName = "zip_aes_kernel";
+    vectorKernelName = "zip_aes_vector_kernel";
+    verifyCapacity = 0;
+    deviceAuth = false;
 }
 
 ZIPAESCrackerGPU::ZIPAESCrackerGPU(const ZIPAESCrackerGPU& orig) {
@@ -52,21 +49,107 @@ ZIPAESCrackerGPU::~ZIPAESCrackerGPU() {
 }
 
 bool ZIPAESCrackerGPU::initData() {
-    salt_buffer = cl::Buffer(context,CL_MEM_READ_ONLY,sizeof(char)*16);
-    verifier_buffer = cl::Buffer(context,CL_MEM_READ_ONLY,sizeof(char)*2);
+    // initData() runs for every kernel of cracker, verify kernel is shared
+    if(verifyProgram() == NULL)
+        initVerifyKernel();
+    return true;
+}
+
+void ZIPAESCrackerGPU::initVerifyKernel() {
+    // Verify kernel reads passwords from buffer even if passgen is fused
+    deviceAuth = data.dataLen <= deviceVerifySize;
+    std::stringstream options;
+    options << kernelBuildOptions() << " -DZIP_AES_VERIFY";
+    options << " " << defineBytes("AUTH_CODE",data.authCode,10);
+    if(deviceAuth)
+        options << " -DDEVICE_AUTH";
+    std::string verifyName = "zip_aes_verify_kernel";
+    loadKernel(kernelFile, verifyName, &verifyKernel, &verifyProgram, options.str(), {CANDIDATE_HEADER});
     
-    que.enqueueWriteBuffer(salt_buffer,CL_TRUE,0,sizeof(char)*16,data.salt);
-    que.enqueueWriteBuffer(verifier_buffer,CL_TRUE,0,sizeof(char)*2,data.verifier);
+    if(deviceAuth){
+        dataBuffer = cl::Buffer(context,CL_MEM_READ_ONLY,std::max<uint32_t>(data.dataLen,1));
+        if(data.dataLen > 0)
+            que.enqueueWriteBuffer(dataBuffer,CL_TRUE,0,data.dataLen,data.encData);
+    }else{
+        // Kernel argument has to be set, data is authenticated by host
+        dataBuffer = cl::Buffer(context,CL_MEM_READ_ONLY,1);
+    }
+}
+
+void ZIPAESCrackerGPU::filterPositivePasswords() {
+    uint32_t count = positivePasswords.size();
+    if(count == 0)
+        return;
+    uint32_t resultWords = deviceAuth ? 1 : data.keyLength/32;
     
-    kernel.setArg(userParamIndex,salt_buffer);
-    kernel.setArg(userParamIndex+1, verifier_buffer);
-    return true;
+    // Buffers grow with the largest set of positives
+    if(count > verifyCapacity){
+        verifyCapacity = count;
+        verifyPasswordBuffer = cl::Buffer(context,CL_MEM_READ_ONLY,CandidateBuffer::size(verifyCapacity,passgen->maxPassLen()));
+        verifyResultBuffer = cl::Buffer(context,CL_MEM_WRITE_ONLY,sizeof(cl_uint)*resultWords*verifyCapacity);
+    }
+    std::vector<char> passwords(CandidateBuffer::size(verifyCapacity,passgen->maxPassLen()),0);
+    for(uint32_t i = 0;i<count;i++){
+        CandidateBuffer::store(passwords.data(),verifyCapacity,i,positivePasswords[i].data(),positivePasswords[i].length());
+    }
+    que.enqueueWriteBuffer(verifyPasswordBuffer,CL_FALSE,0,passwords.size(),passwords.data());
+    
+    verifyKernel.setArg(0,verifyPasswordBuffer);
+    verifyKernel.setArg(1,(cl_uint)verifyCapacity);
+    verifyKernel.setArg(2,(cl_uint)count);
+    verifyKernel.setArg(3,verifyResultBuffer);
+    verifyKernel.setArg(4,dataBuffer);
+    verifyKernel.setArg(5,(cl_uint)data.dataLen);
+    // Local size of cracking kernel needn't fit verify kernel
+    que.enqueueNDRangeKernel(verifyKernel,cl::NullRange,cl::NDRange(count),cl::NullRange);
+    
+    verifyResults.resize(count*resultWords);
+    que.enqueueReadBuffer(verifyResultBuffer,CL_TRUE,0,sizeof(cl_uint)*verifyResults.size(),verifyResults.data());
+    
+    std::vector<std::string> verified;
+    std::vector<std::string> keys;
+    for(uint32_t i = 0;i<count;i++){
+        cl_uint *result = &verifyResults[i*resultWords];
+        if(deviceAuth){
+            // Authentication code matched, host checks it once more
+            if(result[0] != 0)
+                verified.push_back(positivePasswords[i]);
+            continue;
+        }
+        // Key words are big endian, key goes with password to verifier
+        std::string key(data.keyLength/8,'\0');
+        for(uint32_t j = 0;j<key.size();j++){
+            key[j] = result[j/4] >> (24 - 8*(j%4));
+        }
+        verified.push_back(positivePasswords[i]);
+        keys.push_back(key);
+    }
+    positivePasswords.swap(verified);
+    positiveData.swap(keys);
+}
+
+std::string ZIPAESCrackerGPU::kernelBuildOptions() {
+    // Salt and verifier are immediates of kernel, key length selects PBKDF2 block
+    std::stringstream ss;
+    ss << GPUCracker::kernelBuildOptions() << " -DKEY_LENGTH=" << data.keyLength;
+    ss << " " << defineBytes("SALT",data.salt,data.keyLength/16);
+    ss << " " << defineBytes("VERIFIER",data.verifier,2);
+    return ss.str();
 }
 
 bool ZIPAESCrackerGPU::verifyPassword(std::string& pass) {
+    return verifyPassword(pass,std::string());
+}
+
+bool ZIPAESCrackerGPU::verifyPassword(std::string& pass, const std::string& derivedKey) {
     uint8_t keyData[128],authCode[20];
     uint8_t *key;
-    pbkdf2_sha1(reinterpret_cast<const uint8_t*>(pass.c_str()),pass.length(),data.salt,data.saltLen,1000,data.keyLength/4,keyData);
+    
+    // Authentication key could be derived by verify kernel
+    if(derivedKey.size() == data.keyLength/8)
+        ::memcpy(keyData+(data.keyLength/8),derivedKey.data(),derivedKey.size());
+    else
+        pbkdf2_sha1(reinterpret_cast<const uint8_t*>(pass.c_str()),pass.length(),data.salt,data.saltLen,1000,data.keyLength/4,keyData);
     key = keyData+(data.keyLength/8);
     hmac_sha1(data.encData,data.dataLen,key,data.keyLength/8,authCode);
     if(::memcmp(authCode,data.authCode,10) == 0){
@@ -22,10 +22,13 @@
  */
 
 #include "ZIPPKCrackerGPU.h"
+#include <sstream>
+#include <algorithm>
 
 ZIPPKCrackerGPU::ZIPPKCrackerGPU(std::vector<ZIPInitData> *data):ZIPPKCracker(data) {
     kernelFile = "kernels/zip_pk_kernel.cl";
     kernelName = "zip_pk_kernel";
+    itemCandidates = ITEM_CANDIDATES;
 }
 
 ZIPPKCrackerGPU::ZIPPKCrackerGPU(const ZIPPKCrackerGPU& orig):ZIPPKCracker(orig) {
@@ -35,29 +38,45 @@ ZIPPKCrackerGPU::~ZIPPKCrackerGPU() {
 }
 
 bool ZIPPKCrackerGPU::initData() {
-    int32_t files_count = data->size();
-    lastCRCByte_buffer = cl::Buffer(context,CL_MEM_READ_ONLY,sizeof(char)*files_count);
-    crcTable_buffer = cl::Buffer(context,CL_MEM_READ_ONLY,sizeof(int)*256);
-    randomStream_buffer = cl::Buffer(context,CL_MEM_READ_ONLY,sizeof(char)*12*files_count);
-    
-    uint8_t *buffer = new uint8_t[12*files_count];
-    for(int i = 0;i<data->size();i++){
-        buffer[i] = (*data)[i].crc32 >> 24;
+    // Table is shared by kernels built for each password length
+    if(crcTable_buffer() == NULL){
+        crcTable_buffer = cl::Buffer(context,CL_MEM_READ_ONLY,sizeof(int)*256);
+        que.enqueueWriteBuffer(crcTable_buffer,CL_TRUE,0,sizeof(int)*256,crc32_table);
     }
-    que.enqueueWriteBuffer(crcTable_buffer,CL_TRUE,0,sizeof(int)*256,crc32_table);
-    que.enqueueWriteBuffer(lastCRCByte_buffer,CL_TRUE,0,sizeof(char)*files_count,buffer);
-    for(int i = 0;i<files_count;i++){
+    kernel.setArg(userParamIndex, crcTable_buffer);
+    return true;
+}
+
+std::string ZIPPKCrackerGPU::kernelBuildOptions() {
+    uint32_t files_count = data->size();
+    std::vector<uint8_t> lastCRCBytes(files_count);
+    std::vector<uint8_t> randomStream(12*files_count);
+    for(uint32_t i = 0;i<files_count;i++){
+        lastCRCBytes[i] = (*data)[i].crc32 >> 24;
         for(int j = 0;j<12;j++){
-            buffer[i*12+j] = (*data)[i].streamBuffer[j];
+            randomStream[i*12+j] = (*data)[i].streamBuffer[j];
         }
     }
-    que.enqueueWriteBuffer(randomStream_buffer,CL_TRUE,0,sizeof(char)*12*files_count,buffer);
-    kernel.setArg(userParamIndex, files_count);
-    kernel.setArg(userParamIndex+1, randomStream_buffer);
-    kernel.setArg(userParamIndex+2, lastCRCByte_buffer);
-    kernel.setArg(userParamIndex+3, crcTable_buffer);
-    delete[] buffer;
-    return true;
+    
+    // Headers of files are compile-time constants, so loop over files is unrolled
+    std::stringstream ss;
+    ss << GPUCracker::kernelBuildOptions() << " -DFILES_COUNT=" << files_count;
+    ss << " -DITEM_CANDIDATES=" << ITEM_CANDIDATES;
+    ss << " " << defineBytes("RANDOM_STREAM",randomStream.data(),randomStream.size());
+    ss << " " << defineBytes("LAST_CRC_BYTES",lastCRCBytes.data(),lastCRCBytes.size());
+    
+    // Prefix of DEFLATE data of file with data rejects most header matches
+    for(uint32_t i = 0;i<files_count;i++){
+        ZIPInitData &file = (*data)[i];
+        if(file.dataLen == 0 || file.compression != 8)
+            continue;
+        uint32_t prefixLen = std::min<uint32_t>(file.dataLen,DEFLATE_PREFIX_LENGTH);
+        ss << " -DDEFLATE_FILE=" << i << " -DDEFLATE_BYTES=" << prefixLen;
+        ss << " -DDEFLATE_DATA_LEN=" << file.dataLen << "u -DDEFLATE_SIZE=" << file.uncompressedSize << "u";
+        ss << " " << defineBytes("DEFLATE_PREFIX",file.encData,prefixLen);
+        break;
+    }
+    return ss.str();
 }
 
 void ZIPPKCrackerGPU::debugKernel(int clFinishRes) {
@@ -36,8 +36,20 @@ public:
     virtual ~ZIPAESCrackerGPU();
 
     virtual bool initData();
+    virtual std::string kernelBuildOptions();
     virtual bool verifyPassword(std::string& pass);
+    virtual bool verifyPassword(std::string& pass, const std::string& derivedKey);
 protected:
+    /**
+     * Derives authentication key of positive passwords by verify kernel.
+     * Passwords are authenticated in GPU if data isn't larger than
+     * deviceVerifySize, otherwise their keys go to positiveData for verifyPassword.
+     */
+    virtual void filterPositivePasswords();
+    /**
+     * Loads verify kernel and its buffer of data
+     */
+    void initVerifyKernel();
     /**
      * Calculate HMAC-SHA1 of message
      * @param msg input to HMAC
@@ -66,9 +78,29 @@ protected:
      */
     void pbkdf2_sha1(const uint8_t* pass, unsigned int passLen, const uint8_t* in_salt,unsigned int saltLen, unsigned int iterations, unsigned int dkLen, uint8_t* output);
     ZIPInitData data;
-    
-    cl::Buffer salt_buffer;
-    cl::Buffer verifier_buffer;
+    /**
+     * Kernel deriving authentication key of positive passwords
+     */
+    cl::Kernel verifyKernel;
+    cl::Program verifyProgram;
+    /**
+     * Buffers of verify kernel (passwords, results and encrypted data)
+     */
+    cl::Buffer verifyPasswordBuffer;
+    cl::Buffer verifyResultBuffer;
+    cl::Buffer dataBuffer;
+    /**
+     * Capacity of buffers of verify kernel in passwords
+     */
+    uint32_t verifyCapacity;
+    /**
+     * Flag set if data is authenticated in GPU
+     */
+    bool deviceAuth;
+    /**
+     * Results of verify kernel
+     */
+    std::vector<cl_uint> verifyResults;
 };
 
 #endif	/* ZIPAESCRACKERGPU_H */
@@ -41,6 +41,7 @@ public:
 
     virtual bool verifyPassword(std::string& pass);
     virtual bool initData();
+    virtual std::string kernelBuildOptions();
     
 
     virtual void debugKernel(int clFinishRes);
@@ -48,9 +49,16 @@ public:
 
 private:
     cl::Buffer crcTable_buffer;
-    cl::Buffer lastCRCByte_buffer;
-    cl::Buffer randomStream_buffer;
     cl::Buffer debug_buffer;
+    /**
+     * Number of candidates cracked by one work item, so local CRC table is
+     * loaded for more candidates
+     */
+    static const uint32_t ITEM_CANDIDATES = 4;
+    /**
+     * Maximum number of bytes of DEFLATE data checked in kernel
+     */
+    static const uint32_t DEFLATE_PREFIX_LENGTH = 128;
 
 };
 
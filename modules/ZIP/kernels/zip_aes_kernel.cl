@@ -21,10 +21,11 @@
  * 
  */
 
-#define ROL(x,c) rotate((uint)x,(uint)c)
+#define ROL(x,c) rotate((u32x)(x),(u32x)(c))
 
+// Schedule is kept in 16 words, word i is replaced by word i+16
 #define ROUNDTAIL(a,b,e,f,i,k,w)  \
-	e += ROL(a,5) + f + k + w[i];  \
+	e += ROL(a,5) + f + k + w[(i)&15];  \
 	b = ROL(b,30);
 
 #define F1(b,c,d) (d ^ (b & (c ^ d)))
@@ -32,15 +33,10 @@
 #define F3(b,c,d) ((b & c) ^ (b & d) ^ (c & d))
 #define F4(b,c,d) (b ^ c ^ d)
 
-
-#define LOADSCHEDULE(i, w, block)\
-        w[i] = (block+i*4)[0] << 24 | (block+i*4)[1] << 16 | (block+i*4)[2] << 8 | (block+i*4)[3];
-
 #define SCHEDULE(i, w) \
-        w[i] = ROL((w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16]), 1);
+        w[(i)&15] = ROL((w[((i)-3)&15] ^ w[((i)-8)&15] ^ w[((i)-14)&15] ^ w[(i)&15]), 1);
 
-#define ROUND0s(a,b,c,d,e,i,w,block) \
-        LOADSCHEDULE(i, w, block)\
+#define ROUND0s(a,b,c,d,e,i,w) \
         ROUNDTAIL(a, b, e, F1(b, c, d), i, 0x5A827999, w)
 
 #define ROUND0(a,b,c,d,e,i,w) \
@@ -59,60 +55,34 @@
         SCHEDULE(i, w) \
         ROUNDTAIL(a, b, e, F4(b, c, d), i, 0xCA62C1D6, w)
 
-void inline sha1(const uchar* msg, unsigned int len, uchar* output){
-    unsigned int h0 = 0x67452301;
-    unsigned int h1 = 0xEFCDAB89;
-    unsigned int h2 = 0x98BADCFE;
-    unsigned int h3 = 0x10325476;
-    unsigned int h4 = 0xC3D2E1F0;
-    
-    unsigned int chunks = ((len+9)/64)+1;
-    
-    unsigned char msg_pad_space[2*64] = {0};
-    unsigned char *msg_pad = msg_pad_space;
-    unsigned int w[80];
-    
-    unsigned char pos = 62;
-    
-    if(len > 2*64-9){
-        return;
-    }
-    for(int i = 0;i<len;i++)
-        msg_pad[i] = msg[i];
-    msg_pad[len] = 0x80;
-    if(len > 54)
-        pos = 126;
-
-    
-    unsigned long bit_len = len*8;
-    msg_pad[pos++] = (bit_len >> 8) & 0xFF;
-    msg_pad[pos] = bit_len & 0xFF;
-    
-    for(int chunk = 0;chunk<chunks;chunk++){
-
-        unsigned int a = h0;
-        unsigned int b = h1;
-        unsigned int c = h2;
-        unsigned int d = h3;
-        unsigned int e = h4;
-
-        
-    ROUND0s(a, b, c, d, e,  0, w, msg_pad)
-	ROUND0s(e, a, b, c, d,  1, w, msg_pad)
-	ROUND0s(d, e, a, b, c,  2, w, msg_pad)
-	ROUND0s(c, d, e, a, b,  3, w, msg_pad)
-	ROUND0s(b, c, d, e, a,  4, w, msg_pad)
-	ROUND0s(a, b, c, d, e,  5, w, msg_pad)
-	ROUND0s(e, a, b, c, d,  6, w, msg_pad)
-	ROUND0s(d, e, a, b, c,  7, w, msg_pad)
-	ROUND0s(c, d, e, a, b,  8, w, msg_pad)
-	ROUND0s(b, c, d, e, a,  9, w, msg_pad)
-	ROUND0s(a, b, c, d, e, 10, w, msg_pad)
-	ROUND0s(e, a, b, c, d, 11, w, msg_pad)
-	ROUND0s(d, e, a, b, c, 12, w, msg_pad)
-	ROUND0s(c, d, e, a, b, 13, w, msg_pad)
-	ROUND0s(b, c, d, e, a, 14, w, msg_pad)
-	ROUND0s(a, b, c, d, e, 15, w, msg_pad)
+/**
+ * SHA-1 compression of one block of big endian words into state. Block is
+ * overwritten by schedule, constant words of padding are folded by compiler.
+ * Words of vector kernel hold lanes of its candidates.
+ */
+inline void sha1_block(u32x* w, u32x* h){
+    u32x a = h[0];
+    u32x b = h[1];
+    u32x c = h[2];
+    u32x d = h[3];
+    u32x e = h[4];
+
+	ROUND0s(a, b, c, d, e,  0, w)
+	ROUND0s(e, a, b, c, d,  1, w)
+	ROUND0s(d, e, a, b, c,  2, w)
+	ROUND0s(c, d, e, a, b,  3, w)
+	ROUND0s(b, c, d, e, a,  4, w)
+	ROUND0s(a, b, c, d, e,  5, w)
+	ROUND0s(e, a, b, c, d,  6, w)
+	ROUND0s(d, e, a, b, c,  7, w)
+	ROUND0s(c, d, e, a, b,  8, w)
+	ROUND0s(b, c, d, e, a,  9, w)
+	ROUND0s(a, b, c, d, e, 10, w)
+	ROUND0s(e, a, b, c, d, 11, w)
+	ROUND0s(d, e, a, b, c, 12, w)
+	ROUND0s(c, d, e, a, b, 13, w)
+	ROUND0s(b, c, d, e, a, 14, w)
+	ROUND0s(a, b, c, d, e, 15, w)
 	ROUND0(e, a, b, c, d, 16, w)
 	ROUND0(d, e, a, b, c, 17, w)
 	ROUND0(c, d, e, a, b, 18, w)
@@ -177,226 +147,292 @@ void inline sha1(const uchar* msg, unsigned int len, uchar* output){
 	ROUND3(d, e, a, b, c, 77, w)
 	ROUND3(c, d, e, a, b, 78, w)
 	ROUND3(b, c, d, e, a, 79, w)
-        
-        h0 += a;
-        h1 += b;
-        h2 += c;
-        h3 += d;
-        h4 += e;
-        msg_pad += 64;
-    }
-    output[0] = h0 >> 24;
-    output[1] = (h0 >> 16) & 0xFF;
-    output[2] = (h0 >> 8) & 0xFF;
-    output[3] = h0 & 0xFF;
-    
-    output[4] = h1 >> 24;
-    output[5] = (h1 >> 16) & 0xFF;
-    output[6] = (h1 >> 8) & 0xFF;
-    output[7] = h1 & 0xFF;
-    
-    output[8] = h2 >> 24;
-    output[9] = (h2 >> 16) & 0xFF;
-    output[10] = (h2 >> 8) & 0xFF;
-    output[11] = h2 & 0xFF;
-    
-    output[12] = h3 >> 24;
-    output[13] = (h3 >> 16) & 0xFF;
-    output[14] = (h3 >> 8) & 0xFF;
-    output[15] = h3 & 0xFF;
-    
-    output[16] = h4 >> 24;
-    output[17] = (h4 >> 16) & 0xFF;
-    output[18] = (h4 >> 8) & 0xFF;
-    output[19] = h4 & 0xFF;
-    
+
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
 }
 
-void inline hmac_sha1(const uchar* msg, unsigned int msgLen, const uchar* key, unsigned int keyLen, uchar* output){
-    uchar key_pad[128];
-    
-    #pragma unroll
-    for(uchar i = 0;i<64;i++) key_pad[i] = 0x36;
-    
-    for(uchar i = 0;i<keyLen; i++){
-        key_pad[i] ^= key[i];
-    }
+#define SHA1_INIT(h) \
+        h[0] = 0x67452301; h[1] = 0xEFCDAB89; h[2] = 0x98BADCFE; \
+        h[3] = 0x10325476; h[4] = 0xC3D2E1F0;
 
-    for(ushort i = 0;i<msgLen;i++) key_pad[i+64] = msg[i];
-    sha1(key_pad,64+msgLen,output);
-    #pragma unroll
-    for(uchar i = 0;i<64;i++) key_pad[i] = 0x5C;
-    for(uchar i = 0;i<keyLen; i++){
-        key_pad[i] ^= key[i];
-    }
+/**
+ * Computes state after key block of HMAC (key XORed with ipad or opad)
+ */
+inline void hmac_sha1_midstate(const u32x* key, uint pad, u32x* state){
+    u32x w[16];
     #pragma unroll
-    for(int i = 0;i<20;i++) key_pad[i+64] = output[i];
-    sha1(key_pad,84,output);
+    for(int i = 0;i<16;i++) w[i] = key[i] ^ pad;
+    SHA1_INIT(state)
+    sha1_block(w,state);
 }
 
-#define ADD_XOR(res, in) \
-        _Pragma("unroll") \
-        for (int i = 0;i<20;i++) \
-             res[i] ^= in[i];
-
-void pbkdf2_sha1_zip_aes256(const uchar* pass, unsigned int passLen, constant uchar* in_salt, uchar* output){
+/**
+ * HMAC-SHA1 of 20 byte digest from ipad and opad midstates. Message fits
+ * into one block after key block, so only its padding words are set.
+ */
+inline void hmac_sha1_digest(const u32x* istate, const u32x* ostate, u32x* digest){
+    u32x w[16];
+    u32x h[5];
 
-    uchar prevU[20] = {0};
-    uchar Fres[20];    
-    
+    #pragma unroll
+    for(int i = 0;i<5;i++){ w[i] = digest[i]; h[i] = istate[i]; }
+    w[5] = 0x80000000;
+    #pragma unroll
+    for(int i = 6;i<15;i++) w[i] = 0;
+    w[15] = (64+20)*8;
+    sha1_block(w,h);
 
     #pragma unroll
-    for(uchar i = 0;i<20;i++) Fres[i] = 0;
+    for(int i = 0;i<5;i++){ w[i] = h[i]; digest[i] = ostate[i]; }
+    w[5] = 0x80000000;
     #pragma unroll
-    for(int i = 0;i<16;i++) prevU[i] = in_salt[i];
+    for(int i = 6;i<15;i++) w[i] = 0;
+    w[15] = (64+20)*8;
+    sha1_block(w,digest);
+}
 
-    prevU[19] = 4;
+// KEY_LENGTH, SALT and VERIFIER are defined by build options of cracker
+#define SALT_LEN (KEY_LENGTH/16)
+#define SALT_WORDS (SALT_LEN/4)
+// Password verifier follows encryption and authentication keys in derived key
+#define KEY_BYTES (KEY_LENGTH/8)
+#define VERIFIER_BLOCK ((2*(KEY_LENGTH/8))/20+1)
+#define VERIFIER_OFFSET ((2*(KEY_LENGTH/8))%20)
+#define VERIFIER_BYTE(F,i) ((F[(VERIFIER_OFFSET+(i))/4] >> (24 - 8*((VERIFIER_OFFSET+(i))%4))) & 0xff)
 
-    hmac_sha1(prevU,20,pass,passLen,prevU);
-    ADD_XOR(Fres,prevU);
-    for(ushort c=1;c<1000;c++){
-        hmac_sha1(prevU,20,pass,passLen,prevU);
-        ADD_XOR(Fres,prevU);
+// Password is loaded in words, HMAC key of password has up to 64 bytes
+#define PASS_WORDS ((MAX_PASS_LEN+3)/4)
+#define KEY_PASS_WORDS (PASS_WORDS < 16 ? PASS_WORDS : 16)
+
+// Big endian word of 4 little endian bytes
+#define BSWAP32(x) (rotate((x) & 0x00ff00ffu, (u32x)24) | rotate((x) & 0xff00ff00u, (u32x)8))
+
+/**
+ * Converts words of password into big endian words of HMAC key padded by
+ * zeros, bytes after length are cleared
+ */
+inline void pass_key(const u32x* words, u32x len, u32x* key){
+    u32x partial = ~((u32x)0xffffffffu >> ((len & 3) * 8));
+
+    #pragma unroll
+    for(uint i = 0;i<KEY_PASS_WORDS;i++){
+        u32x keep = select(select((u32x)0, partial, len > 4*i), (u32x)0xffffffffu, len >= 4*i+4);
+        key[i] = BSWAP32(words[i]) & keep;
     }
     #pragma unroll
-    for(uchar i = 0;i<2;i++) output[i] = Fres[4+i]; 
+    for(uint i = KEY_PASS_WORDS;i<16;i++) key[i] = 0;
 }
 
-void pbkdf2_sha1_zip_aes192(const uchar* pass, unsigned int passLen, const uchar* in_salt, uchar* output){
+/**
+ * Computes ipad and opad midstates of HMAC key
+ */
+inline void pbkdf2_sha1_init(const u32x* key, u32x* istate, u32x* ostate){
+    // Key blocks are the same for all iterations
+    hmac_sha1_midstate(key,0x36363636,istate);
+    hmac_sha1_midstate(key,0x5C5C5C5C,ostate);
+}
 
-    uchar prevU[20] = {0};
-    uchar Fres[20];    
-    
+/**
+ * Derives one 20 byte block of key by PBKDF2-HMAC-SHA1 with 1000 iterations
+ */
+inline void pbkdf2_sha1_block(const u32x* istate, const u32x* ostate, uint block, u32x* F){
+    const uchar salt[SALT_LEN] = SALT;
+    u32x w[16];
+    u32x U[5];
 
+    // First iteration hashes salt and index of block
     #pragma unroll
-    for(uchar i = 0;i<20;i++) Fres[i] = 0;
+    for(int i = 0;i<SALT_WORDS;i++)
+        w[i] = salt[4*i] << 24 | salt[4*i+1] << 16 | salt[4*i+2] << 8 | salt[4*i+3];
+    w[SALT_WORDS] = block;
+    w[SALT_WORDS+1] = 0x80000000;
     #pragma unroll
-    for(int i = 0;i<12;i++) prevU[i] = in_salt[i];
-
-    prevU[15] = 3;
+    for(int i = SALT_WORDS+2;i<15;i++) w[i] = 0;
+    w[15] = (64+SALT_LEN+4)*8;
+    #pragma unroll
+    for(int i = 0;i<5;i++) U[i] = istate[i];
+    sha1_block(w,U);
 
-    hmac_sha1(prevU,16,pass,passLen,prevU);
+    #pragma unroll
+    for(int i = 0;i<5;i++){ w[i] = U[i]; U[i] = ostate[i]; }
+    w[5] = 0x80000000;
+    #pragma unroll
+    for(int i = 6;i<15;i++) w[i] = 0;
+    w[15] = (64+20)*8;
+    sha1_block(w,U);
 
-    ADD_XOR(Fres,prevU);
+    #pragma unroll
+    for(int i = 0;i<5;i++) F[i] = U[i];
     for(ushort c=1;c<1000;c++){
-        hmac_sha1(prevU,20,pass,passLen,prevU);
-        ADD_XOR(Fres,prevU);
+        hmac_sha1_digest(istate,ostate,U);
+        #pragma unroll
+        for(int i = 0;i<5;i++) F[i] ^= U[i];
     }
-    #pragma unroll
-    for(uchar i = 0;i<2;i++) output[i] = Fres[8+i]; 
 }
 
-void pbkdf2_sha1_zip_aes128(const uchar* pass, unsigned int passLen, const uchar* in_salt, uchar* output){
-
-    uchar prevU[20] = {0};
-    uchar Fres[20];    
-    
+/**
+ * Derives 2 bytes of password verifier and compares them, only block
+ * containing it is computed
+ * @return mask of lanes matching verifier
+ */
+inline i32x pbkdf2_sha1_zip_aes(const u32x* key){
+    const uchar verifier[2] = VERIFIER;
+    u32x istate[5], ostate[5];
+    u32x F[5];
 
-    #pragma unroll
-    for(uchar i = 0;i<20;i++) Fres[i] = 0;
-    #pragma unroll
-    for(int i = 0;i<8;i++) prevU[i] = in_salt[i];
+    pbkdf2_sha1_init(key,istate,ostate);
+    pbkdf2_sha1_block(istate,ostate,VERIFIER_BLOCK,F);
 
-    prevU[11] = 2;
+    return (VERIFIER_BYTE(F,0) == verifier[0]) & (VERIFIER_BYTE(F,1) == verifier[1]);
+}
 
-    hmac_sha1(prevU,12,pass,passLen,prevU);
+#ifdef VECTOR_WIDTH
 
-    ADD_XOR(Fres,prevU);
-    for(ushort c=1;c<1000;c++){
-        hmac_sha1(prevU,20,pass,passLen,prevU);
-        ADD_XOR(Fres,prevU);
+/**
+ * Cracks VECTOR_WIDTH candidates in lanes, see FOR_EACH_VECTOR
+ */
+kernel void zip_aes_vector_kernel(global uint* passwords, uint stride, global uint *found_count, global uint *found_queue) {
+    FOR_EACH_VECTOR(id){
+        u32x pass_words[KEY_PASS_WORDS];
+        u32x key[16];
+        u32x len;
+        
+        i32x valid = load_vector(id,&len,pass_words,KEY_PASS_WORDS,passwords,stride);
+        pass_key(pass_words,(u32x)CANDIDATE_LENGTH(len),key);
+        report_vector(id,valid & pbkdf2_sha1_zip_aes(key),found_count,found_queue,passwords,stride);
     }
-    #pragma unroll
-    for(uchar i = 0;i<2;i++) output[i] = Fres[12+i]; 
 }
 
+#else
+
 /**
  * @author Honza
  */
-kernel void zip_aes256_kernel(global uchar* passwords, uchar pass_len, global uchar *found_flag, global uint *found_vector, constant uchar *salt, constant uchar *verifier) {
-    int id = get_global_id(0);
+inline void zip_aes_candidate(size_t id, global uint* passwords, uint stride, global uint *found_count, global uint *found_queue PASSGEN_PARAMS) {
     
-    uchar my_pass_len = passwords[id*pass_len];
-    uchar pass_buffer[32];
-    uchar mverifier[2];
+    uint pass_words[PASS_WORDS];
+    uint key[16];
     
-    for(int i = 0;i<my_pass_len;i++){
-        pass_buffer[i] = passwords[id*pass_len+1+i];
-    }
+    int len = LOAD_CANDIDATE(id,(uchar *)pass_words,passwords,stride);
+    if(len < 0)
+        return;
+    uint my_pass_len = CANDIDATE_LENGTH(len);
 
-    pbkdf2_sha1_zip_aes256(pass_buffer,my_pass_len,salt,mverifier);
-    
-    for(int i = 0;i<2;i++){
-        if(mverifier[i] != verifier[i]){
-            return;
-        }
-    }
+    pass_key(pass_words,my_pass_len,key);
+    if(!pbkdf2_sha1_zip_aes(key))
+        return;
     
-    *found_flag = 1;
-    uint big_pos = id/32;
-    uint small_pos = id%32;
-    uint val = 0x80000000 >> small_pos;
-    atomic_or(found_vector+big_pos,val);
+    REPORT_CANDIDATE(id,found_count,found_queue,passwords,stride);
 }
 
-kernel void zip_aes192_kernel(global uchar* passwords, uchar pass_len, global uchar *found_flag, global uint *found_vector, constant uchar *salt, constant uchar *verifier) {
-    int id = get_global_id(0);
-    
-    uchar my_pass_len = passwords[id*pass_len];
-    uchar pass_buffer[32];
-    uchar psalt[16];
-    uchar mverifier[2];
-    
-    for(int i = 0;i<my_pass_len;i++){
-        pass_buffer[i] = passwords[id*pass_len+1+i];
+/**
+ * Cracks candidates of work item, see FOR_EACH_CANDIDATE
+ */
+kernel void zip_aes_kernel(global uint* passwords, uint stride, global uint *found_count, global uint *found_queue PASSGEN_PARAMS) {
+    FOR_EACH_CANDIDATE(id){
+        zip_aes_candidate(id,passwords,stride,found_count,found_queue PASSGEN_ARGS);
     }
+}
 
-    for(int i = 0;i<16;i++){
-        psalt[i] = salt[i];
+#endif
+
+#ifdef ZIP_AES_VERIFY
+
+// Authentication key follows encryption key in derived key
+#define AUTH_FIRST_BLOCK (KEY_BYTES/20+1)
+#define AUTH_LAST_BLOCK ((2*KEY_BYTES-1)/20+1)
+#define AUTH_KEY_WORDS (KEY_BYTES/4)
+
+/**
+ * HMAC-SHA1 of data in global memory from ipad and opad midstates
+ */
+inline void hmac_sha1_global(const uint* istate, const uint* ostate, global const uchar* msg, uint len, uint* mac){
+    uint w[16];
+    uint h[5];
+    uint pos = 0;
+
+    #pragma unroll
+    for(int i = 0;i<5;i++) h[i] = istate[i];
+    for(;pos+64 <= len;pos += 64){
+        for(int i = 0;i<16;i++)
+            w[i] = msg[pos+4*i] << 24 | msg[pos+4*i+1] << 16 | msg[pos+4*i+2] << 8 | msg[pos+4*i+3];
+        sha1_block(w,h);
     }
 
-    pbkdf2_sha1_zip_aes192(pass_buffer,my_pass_len,psalt,mverifier);
-    
-    for(int i = 0;i<2;i++){
-        if(mverifier[i] != verifier[i]){
-            return;
-        }
+    // Rest of data and padding, length may need another block
+    uint rest = len-pos;
+    for(int i = 0;i<16;i++) w[i] = 0;
+    for(uint i = 0;i<rest;i++)
+        w[i/4] |= (uint)msg[pos+i] << (24 - 8*(i%4));
+    w[rest/4] |= 0x80000000 >> (8*(rest%4));
+    if(rest >= 56){
+        sha1_block(w,h);
+        for(int i = 0;i<16;i++) w[i] = 0;
     }
-    
-    *found_flag = 1;
-    uint big_pos = id/32;
-    uint small_pos = id%32;
-    uint val = 0x80000000 >> small_pos;
-    atomic_or(found_vector+big_pos,val);
+    w[15] = (64+len)*8;
+    sha1_block(w,h);
+
+    #pragma unroll
+    for(int i = 0;i<5;i++){ w[i] = h[i]; mac[i] = ostate[i]; }
+    w[5] = 0x80000000;
+    #pragma unroll
+    for(int i = 6;i<15;i++) w[i] = 0;
+    w[15] = (64+20)*8;
+    sha1_block(w,mac);
 }
 
-kernel void zip_aes128_kernel(global uchar* passwords, uchar pass_len, global uchar *found_flag, global uint *found_vector, constant uchar *salt, constant uchar *verifier) {
-    int id = get_global_id(0);
-    
-    uchar my_pass_len = passwords[id*pass_len];
-    uchar pass_buffer[32];
-    uchar psalt[16];
-    uchar mverifier[2];
-    
-    for(int i = 0;i<my_pass_len;i++){
-        pass_buffer[i] = passwords[id*pass_len+1+i];
-    }
+/**
+ * Derives authentication key of candidates matching verifier. With
+ * DEVICE_AUTH the key authenticates data and result of candidate is one word
+ * (non-zero if AUTH_CODE matches), otherwise result is the key in
+ * AUTH_KEY_WORDS big endian words, which is used by host.
+ */
+kernel void zip_aes_verify_kernel(global uint* passwords, uint stride, uint count, global uint *results, global const uchar *data, uint data_len) {
+    size_t id = get_global_id(0);
+    uint pass_words[PASS_WORDS];
+    uint istate[5], ostate[5];
+    uint dk[5*AUTH_LAST_BLOCK];
+    uint key[16];
+
+    if(id >= count)
+        return;
 
-    for(int i = 0;i<16;i++){
-        psalt[i] = salt[i];
-    }
+    int len = load_candidate(id,(uchar *)pass_words,passwords,stride);
+    pass_key(pass_words,len,key);
+    pbkdf2_sha1_init(key,istate,ostate);
+    for(uint block = AUTH_FIRST_BLOCK;block <= AUTH_LAST_BLOCK;block++)
+        pbkdf2_sha1_block(istate,ostate,block,dk+5*(block-1));
 
-    pbkdf2_sha1_zip_aes128(pass_buffer,my_pass_len,psalt,mverifier);
-    
-    for(int i = 0;i<2;i++){
-        if(mverifier[i] != verifier[i]){
-            return;
-        }
+    // Key starts at byte KEY_BYTES of derived key, it isn't aligned to block
+    #pragma unroll
+    for(int i = 0;i<16;i++) key[i] = 0;
+    for(uint i = 0;i<KEY_BYTES;i++){
+        uint j = KEY_BYTES+i;
+        uchar byte = dk[j/4] >> (24 - 8*(j%4));
+        key[i/4] |= (uint)byte << (24 - 8*(i%4));
     }
-    
-    *found_flag = 1;
-    uint big_pos = id/32;
-    uint small_pos = id%32;
-    uint val = 0x80000000 >> small_pos;
-    atomic_or(found_vector+big_pos,val);
+
+#ifdef DEVICE_AUTH
+    const uchar auth_code[10] = AUTH_CODE;
+    uint mac[5];
+    uint match = 1;
+
+    hmac_sha1_midstate(key,0x36363636,istate);
+    hmac_sha1_midstate(key,0x5C5C5C5C,ostate);
+    hmac_sha1_global(istate,ostate,data,data_len,mac);
+    #pragma unroll
+    for(int i = 0;i<10;i++)
+        match &= (uchar)(mac[i/4] >> (24 - 8*(i%4))) == auth_code[i];
+    results[id] = match;
+#else
+    #pragma unroll
+    for(int i = 0;i<AUTH_KEY_WORDS;i++)
+        results[id*AUTH_KEY_WORDS+i] = key[i];
+#endif
 }
+
+#endif
@@ -23,12 +23,22 @@
 
 #pragma OPENCL EXTENSION cl_amd_printf : enable
 
-inline uint crc32(uint crc, uchar c, constant uint *table){
+#ifndef MAX_PASS_LEN
+#define MAX_PASS_LEN 32
+#endif
+
+// FILES_COUNT, RANDOM_STREAM and LAST_CRC_BYTES are defined by build options of cracker
+constant uchar randomStream[FILES_COUNT*12] = RANDOM_STREAM;
+constant uchar lastCRCBytes[FILES_COUNT] = LAST_CRC_BYTES;
+
+// CRC table is copied into local memory by work group, constant memory
+// serializes data-dependent indexes of work items
+inline uint crc32(uint crc, uchar c, local uint *table){
     crc = (crc >> 8) ^ table[(crc & 0xff) ^ c];
     return crc;
 }
 
-inline void updateKeys(uint3 *keys, uchar c, constant uint *CRCTable){
+inline void updateKeys(uint3 *keys, uchar c, local uint *CRCTable){
     (*keys).x = crc32((*keys).x,c,CRCTable);
     (*keys).y = (*keys).y + ((*keys).x & 0xFF);
     (*keys).y = (*keys).y * 0x08088405 + 1;
@@ -41,15 +51,9 @@ inline uchar decryptByte(uint3 *keys){
     return (temp * (temp ^ 1)) >> 8;
 }
 
-inline uchar initKeys(uint3 *keys, const uchar* pass, uint passlen, constant uchar *randomBuffer, constant uint *CRCTable){
-    (*keys).x = 0x12345678;
-    (*keys).y = 0x23456789;
-    (*keys).z = 0x34567890;
-    
-    for(uint i = 0;i<passlen;i++){
-        updateKeys(keys,pass[i],CRCTable);
-    }
+inline uchar decryptHeader(uint3 *keys, constant uchar *randomBuffer, local uint *CRCTable){
     uchar C = 0;
+    #pragma unroll
     for(uint i = 0;i<12;i++){
         C = randomBuffer[i] ^ decryptByte(keys);
         updateKeys(keys,C,CRCTable);
@@ -57,31 +61,343 @@ inline uchar initKeys(uint3 *keys, const uchar* pass, uint passlen, constant uch
     return C;
 }
 
+#ifndef DEFLATE_BYTES
+// Data isn't checked, keys of no file are kept
+#define DEFLATE_FILE FILES_COUNT
+#endif
+
+#ifdef DEFLATE_BYTES
+
+// DEFLATE_FILE, DEFLATE_BYTES, DEFLATE_PREFIX, DEFLATE_DATA_LEN and
+// DEFLATE_SIZE describe encrypted data of the file with data
+constant uchar deflatePrefix[DEFLATE_BYTES] = DEFLATE_PREFIX;
+
 /**
- * @author Honza
+ * Bit stream of DEFLATE data decrypted from prefix of file
+ */
+typedef struct {
+    uint3 keys;
+    uint bits;
+    uint count;
+    uint pos;
+} DeflateStream;
+
+/**
+ * Buffers at least n bits (n <= 16)
+ * @return false if prefix is exhausted
+ */
+inline bool needBits(DeflateStream *s, uint n, local uint *CRCTable){
+    while(s->count < n){
+        if(s->pos >= DEFLATE_BYTES)
+            return false;
+        uchar c = deflatePrefix[s->pos++] ^ decryptByte(&s->keys);
+        updateKeys(&s->keys,c,CRCTable);
+        s->bits |= (uint)c << s->count;
+        s->count += 8;
+    }
+    return true;
+}
+
+inline uint getBits(DeflateStream *s, uint n){
+    uint value = s->bits & ((1u << n) - 1);
+    s->bits >>= n;
+    s->count -= n;
+    return value;
+}
+
+/**
+ * Decodes symbol of canonical Huffman code with lengths up to 7 bits
+ * @return symbol, -1 if prefix is exhausted
+ */
+inline int decodeSymbol(DeflateStream *s, const ushort *counts, const uchar *symbols, local uint *CRCTable){
+    int code = 0, first = 0, index = 0;
+    for(int len = 1;len<=7;len++){
+        if(!needBits(s,1,CRCTable))
+            return -1;
+        code |= getBits(s,1);
+        int count = counts[len];
+        if(code - count < first)
+            return symbols[index + (code - first)];
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    return -2;
+}
+
+/**
+ * Checks code lengths of literal/length or distance code the way inflate
+ * does, code can be incomplete only if its longest code has 1 bit
+ */
+inline bool checkCodeLengths(const ushort *counts){
+    int left = 1;
+    uint max = 0;
+    for(uint len = 1;len<16;len++){
+        left <<= 1;
+        left -= counts[len];
+        if(left < 0)
+            return false;
+        if(counts[len] > 0)
+            max = len;
+    }
+    return left == 0 || max <= 1;
+}
+
+constant ushort lengthBase[29] = {3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258};
+constant uchar lengthExtra[29] = {0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0};
+constant ushort distBase[30] = {1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577};
+constant uchar distExtra[30] = {0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
+
+/**
+ * Reads Huffman code of n bits (most significant bit first) following code
+ */
+inline bool appendCode(DeflateStream *s, uint n, uint *code, local uint *CRCTable){
+    for(uint i = 0;i<n;i++){
+        if(!needBits(s,1,CRCTable))
+            return false;
+        *code = (*code << 1) | getBits(s,1);
+    }
+    return true;
+}
+
+/**
+ * Decodes symbols of block with fixed Huffman codes, distances can't reach
+ * before beginning of data
+ * @return false if block is invalid
  */
-kernel void zip_pk_kernel(global uchar* passwords, uchar pass_len, global uchar *found_flag, global uint *found_vector, uint files_count, constant uchar *randomBuffer, constant uchar *lastCRCByte, constant uint *CRCTable) {
-    int id = get_global_id(0);
+inline bool checkFixedBlock(DeflateStream *s, uint final, local uint *CRCTable){
+    uint out = 0;
+    for(;;){
+        uint code = 0, symbol;
+        if(!appendCode(s,7,&code,CRCTable))
+            return true;
+        if(code <= 0x17){
+            symbol = 256 + code;
+        }else{
+            if(!appendCode(s,1,&code,CRCTable))
+                return true;
+            if(code >= 0x30 && code <= 0xBF)
+                symbol = code - 0x30;
+            else if(code >= 0xC0 && code <= 0xC7)
+                symbol = 280 + code - 0xC0;
+            else{
+                if(!appendCode(s,1,&code,CRCTable))
+                    return true;
+                symbol = 144 + code - 0x190;
+            }
+        }
+        
+        if(symbol < 256){
+            out++;
+            continue;
+        }
+        if(symbol == 256)
+            return !final || out == DEFLATE_SIZE;
+        if(symbol > 285)
+            return false;
+        
+        uint len = lengthBase[symbol-257];
+        uint extra = lengthExtra[symbol-257];
+        if(!needBits(s,extra,CRCTable))
+            return true;
+        len += getBits(s,extra);
+        
+        uint dcode = 0;
+        if(!appendCode(s,5,&dcode,CRCTable))
+            return true;
+        if(dcode >= 30)
+            return false;
+        uint dist = distBase[dcode];
+        extra = distExtra[dcode];
+        if(!needBits(s,extra,CRCTable))
+            return true;
+        dist += getBits(s,extra);
+        if(dist > out)
+            return false;
+        out += len;
+    }
+}
+
+/**
+ * Checks header of first DEFLATE block decrypted from keys after header of
+ * file. Candidate isn't rejected if prefix ends before header is checked.
+ * @return false if block header is invalid
+ */
+inline bool checkDeflate(uint3 keys, local uint *CRCTable){
+    DeflateStream s;
+    s.keys = keys;
+    s.bits = 0;
+    s.count = 0;
+    s.pos = 0;
+    
+    if(!needBits(&s,3,CRCTable))
+        return true;
+    uint final = getBits(&s,1);
+    uint type = getBits(&s,2);
+    if(type == 3)
+        return false;
+    if(type == 1)
+        return checkFixedBlock(&s,final,CRCTable);
+    
+    if(type == 0){
+        // Stored block starts at byte boundary with length and its complement
+        getBits(&s,s.count % 8);
+        if(!needBits(&s,16,CRCTable))
+            return true;
+        uint len = getBits(&s,16);
+        if(!needBits(&s,16,CRCTable))
+            return true;
+        uint nlen = getBits(&s,16);
+        if(len != (~nlen & 0xFFFF) || len + 5 > DEFLATE_DATA_LEN)
+            return false;
+        return !final || len == DEFLATE_SIZE;
+    }
+    
+    // Dynamic block has code of code lengths, which has to be complete
+    if(!needBits(&s,14,CRCTable))
+        return true;
+    uint nlen = getBits(&s,5) + 257;
+    uint ndist = getBits(&s,5) + 1;
+    uint ncode = getBits(&s,4) + 4;
+    if(nlen > 286 || ndist > 30)
+        return false;
+    
+    const uchar order[19] = {16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15};
+    uchar lengths[19];
+    ushort counts[8];
+    ushort offsets[8];
+    uchar symbols[19];
+    for(uint i = 0;i<19;i++) lengths[i] = 0;
+    for(uint i = 0;i<8;i++) counts[i] = 0;
+    for(uint i = 0;i<ncode;i++){
+        if(!needBits(&s,3,CRCTable))
+            return true;
+        lengths[order[i]] = getBits(&s,3);
+    }
+    for(uint i = 0;i<19;i++) counts[lengths[i]]++;
+    int left = 1;
+    for(uint len = 1;len<8;len++){
+        left <<= 1;
+        left -= counts[len];
+        if(left < 0)
+            return false;
+    }
+    if(left > 0)
+        return false;
+    offsets[1] = 0;
+    for(uint len = 1;len<7;len++) offsets[len+1] = offsets[len] + counts[len];
+    for(uint i = 0;i<19;i++){
+        if(lengths[i] != 0)
+            symbols[offsets[lengths[i]]++] = i;
+    }
+    
+    // Lengths of literal/length and distance codes
+    ushort litCounts[16];
+    ushort distCounts[16];
+    for(uint i = 0;i<16;i++){ litCounts[i] = 0; distCounts[i] = 0; }
+    uint index = 0, prev = 0;
+    while(index < nlen + ndist){
+        int symbol = decodeSymbol(&s,counts,symbols,CRCTable);
+        if(symbol == -1)
+            return true;
+        if(symbol < 0)
+            return false;
+        uint len, repeat;
+        if(symbol < 16){
+            len = symbol;
+            repeat = 1;
+        }else if(symbol == 16){
+            if(index == 0)
+                return false;
+            if(!needBits(&s,2,CRCTable))
+                return true;
+            len = prev;
+            repeat = 3 + getBits(&s,2);
+        }else if(symbol == 17){
+            if(!needBits(&s,3,CRCTable))
+                return true;
+            len = 0;
+            repeat = 3 + getBits(&s,3);
+        }else{
+            if(!needBits(&s,7,CRCTable))
+                return true;
+            len = 0;
+            repeat = 11 + getBits(&s,7);
+        }
+        if(index + repeat > nlen + ndist)
+            return false;
+        for(;repeat > 0;repeat--,index++){
+            if(index < nlen){
+                // End of block has to be coded
+                if(index == 256 && len == 0)
+                    return false;
+                litCounts[len]++;
+            }else
+                distCounts[len]++;
+        }
+        prev = len;
+    }
     
-    uchar my_pass_len = passwords[id*pass_len];
-    uchar pass_buffer[32];
+    return checkCodeLengths(litCounts) && checkCodeLengths(distCounts);
+}
+
+#endif
+
+/**
+ * @author Honza
+ */
+inline void zip_pk_candidate(size_t id, global uint* passwords, uint stride, global uint *found_count, global uint *found_queue PASSGEN_PARAMS, local uint *CRCTable) {
+    uchar pass_buffer[(MAX_PASS_LEN+3)/4*4];
+    int len = LOAD_CANDIDATE(id,pass_buffer,passwords,stride);
+    if(len < 0)
+        return;
+    uchar my_pass_len = CANDIDATE_LENGTH(len);
     uint3 keys;
     
+    // Keys after password are the same for all files, headers are decrypted
+    // from copies of them
+    keys.x = 0x12345678;
+    keys.y = 0x23456789;
+    keys.z = 0x34567890;
     for(int i = 0;i<my_pass_len;i++){
-        pass_buffer[i] = passwords[id*pass_len+1+i];
+        updateKeys(&keys,pass_buffer[i],CRCTable);
     }
     
-    
-    for(uint i = 0;i<files_count;i++){
-        uchar lastb = initKeys(&keys,pass_buffer,my_pass_len,randomBuffer+(i*12),CRCTable);
-        if(lastb != lastCRCByte[i]){
+    uint3 data_keys = keys;
+    #pragma unroll
+    for(uint i = 0;i<FILES_COUNT;i++){
+        uint3 file_keys = keys;
+        uchar lastb = decryptHeader(&file_keys,randomStream+(i*12),CRCTable);
+        if(lastb != lastCRCBytes[i]){
             return;
         }
+        // Data of one file is known, its keys continue after header
+        if(i == DEFLATE_FILE)
+            data_keys = file_keys;
     }
     
-    *found_flag = 1;
-    uint big_pos = id/32;
-    uint small_pos = id%32;
-    uint val = 0x80000000 >> small_pos;
-    atomic_or(found_vector+big_pos,val);
+#ifdef DEFLATE_BYTES
+    // Header check passes 1/256 of candidates per file, beginning of data
+    // rejects most of them before host inflates it
+    if(!checkDeflate(data_keys,CRCTable))
+        return;
+#endif
+    
+    REPORT_CANDIDATE(id,found_count,found_queue,passwords,stride);
+}
+
+/**
+ * Cracks candidates of work item (ITEM_CANDIDATES set by cracker), see
+ * FOR_EACH_CANDIDATE. CRC table is loaded into local memory once per group.
+ */
+kernel void zip_pk_kernel(global uint* passwords, uint stride, global uint *found_count, global uint *found_queue PASSGEN_PARAMS, constant uint *CRCTable) {
+    local uint crc_table[256];
+    for(uint i = get_local_id(0);i<256;i += get_local_size(0))
+        crc_table[i] = CRCTable[i];
+    barrier(CLK_LOCAL_MEM_FENCE);
+    
+    FOR_EACH_CANDIDATE(id){
+        zip_pk_candidate(id,passwords,stride,found_count,found_queue PASSGEN_ARGS,crc_table);
+    }
 }